@@ -0,0 +1,44 @@
+get_filename_component(TensorView_CMAKE_DIR "${CMAKE_CURRENT_LIST_FILE}" PATH)
+include(CMakeFindDependencyMacro)
+include(FindPackageHandleStandardArgs)
+
+
+####### Expanded from @PACKAGE_INIT@ by configure_package_config_file() #######
+####### Any changes to this file will be overwritten by the next CMake run ####
+####### The input file was TensorViewConfig.cmake.in                            ########
+
+get_filename_component(PACKAGE_PREFIX_DIR "${CMAKE_CURRENT_LIST_DIR}/../../../" ABSOLUTE)
+
+macro(set_and_check _var _file)
+  set(${_var} "${_file}")
+  if(NOT EXISTS "${_file}")
+    message(FATAL_ERROR "File or directory ${_file} referenced by variable ${_var} does not exist !")
+  endif()
+endmacro()
+
+macro(check_required_components _NAME)
+  foreach(comp ${${_NAME}_FIND_COMPONENTS})
+    if(NOT ${_NAME}_${comp}_FOUND)
+      if(${_NAME}_FIND_REQUIRED_${comp})
+        set(${_NAME}_FOUND FALSE)
+      endif()
+    endif()
+  endforeach()
+endmacro()
+
+####################################################################################
+
+list(APPEND CMAKE_MODULE_PATH ${TensorView_CMAKE_DIR})
+
+list(REMOVE_AT CMAKE_MODULE_PATH -1)
+
+if (NOT TARGET TV::TensorView)
+    include("${TensorView_CMAKE_DIR}/TensorViewTargets.cmake")
+endif ()
+
+set(TensorView_LIBRARIES TV::TensorView)
+
+find_package_handle_standard_args(TensorView
+        FOUND_VAR TensorView_FOUND
+        REQUIRED_VARS TensorView_LIBRARIES)
+
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/benchmark_tensor_view.dir/benchmark_tensor_view.cpp.o"
+  "CMakeFiles/benchmark_tensor_view.dir/benchmark_tensor_view.cpp.o.d"
+  "benchmark_tensor_view"
+  "benchmark_tensor_view.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/benchmark_tensor_view.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,459 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "TensorView/TensorView.h"
+#include "TensorView/Tensor.h"
+#include "TensorView/Functions.h"
+#include "TensorView/Quantized.h"
+#include "TensorView/StaticTensorView.h"
+
+using namespace tensor_view;
+
+namespace {
+
+/* Layout of the source operand of a benchmark. All layouts have the shape [n / 4096, 64, 64]. */
+enum Layout {
+    contiguous_layout,
+    permuted_layout,  // [64, 64, n / 4096] buffer, permuted
+    sliced_layout,    // every second element of the rows of [n / 4096, 64, 128] buffer
+    broadcast_layout  // [64, 64] buffer, broadcasted over the outer dim
+};
+
+const char* layout_name(int64_t layout) {
+    static const char* names[] = {"contiguous", "permuted", "sliced", "broadcast"};
+    return names[layout];
+}
+
+const int64_t inner_size = 64;
+
+/* Source and destination views with n elements, the source laid out as `layout` */
+struct Operands {
+    Operands(size_t n, Layout layout) :
+            outer(n / (inner_size * inner_size)),
+            src_data(layout == sliced_layout ? 2 * n : layout == broadcast_layout ? inner_size * inner_size : n),
+            dst_data(n) {
+        std::iota(src_data.begin(), src_data.end(), 0.f);
+        const size_t shape[] = {outer, inner_size, inner_size};
+        dst = TensorView<float, 3>(dst_data.data(), shape);
+        switch (layout) {
+            case contiguous_layout:
+                src = TensorView<float, 3>(src_data.data(), shape);
+                break;
+            case permuted_layout:
+                src = make_view(src_data.data(), {inner_size, inner_size, static_cast<int64_t>(outer)}).permute(2, 0, 1);
+                break;
+            case sliced_layout:
+                src = make_view(src_data.data(), {static_cast<int64_t>(outer), inner_size, 2 * inner_size})
+                        .slice(Range(), Range(), Range(0, 2 * inner_size, 2));
+                break;
+            case broadcast_layout: {
+                const size_t broadcast_stride[] = {0, inner_size, 1};
+                src = TensorView<float, 3>(src_data.data(), shape, broadcast_stride);
+                break;
+            }
+        }
+    }
+
+    size_t outer;
+    std::vector<float> src_data, dst_data;
+    TensorView<float, 3> src, dst;
+};
+
+/* Reports elements/s and GB/s for `bytes_per_element` bytes read and written per element */
+void set_counters(benchmark::State& state, size_t n, size_t bytes_per_element) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * n * bytes_per_element));
+}
+
+void layout_args(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"n", "layout"});
+    for (int64_t n : {1 << 12, 1 << 16, 1 << 20, 1 << 22}) {
+        for (int64_t layout = contiguous_layout; layout <= broadcast_layout; ++layout) {
+            b->Args({n, layout});
+        }
+    }
+}
+
+void size_args(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"n"});
+    for (int64_t n : {1 << 12, 1 << 16, 1 << 20, 1 << 22}) {
+        b->Args({n});
+    }
+}
+
+/* Baselines: memcpy and naive loops over at() */
+
+void BM_memcpy(benchmark::State& state) {
+    const size_t n = state.range(0);
+    std::vector<float> src(n, 1.f), dst(n);
+    for (auto _ : state) {
+        std::memcpy(dst.data(), src.data(), n * sizeof(float));
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+}
+BENCHMARK(BM_memcpy)->Apply(size_args);
+
+void BM_naive_assign(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    auto& src = operands.src;
+    auto& dst = operands.dst;
+    for (auto _ : state) {
+        for (size_t i = 0; i < src.size(0); ++i) {
+            for (size_t j = 0; j < src.size(1); ++j) {
+                for (size_t k = 0; k < src.size(2); ++k) {
+                    dst(i, j, k) = src(i, j, k);
+                }
+            }
+        }
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_naive_assign)->Apply(layout_args);
+
+void BM_naive_sum(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    const auto& src = operands.src;
+    for (auto _ : state) {
+        float sum = 0;
+        for (size_t i = 0; i < src.size(0); ++i) {
+            for (size_t j = 0; j < src.size(1); ++j) {
+                for (size_t k = 0; k < src.size(2); ++k) {
+                    sum += src(i, j, k);
+                }
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    set_counters(state, n, sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_naive_sum)->Apply(layout_args);
+
+/* Engines of the library */
+
+void BM_assign(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    for (auto _ : state) {
+        operands.dst.assign_(operands.src);
+        benchmark::DoNotOptimize(operands.dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_assign)->Apply(layout_args);
+
+/* In-place unary map_ of the source view */
+void BM_map(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    for (auto _ : state) {
+        operands.src.map_([](float x) { return x * 0.5f + 1.f; });
+        benchmark::DoNotOptimize(operands.src.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_map)->Apply(layout_args);
+
+/* dst = dst + src, src broadcasted for the broadcast layout */
+void BM_binary(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    for (auto _ : state) {
+        operands.dst = operands.dst + operands.src;
+        benchmark::DoNotOptimize(operands.dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 3 * sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_binary)->Apply(layout_args);
+
+/* dst = src * [64] row vector */
+void BM_binary_broadcast_row(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    std::vector<float> row(inner_size, 2.f);
+    auto row_view = make_view(row.data(), {inner_size});
+    for (auto _ : state) {
+        operands.dst = operands.src * row_view;
+        benchmark::DoNotOptimize(operands.dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_binary_broadcast_row)->Apply(layout_args);
+
+/* Per-channel normalization of a [n / 4096, 64, 8, 8] NCHW image, the statistics broadcasted when the second
+ * argument is 1 and materialized to the full shape otherwise */
+void BM_per_channel(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const bool broadcast = state.range(1) != 0;
+    const size_t channels = inner_size;
+    const size_t shape[] = {n / (channels * 64), channels, 8, 8};
+    std::vector<float> src(n, 1.f), dst(n), mean(broadcast ? channels : n, 0.5f), scale(broadcast ? channels : n, 2.f);
+    TensorView<float, 4> src_view(src.data(), shape), dst_view(dst.data(), shape);
+    TensorView<float, 4> mean_view(mean.data(), shape), scale_view(scale.data(), shape);
+    if (broadcast) {
+        const size_t channel_stride[] = {0, 1, 0, 0};
+        mean_view = TensorView<float, 4>(mean.data(), shape, channel_stride);
+        scale_view = TensorView<float, 4>(scale.data(), shape, channel_stride);
+    }
+    for (auto _ : state) {
+        dst_view = (src_view - mean_view) * scale_view;
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, (broadcast ? 2 : 4) * sizeof(float));
+    state.SetLabel(broadcast ? "broadcast" : "materialized");
+}
+BENCHMARK(BM_per_channel)->ArgNames({"n", "broadcast"})->ArgsProduct({{1 << 16, 1 << 22}, {0, 1}});
+
+/* dst = column * row, an outer product of [n / 1024] and [1024] vectors */
+void BM_outer_product(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const size_t cols = 1024;
+    std::vector<float> column(n / cols, 2.f), row(cols, 3.f), dst(n);
+    auto column_view = make_view(column.data(), {n / cols}).unsqueeze(1);
+    auto row_view = make_view(row.data(), {cols});
+    auto dst_view = make_view(dst.data(), {n / cols, cols});
+    for (auto _ : state) {
+        dst_view = column_view * row_view;
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, sizeof(float));
+}
+BENCHMARK(BM_outer_product)->Apply(size_args);
+
+/* In-place dst -= [64] row vector */
+void BM_inplace_broadcast_row(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, contiguous_layout);
+    std::vector<float> row(inner_size, 1.f);
+    auto row_view = make_view(row.data(), {inner_size});
+    for (auto _ : state) {
+        operands.dst -= row_view;
+        benchmark::DoNotOptimize(operands.dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+}
+BENCHMARK(BM_inplace_broadcast_row)->Apply(size_args);
+
+void BM_reduce(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(operands.src.sum());
+    }
+    set_counters(state, n, sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_reduce)->Apply(layout_args);
+
+/* float16 -> float (second argument 0) and float -> float16 (1) conversion of contiguous views */
+void BM_half_convert(benchmark::State& state) {
+    const size_t n = state.range(0);
+    std::vector<float16> half(n, float16(1.f));
+    std::vector<float> single(n, 1.f);
+    auto half_view = make_view(half.data(), {n});
+    auto single_view = make_view(single.data(), {n});
+    for (auto _ : state) {
+        if (state.range(1) == 0) {
+            single_view.assign_(half_view);
+        } else {
+            half_view.assign_(single_view);
+        }
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, sizeof(float16) + sizeof(float));
+}
+BENCHMARK(BM_half_convert)->ArgNames({"n", "narrow"})->ArgsProduct({{1 << 16, 1 << 22}, {0, 1}});
+
+/* Sum of float16 values, accumulated in float */
+void BM_half_reduce(benchmark::State& state) {
+    const size_t n = state.range(0);
+    std::vector<float16> half(n, float16(1.f));
+    auto half_view = make_view(half.data(), {n});
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(half_view.sum());
+    }
+    set_counters(state, n, sizeof(float16));
+}
+BENCHMARK(BM_half_reduce)->Apply(size_args);
+
+/* float -> int8 quantization (second argument 0) and int8 -> float dequantization (1) of contiguous views */
+void BM_quantize(benchmark::State& state) {
+    const size_t n = state.range(0);
+    std::vector<int8_t> quantized(n, 0);
+    std::vector<float> single(n, 1.f);
+    auto quantized_view = make_quantized(make_view(quantized.data(), {n}), 0.1f, 3);
+    auto single_view = make_view(single.data(), {n});
+    for (auto _ : state) {
+        if (state.range(1) == 0) {
+            quantize(single_view, quantized_view);
+        } else {
+            dequantize(quantized_view, single_view);
+        }
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, sizeof(int8_t) + sizeof(float));
+}
+BENCHMARK(BM_quantize)->ArgNames({"n", "dequantize"})->ArgsProduct({{1 << 16, 1 << 22}, {0, 1}});
+
+/* n x n product of int8 matrices accumulated in int32, items are multiply-adds */
+void BM_quantized_matmul(benchmark::State& state) {
+    const size_t n = state.range(0);
+    std::vector<int8_t> a(n * n, 1), b(n * n, 2);
+    auto a_view = make_quantized(make_view(a.data(), {n, n}), 0.1f, 0);
+    auto b_view = make_quantized(make_view(b.data(), {n, n}), 0.1f, 0);
+    Tensor<int32_t, 2> c(uninitialized, n, n);
+    for (auto _ : state) {
+        matmul(a_view, b_view, c);
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n * n * n, 0);
+}
+BENCHMARK(BM_quantized_matmul)->Arg(256)->Arg(512);
+
+/* Per-box loop weighting 80 class scores by the area of the box, indexed through dynamic views (second argument 0)
+ * or static views (1) */
+void BM_per_box(benchmark::State& state) {
+    const size_t num_boxes = state.range(0), num_classes = 80, num_coords = 4;
+    std::vector<float> scores(num_boxes * num_classes, 0.5f), boxes(num_boxes * num_coords, 1.f);
+    std::vector<float> weighted(num_boxes * num_classes);
+    auto scores_view = make_view(scores.data(), {num_boxes, num_classes});
+    auto boxes_view = make_view(boxes.data(), {num_boxes, num_coords});
+    auto weighted_view = make_view(weighted.data(), {num_boxes, num_classes});
+    for (auto _ : state) {
+        for (size_t i = 0; i < num_boxes; ++i) {
+            if (state.range(1) == 0) {
+                auto box_scores = scores_view.at(i);
+                auto box = boxes_view.at(i);
+                auto box_weighted = weighted_view.at(i);
+                const float area = (box(2) - box(0)) * (box(3) - box(1));
+                for (size_t c = 0; c < num_classes; ++c) {
+                    box_weighted(c) = box_scores(c) * area;
+                }
+            } else {
+                StaticTensorView<float, Extents<80>> box_scores(scores.data() + i * num_classes);
+                StaticTensorView<float, Extents<4>> box(boxes.data() + i * num_coords);
+                StaticTensorView<float, Extents<80>> box_weighted(weighted.data() + i * num_classes);
+                const float area = (box(2) - box(0)) * (box(3) - box(1));
+                for (size_t c = 0; c < num_classes; ++c) {
+                    box_weighted(c) = box_scores(c) * area;
+                }
+            }
+        }
+        benchmark::DoNotOptimize(weighted.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, num_boxes * num_classes, 2 * sizeof(float));
+}
+BENCHMARK(BM_per_box)->ArgNames({"boxes", "static"})->ArgsProduct({{1 << 10, 1 << 14}, {0, 1}});
+
+/* Sum over the axis given by the third argument */
+void BM_reduce_axis(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const size_t axis = state.range(2);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    const size_t src_shape[] = {operands.outer, inner_size, inner_size};
+    size_t shape[2];
+    std::copy(src_shape, src_shape + axis, shape);
+    std::copy(src_shape + axis + 1, src_shape + 3, shape + axis);
+    Tensor<float, 2> dst(shape);
+    for (auto _ : state) {
+        operands.src.sum(dst, axis);
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_reduce_axis)->ArgNames({"n", "layout", "axis"})->ArgsProduct({
+        {1 << 16, 1 << 22}, {contiguous_layout, permuted_layout, sliced_layout}, {0, 1, 2}});
+
+void BM_softmax(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const size_t axis = state.range(2);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    for (auto _ : state) {
+        softmax(operands.src, operands.dst, axis);
+        benchmark::DoNotOptimize(operands.dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_softmax)->ArgNames({"n", "layout", "axis"})->ArgsProduct({
+        {1 << 16, 1 << 22}, {contiguous_layout, permuted_layout, sliced_layout}, {1, 2}});
+
+/* Contiguous copy of a transposed [n / 1024, 1024] matrix */
+void BM_permute_copy(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const size_t cols = 1024;
+    std::vector<float> src(n), dst(n);
+    std::iota(src.begin(), src.end(), 0.f);
+    auto src_view = make_view(src.data(), {n / cols, cols}).permute(1, 0);
+    auto dst_view = make_view(dst.data(), {cols, n / cols});
+    for (auto _ : state) {
+        dst_view.assign_(src_view);
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+}
+BENCHMARK(BM_permute_copy)->Apply(size_args);
+
+void BM_naive_permute_copy(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const size_t cols = 1024;
+    std::vector<float> src(n), dst(n);
+    std::iota(src.begin(), src.end(), 0.f);
+    for (auto _ : state) {
+        for (size_t i = 0; i < cols; ++i) {
+            for (size_t j = 0; j < n / cols; ++j) {
+                dst[i * (n / cols) + j] = src[j * cols + i];
+            }
+        }
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    set_counters(state, n, 2 * sizeof(float));
+}
+BENCHMARK(BM_naive_permute_copy)->Apply(size_args);
+
+/* Printing is summarized, the time must not depend on n */
+void BM_print(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Operands operands(n, static_cast<Layout>(state.range(1)));
+    std::ostringstream stream;
+    for (auto _ : state) {
+        stream.str("");
+        stream << operands.src;
+        benchmark::DoNotOptimize(stream);
+    }
+    state.SetLabel(layout_name(state.range(1)));
+}
+BENCHMARK(BM_print)->Apply(layout_args);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+#include "TensorViewFwd.h"
+
+namespace tensor_view {
+
+/* Tag for constructors, which leave elements of trivially constructible types uninitialized */
+struct uninitialized_t {
+};
+
+constexpr uninitialized_t uninitialized{};
+
+
+/* Allocator returning memory aligned to Alignment bytes (a cache line by default).
+ * The original pointer is stored right before the aligned block. */
+template<class T, size_t Alignment>
+class AlignedAllocator {
+    static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+                  "Alignment must be a power of two not less than alignment of the type");
+
+public:
+    using value_type = T;
+    static constexpr size_t alignment = Alignment;
+
+    template<class U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template<class U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        const size_t overhead = Alignment - 1 + sizeof(void*);
+        if (n > (std::numeric_limits<size_t>::max() - overhead) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        void* raw = ::operator new(n * sizeof(T) + overhead);
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + overhead) & ~static_cast<uintptr_t>(Alignment - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* ptr, size_t) {
+        if (ptr) {
+            ::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+        }
+    }
+
+    template<class U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const {
+        return true;
+    }
+
+    template<class U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+        return false;
+    }
+};
+
+template<class T, size_t Alignment>
+constexpr size_t AlignedAllocator<T, Alignment>::alignment;
+
+} // namespace
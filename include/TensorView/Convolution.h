@@ -0,0 +1,436 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+#include "MatMul.h"
+#include "Tensor.h"
+#include "TensorView.h"
+#include "Workspace.h"
+
+namespace tensor_view {
+
+/* Parameters of conv2d, index 0 - height, 1 - width */
+struct Conv2dParams {
+    size_t stride[2] = {1, 1};
+    size_t padding[2] = {0, 0};
+    size_t dilation[2] = {1, 1};
+    size_t groups = 1;
+};
+
+/* Parameters of max_pool2d / avg_pool2d, index 0 - height, 1 - width. Zero stride is the kernel size. */
+struct Pool2dParams {
+    size_t kernel[2] = {2, 2};
+    size_t stride[2] = {0, 0};
+    size_t padding[2] = {0, 0};
+    bool count_include_pad = true; // average is taken over the whole kernel (true) or over non-padded elements
+};
+
+/* Output size of a convolution or pooling along a dim */
+inline size_t conv_output_size(size_t input, size_t kernel, size_t stride, size_t padding, size_t dilation = 1) {
+    const size_t extent = dilation * (kernel - 1) + 1;
+    TV_ASSERT(kernel > 0 && stride > 0 && dilation > 0, "Incorrect parameters of convolution")
+    TV_ASSERT(input + 2 * padding >= extent, "Kernel is larger than padded input")
+    return (input + 2 * padding - extent) / stride + 1;
+}
+
+namespace detail {
+
+/* Range [begin, end) of outputs o < count, for which o * stride + offset is within [0, size) */
+inline void valid_range(ptrdiff_t offset, size_t stride, size_t size, size_t count, size_t& begin, size_t& end) {
+    const ptrdiff_t s = static_cast<ptrdiff_t>(stride);
+    begin = offset >= 0 ? 0 : static_cast<size_t>((-offset + s - 1) / s);
+    end = offset >= static_cast<ptrdiff_t>(size) ? 0
+                                                 : std::min(count, static_cast<size_t>(
+                                                         (static_cast<ptrdiff_t>(size) - 1 - offset) / s + 1));
+    begin = std::min(begin, end);
+}
+
+/* Shapes of a convolution of a single group */
+struct Conv2dGeometry {
+    size_t channels; // input channels of a group
+    size_t input[2];
+    size_t kernel[2];
+    size_t output[2];
+    Conv2dParams params;
+
+    ptrdiff_t offset(size_t dim, size_t k) const {
+        return static_cast<ptrdiff_t>(k * params.dilation[dim]) - static_cast<ptrdiff_t>(params.padding[dim]);
+    }
+};
+
+/* Unfolds input channels (strides of channel, row and column) into a contiguous matrix
+ * [channels * kernel height * kernel width, output height * output width]. Taps in padding are zero. */
+template<class T>
+void im2col(const T* src, const ptrdiff_t (&stride)[3], const Conv2dGeometry& g, T* columns) {
+    const size_t out_h = g.output[0];
+    const size_t out_w = g.output[1];
+    const size_t step_h = g.params.stride[0];
+    const size_t step_w = g.params.stride[1];
+    for (size_t c = 0; c < g.channels; ++c) {
+        for (size_t i = 0; i < g.kernel[0]; ++i) {
+            size_t h_begin, h_end;
+            valid_range(g.offset(0, i), step_h, g.input[0], out_h, h_begin, h_end);
+            for (size_t j = 0; j < g.kernel[1]; ++j) {
+                size_t w_begin, w_end;
+                valid_range(g.offset(1, j), step_w, g.input[1], out_w, w_begin, w_end);
+                for (size_t y = 0; y < out_h; ++y, columns += out_w) {
+                    if (y < h_begin || y >= h_end) {
+                        std::fill(columns, columns + out_w, T(0));
+                        continue;
+                    }
+                    const ptrdiff_t h = static_cast<ptrdiff_t>(y * step_h) + g.offset(0, i);
+                    const ptrdiff_t w = static_cast<ptrdiff_t>(w_begin * step_w) + g.offset(1, j);
+                    std::fill(columns, columns + w_begin, T(0));
+                    copy_strided(src + static_cast<ptrdiff_t>(c) * stride[0] + h * stride[1] + w * stride[2],
+                                 columns + w_begin, w_end - w_begin, static_cast<ptrdiff_t>(step_w) * stride[2], 1);
+                    std::fill(columns + w_end, columns + out_w, T(0));
+                }
+            }
+        }
+    }
+}
+
+/* dst = src + bias for a plane of contiguous src and strided dst, src may be dst */
+template<class T>
+void store_plane(const T* src, T bias, T* dst, size_t height, size_t width, ptrdiff_t row_stride,
+                 ptrdiff_t col_stride) {
+    for (size_t y = 0; y < height; ++y) {
+        const T* src_row = src + y * width;
+        T* dst_row = dst + static_cast<ptrdiff_t>(y) * row_stride;
+        if (col_stride == 1) {
+            transform(bind_rhs(std::plus<T>(), bias), src_row, dst_row, width);
+            continue;
+        }
+        for (size_t x = 0; x < width; ++x) {
+            dst_row[static_cast<ptrdiff_t>(x) * col_stride] = src_row[x] + bias;
+        }
+    }
+}
+
+/* Convolution with a single input channel per group (depthwise): every tap of the kernel adds a shifted input
+ * plane multiplied by the weight to the output plane */
+template<class T>
+void conv2d_depthwise(const T* input, const ptrdiff_t (&input_stride)[4], const T* weight,
+                      const ptrdiff_t (&weight_stride)[4], const T* bias, ptrdiff_t bias_stride, T* dst,
+                      const ptrdiff_t (&dst_stride)[4], size_t batch, size_t filters, const Conv2dGeometry& g,
+                      const ExecutionPolicy& policy) {
+    const size_t out_h = g.output[0];
+    const size_t out_w = g.output[1];
+    const size_t multiplier = filters / g.params.groups;
+    const size_t step_w = g.params.stride[1];
+
+    parallel_for(policy, batch * filters, out_h * out_w * g.kernel[0] * g.kernel[1], [&](size_t begin, size_t end) {
+        WorkspaceScope scope;
+        T* plane = static_cast<T*>(Workspace::local().allocate(out_h * out_w * sizeof(T)));
+        for (size_t item = begin; item < end; ++item) {
+            const size_t n = item / filters;
+            const size_t f = item % filters;
+            const T* src = input + static_cast<ptrdiff_t>(n) * input_stride[0] +
+                           static_cast<ptrdiff_t>(f / multiplier) * input_stride[1];
+            std::fill(plane, plane + out_h * out_w, T(0));
+            for (size_t i = 0; i < g.kernel[0]; ++i) {
+                size_t h_begin, h_end;
+                valid_range(g.offset(0, i), g.params.stride[0], g.input[0], out_h, h_begin, h_end);
+                for (size_t j = 0; j < g.kernel[1]; ++j) {
+                    size_t w_begin, w_end;
+                    valid_range(g.offset(1, j), step_w, g.input[1], out_w, w_begin, w_end);
+                    const T w = weight[static_cast<ptrdiff_t>(f) * weight_stride[0] +
+                                       static_cast<ptrdiff_t>(i) * weight_stride[2] +
+                                       static_cast<ptrdiff_t>(j) * weight_stride[3]];
+                    const ptrdiff_t src_step = static_cast<ptrdiff_t>(step_w) * input_stride[3];
+                    for (size_t y = h_begin; y < h_end; ++y) {
+                        const ptrdiff_t h = static_cast<ptrdiff_t>(y * g.params.stride[0]) + g.offset(0, i);
+                        const ptrdiff_t x = static_cast<ptrdiff_t>(w_begin * step_w) + g.offset(1, j);
+                        const T* src_row = src + h * input_stride[2] + x * input_stride[3];
+                        T* row = plane + y * out_w + w_begin;
+                        if (src_step == 1) {
+                            scale_add(w, src_row, row, w_end - w_begin);
+                            continue;
+                        }
+                        for (size_t k = 0; k < w_end - w_begin; ++k) {
+                            row[k] += w * src_row[static_cast<ptrdiff_t>(k) * src_step];
+                        }
+                    }
+                }
+            }
+            store_plane(plane, bias ? bias[static_cast<ptrdiff_t>(f) * bias_stride] : T(0),
+                        dst + static_cast<ptrdiff_t>(n) * dst_stride[0] + static_cast<ptrdiff_t>(f) * dst_stride[1],
+                        out_h, out_w, dst_stride[2], dst_stride[3]);
+        }
+    });
+}
+
+template<class TTensorView>
+void view_strides(const TTensorView& view, ptrdiff_t (&strides)[4]) {
+    for (size_t i = 0; i < 4; ++i) {
+        strides[i] = static_cast<ptrdiff_t>(view.stride()[i]);
+    }
+}
+
+/* Convolution as a matrix product of the weight of every group [filters, channels * kernel area] and unfolded
+ * input [channels * kernel area, output area]. Pointwise convolutions multiply by the input without unfolding. */
+template<class TInput, class TWeight, class TDst>
+void conv2d_impl(const TInput& input, const TWeight& weight, const typename TDst::ValueType* bias,
+                 ptrdiff_t bias_stride, TDst& dst, const Conv2dParams& params, const ExecutionPolicy& policy) {
+    using T = typename TDst::ValueType;
+    static_assert(TInput::NumDims == 4 && TWeight::NumDims == 4 && TDst::NumDims == 4,
+                  "Convolution needs 4-D tensors (NCHW input and output, OIHW weight)");
+    static_assert(std::is_same<std::remove_const_t<typename TInput::ValueType>, T>::value &&
+                  std::is_same<std::remove_const_t<typename TWeight::ValueType>, T>::value,
+                  "Convolution needs tensors of the same type");
+    const size_t batch = input.size(0);
+    const size_t channels = input.size(1);
+    const size_t filters = weight.size(0);
+    const size_t groups = params.groups;
+    TV_ASSERT(groups > 0 && channels % groups == 0 && filters % groups == 0,
+              "Numbers of channels are not divisible by groups")
+    TV_ASSERT(weight.size(1) == channels / groups, "Incorrect shape of weight tensor")
+
+    Conv2dGeometry g{channels / groups, {input.size(2), input.size(3)}, {weight.size(2), weight.size(3)}, {}, params};
+    for (size_t i = 0; i < 2; ++i) {
+        g.output[i] = conv_output_size(g.input[i], g.kernel[i], params.stride[i], params.padding[i],
+                                       params.dilation[i]);
+    }
+    TV_ASSERT(dst.size(0) == batch && dst.size(1) == filters && dst.size(2) == g.output[0] &&
+              dst.size(3) == g.output[1], "Incorrect shape of destination tensor")
+    if (batch == 0 || filters == 0) {
+        return;
+    }
+
+    ptrdiff_t input_stride[4], weight_stride[4], dst_stride[4];
+    view_strides(input, input_stride);
+    view_strides(weight, weight_stride);
+    view_strides(dst, dst_stride);
+    if (g.channels == 1) {
+        conv2d_depthwise(input.data(), input_stride, weight.data(), weight_stride, bias, bias_stride, dst.data(),
+                         dst_stride, batch, filters, g, policy);
+        return;
+    }
+
+    /* weight of a group is a matrix if dims (channels, kernel height, kernel width) can be traversed as one */
+    WorkspaceScope scope;
+    const size_t kernel_area = g.kernel[0] * g.kernel[1];
+    const T* weight_data = weight.data();
+    if (weight_stride[2] != static_cast<ptrdiff_t>(g.kernel[1]) * weight_stride[3] ||
+        weight_stride[1] != static_cast<ptrdiff_t>(g.kernel[0]) * weight_stride[2]) {
+        T* packed = static_cast<T*>(Workspace::local().allocate(weight.num_elements() * sizeof(T)));
+        TensorView<T, 4> packed_weight(packed, weight.shape());
+        packed_weight.assign_(weight, policy);
+        weight_data = packed;
+        view_strides(packed_weight, weight_stride);
+    }
+
+    const size_t group_filters = filters / groups;
+    const size_t depth = g.channels * kernel_area;
+    const size_t area = g.output[0] * g.output[1];
+    const bool pointwise = kernel_area == 1 && params.stride[0] == 1 && params.stride[1] == 1 &&
+                           params.padding[0] == 0 && params.padding[1] == 0 &&
+                           (g.input[0] == 1 || input_stride[2] == static_cast<ptrdiff_t>(g.input[1]) * input_stride[3]);
+    const bool contiguous_planes = g.output[0] == 1 ||
+                                   dst_stride[2] == static_cast<ptrdiff_t>(g.output[1]) * dst_stride[3];
+
+    parallel_for(policy, batch * groups, group_filters * area * depth, [&](size_t begin, size_t end) {
+        WorkspaceScope item_scope;
+        Workspace& workspace = Workspace::local();
+        T* columns = pointwise ? nullptr : static_cast<T*>(workspace.allocate(depth * area * sizeof(T)));
+        T* product = contiguous_planes ? nullptr : static_cast<T*>(workspace.allocate(group_filters * area * sizeof(T)));
+        for (size_t item = begin; item < end; ++item) {
+            const size_t n = item / groups;
+            const size_t group = item % groups;
+            const T* src = input.data() + static_cast<ptrdiff_t>(n) * input_stride[0] +
+                           static_cast<ptrdiff_t>(group * g.channels) * input_stride[1];
+            T* out = dst.data() + static_cast<ptrdiff_t>(n) * dst_stride[0] +
+                     static_cast<ptrdiff_t>(group * group_filters) * dst_stride[1];
+
+            MatrixBatch<const T> lhs{weight_data + static_cast<ptrdiff_t>(group * group_filters) * weight_stride[0],
+                                     1, group_filters, depth, 0, weight_stride[0], weight_stride[3]};
+            MatrixBatch<const T> rhs{src, 1, depth, area, 0, input_stride[1], input_stride[3]};
+            if (!pointwise) {
+                const ptrdiff_t plane_stride[] = {input_stride[1], input_stride[2], input_stride[3]};
+                im2col(src, plane_stride, g, columns);
+                rhs = {columns, 1, depth, area, 0, static_cast<ptrdiff_t>(area), 1};
+            }
+            MatrixBatch<T> result{out, 1, group_filters, area, 0, dst_stride[1], dst_stride[3]};
+            if (product) {
+                result = {product, 1, group_filters, area, 0, static_cast<ptrdiff_t>(area), 1};
+            }
+            matmul_impl(lhs, rhs, result, policy);
+
+            if (!product && !bias) {
+                continue;
+            }
+            for (size_t f = 0; f < group_filters; ++f) {
+                T* plane = out + static_cast<ptrdiff_t>(f) * dst_stride[1];
+                const T* values = product ? product + f * area : plane;
+                const T value = bias ? bias[static_cast<ptrdiff_t>(group * group_filters + f) * bias_stride] : T(0);
+                if (!product) {
+                    /* bias of a contiguous plane */
+                    transform_strided(bind_rhs(std::plus<T>(), value), plane, plane, area, dst_stride[3], dst_stride[3]);
+                    continue;
+                }
+                store_plane(values, value, plane, g.output[0], g.output[1], dst_stride[2], dst_stride[3]);
+            }
+        }
+    });
+}
+
+/* Max or average pooling of every plane, row by row: a row of the output is combined from strided input rows
+ * of all kernel taps with vectorized transform */
+template<bool Max, class TSrc, class TDst>
+void pool2d_impl(const TSrc& src, TDst& dst, const Pool2dParams& params, const ExecutionPolicy& policy) {
+    using T = typename TDst::ValueType;
+    static_assert(TSrc::NumDims == 4 && TDst::NumDims == 4, "Pooling needs 4-D (NCHW) tensors");
+    static_assert(std::is_same<std::remove_const_t<typename TSrc::ValueType>, T>::value,
+                  "Pooling needs tensors of the same type");
+    size_t stride[2], output[2];
+    for (size_t i = 0; i < 2; ++i) {
+        stride[i] = params.stride[i] == 0 ? params.kernel[i] : params.stride[i];
+        TV_ASSERT(params.padding[i] * 2 <= params.kernel[i], "Padding must be at most half of pooling kernel")
+        output[i] = conv_output_size(src.size(2 + i), params.kernel[i], stride[i], params.padding[i]);
+    }
+    TV_ASSERT(dst.size(0) == src.size(0) && dst.size(1) == src.size(1) && dst.size(2) == output[0] &&
+              dst.size(3) == output[1], "Incorrect shape of destination tensor")
+    ptrdiff_t src_stride[4], dst_stride[4];
+    view_strides(src, src_stride);
+    view_strides(dst, dst_stride);
+    const size_t height = src.size(2);
+    const size_t width = src.size(3);
+    const size_t channels = src.size(1);
+    const T initial = Max ? (std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                                  : std::numeric_limits<T>::lowest())
+                          : T(0);
+
+    parallel_for(policy, src.size(0) * channels, output[0] * output[1] * params.kernel[0] * params.kernel[1],
+                 [&](size_t begin, size_t end) {
+        WorkspaceScope scope;
+        T* row = static_cast<T*>(Workspace::local().allocate(output[1] * sizeof(T)));
+        for (size_t item = begin; item < end; ++item) {
+            const T* plane = src.data() + static_cast<ptrdiff_t>(item / channels) * src_stride[0] +
+                             static_cast<ptrdiff_t>(item % channels) * src_stride[1];
+            T* out = dst.data() + static_cast<ptrdiff_t>(item / channels) * dst_stride[0] +
+                     static_cast<ptrdiff_t>(item % channels) * dst_stride[1];
+            for (size_t y = 0; y < output[0]; ++y) {
+                std::fill(row, row + output[1], initial);
+                size_t rows = 0;
+                for (size_t i = 0; i < params.kernel[0]; ++i) {
+                    const ptrdiff_t h = static_cast<ptrdiff_t>(y * stride[0] + i) -
+                                        static_cast<ptrdiff_t>(params.padding[0]);
+                    if (h < 0 || h >= static_cast<ptrdiff_t>(height)) {
+                        continue;
+                    }
+                    ++rows;
+                    for (size_t j = 0; j < params.kernel[1]; ++j) {
+                        const ptrdiff_t offset = static_cast<ptrdiff_t>(j) - static_cast<ptrdiff_t>(params.padding[1]);
+                        size_t x_begin, x_end;
+                        valid_range(offset, stride[1], width, output[1], x_begin, x_end);
+                        const T* src_row = plane + h * src_stride[2] +
+                                           (static_cast<ptrdiff_t>(x_begin * stride[1]) + offset) * src_stride[3];
+                        const ptrdiff_t step = static_cast<ptrdiff_t>(stride[1]) * src_stride[3];
+                        if (Max) {
+                            transform_strided(maximum<T>(), row + x_begin, src_row, row + x_begin,
+                                              x_end - x_begin, 1, step, 1);
+                        } else {
+                            transform_strided(std::plus<T>(), row + x_begin, src_row, row + x_begin,
+                                              x_end - x_begin, 1, step, 1);
+                        }
+                    }
+                }
+
+                T* out_row = out + static_cast<ptrdiff_t>(y) * dst_stride[2];
+                for (size_t x = 0; x < output[1]; ++x) {
+                    T value = row[x];
+                    if (!Max) {
+                        size_t count = params.kernel[0] * params.kernel[1];
+                        if (!params.count_include_pad) {
+                            size_t x_begin, x_end;
+                            const ptrdiff_t w = static_cast<ptrdiff_t>(x * stride[1]) -
+                                                static_cast<ptrdiff_t>(params.padding[1]);
+                            valid_range(w, 1, width, params.kernel[1], x_begin, x_end);
+                            count = rows * (x_end - x_begin);
+                        }
+                        value = static_cast<T>(value / static_cast<T>(count));
+                    }
+                    out_row[static_cast<ptrdiff_t>(x) * dst_stride[3]] = value;
+                }
+            }
+        }
+    });
+}
+
+} // detail
+
+/* 2-D convolution (cross-correlation) of NCHW input with OIHW weight into NCHW dst:
+ * dst[n, o, y, x] = sum over c, i, j of input[n, g * C / groups + c, y * stride + i * dilation - padding,
+ *                                             x * stride + j * dilation - padding] * weight[o, c, i, j],
+ * g is the group of the output channel o. Input taps in padding are zero, see conv_output_size() for the size of dst.
+ * Depthwise convolutions (one input channel per group) are computed directly, others as matrix products. */
+template<class TInput, class TWeight, class TDst, std::enable_if_t<is_tensor_view_v<TDst>, int> = 0>
+void conv2d(const TInput& input, const TWeight& weight, TDst& dst, const Conv2dParams& params = Conv2dParams(),
+            const ExecutionPolicy& policy = get_execution_policy()) {
+    detail::conv2d_impl(input, weight, nullptr, 0, dst, params, policy);
+}
+
+/* Convolution with a bias added to every output channel */
+template<class TInput, class TWeight, class TBias, class TDst, std::enable_if_t<is_tensor_view_v<TDst>, int> = 0>
+void conv2d(const TInput& input, const TWeight& weight, const TBias& bias, TDst& dst,
+            const Conv2dParams& params = Conv2dParams(), const ExecutionPolicy& policy = get_execution_policy()) {
+    static_assert(TBias::NumDims == 1, "Bias must be 1-D tensor");
+    TV_ASSERT(bias.size(0) == weight.size(0), "Incorrect shape of bias tensor")
+    detail::conv2d_impl(input, weight, bias.data(), static_cast<ptrdiff_t>(bias.stride()[0]), dst, params, policy);
+}
+
+/* Maximum over pooling windows of NCHW src, padding is ignored */
+template<class TSrc, class TDst>
+void max_pool2d(const TSrc& src, TDst& dst, const Pool2dParams& params = Pool2dParams(),
+                const ExecutionPolicy& policy = get_execution_policy()) {
+    detail::pool2d_impl<true>(src, dst, params, policy);
+}
+
+/* Average over pooling windows of NCHW src, padding counts as zeros if params.count_include_pad */
+template<class TSrc, class TDst>
+void avg_pool2d(const TSrc& src, TDst& dst, const Pool2dParams& params = Pool2dParams(),
+                const ExecutionPolicy& policy = get_execution_policy()) {
+    detail::pool2d_impl<false>(src, dst, params, policy);
+}
+
+/* Average of every plane of NCHW src into dst of shape [N, C] or [N, C, 1, 1] */
+template<class TSrc, class TDst>
+void global_avg_pool2d(const TSrc& src, TDst& dst, const ExecutionPolicy& policy = get_execution_policy()) {
+    using T = typename TDst::ValueType;
+    static_assert(TSrc::NumDims == 4 && (TDst::NumDims == 2 || TDst::NumDims == 4),
+                  "Global pooling needs 4-D src and 2-D or 4-D dst");
+    TV_ASSERT(dst.size(0) == src.size(0) && dst.size(1) == src.size(1) &&
+              (TDst::NumDims == 2 || dst.num_elements() == src.size(0) * src.size(1)),
+              "Incorrect shape of destination tensor")
+    const size_t channels = src.size(1);
+    const size_t height = src.size(2);
+    const size_t width = src.size(3);
+    const ptrdiff_t row_stride = static_cast<ptrdiff_t>(src.stride()[2]);
+    const ptrdiff_t col_stride = static_cast<ptrdiff_t>(src.stride()[3]);
+    const bool contiguous = height == 1 || row_stride == static_cast<ptrdiff_t>(width) * col_stride;
+
+    detail::parallel_for(policy, src.size(0) * channels, height * width, [&](size_t begin, size_t end) {
+        for (size_t item = begin; item < end; ++item) {
+            const T* plane = src.data() + static_cast<ptrdiff_t>(item / channels * src.stride()[0]) +
+                             static_cast<ptrdiff_t>(item % channels * src.stride()[1]);
+            T sum = 0;
+            if (contiguous && col_stride == 1) {
+                sum = detail::accumulate(std::plus<T>(), plane, height * width, T(0));
+            } else {
+                for (size_t y = 0; y < height; ++y) {
+                    for (size_t x = 0; x < width; ++x) {
+                        sum += plane[static_cast<ptrdiff_t>(y) * row_stride + static_cast<ptrdiff_t>(x) * col_stride];
+                    }
+                }
+            }
+            dst.data()[static_cast<ptrdiff_t>(item / channels * dst.stride()[0]) +
+                       static_cast<ptrdiff_t>(item % channels * dst.stride()[1])] =
+                    static_cast<T>(sum / static_cast<T>(height * width));
+        }
+    });
+}
+
+} // namespace tensor_view
@@ -1,17 +1,23 @@
 #pragma once
 
-#include <cstddef>
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <limits>
+#include <utility>
 #include "Traits.h"
 
 namespace tensor_view {
 
+/* Offset of an element. Strides are stored as size_t, negative strides (of flipped views) wrap around
+ * and are read back as ptrdiff_t. */
 template<size_t N, size_t K>
 class CalculateOffsetImpl {
 public:
     template<typename V, typename... Vs>
-    static size_t calculate(size_t offset, const size_t* stride, V i, Vs&& ... vs) {
-        return CalculateOffsetImpl<N - 1, K>::calculate(offset + stride[K - N] * i, stride, vs...);
+    static ptrdiff_t calculate(ptrdiff_t offset, const size_t* stride, V i, Vs&& ... vs) {
+        return CalculateOffsetImpl<N - 1, K>::calculate(
+                offset + static_cast<ptrdiff_t>(stride[K - N]) * static_cast<ptrdiff_t>(i), stride, vs...);
     }
 };
 
@@ -19,11 +25,146 @@ template<size_t K>
 class CalculateOffsetImpl<0, K> {
 public:
     template<typename V>
-    static size_t calculate(size_t offset, const size_t* stride, V i) {
-        return offset + stride[K] * i;
+    static ptrdiff_t calculate(ptrdiff_t offset, const size_t* stride, V i) {
+        return offset + static_cast<ptrdiff_t>(stride[K]) * static_cast<ptrdiff_t>(i);
+    }
+};
+
+template<size_t... Dims>
+struct Extents;
+
+namespace detail {
+
+/* Row-major strides of extents as an array */
+template<class TExtents, class TIndices>
+struct extents_strides;
+
+template<class TExtents, size_t... I>
+struct extents_strides<TExtents, std::index_sequence<I...>> {
+    static constexpr size_t value[sizeof...(I)] = {TExtents::stride(I)...};
+};
+
+template<class TExtents, size_t... I>
+constexpr size_t extents_strides<TExtents, std::index_sequence<I...>>::value[];
+
+} // detail
+
+/* Shape known at compile time, e.g. Extents<80, 4>. Strides are row-major, so that offsets of elements are constant
+ * expressions of indices and compile to immediate multiplications (or shifts). */
+template<size_t... Dims>
+struct Extents {
+    static_assert(sizeof...(Dims) > 0, "Extents need at least one dimension");
+
+    static constexpr size_t NumDims = sizeof...(Dims);
+    static constexpr size_t shape[NumDims] = {Dims...};
+
+    static constexpr size_t size(size_t dim) {
+        return shape[dim];
+    }
+
+    static constexpr size_t stride(size_t dim) {
+        size_t result = 1;
+        for (size_t i = dim + 1; i < NumDims; ++i) {
+            result *= shape[i];
+        }
+        return result;
+    }
+
+    static constexpr size_t num_elements() {
+        return stride(0) * shape[0];
+    }
+
+    static constexpr const size_t* strides() {
+        return detail::extents_strides<Extents, std::make_index_sequence<NumDims>>::value;
+    }
+
+    /* Offset of the element (or of the sub-view) with the leading indices inds */
+    template<typename... TInds>
+    static constexpr ptrdiff_t offset(TInds... inds) {
+        static_assert(sizeof...(TInds) <= NumDims, "Too many indices");
+        const ptrdiff_t indices[] = {static_cast<ptrdiff_t>(inds)...};
+        ptrdiff_t result = 0;
+        for (size_t i = 0; i < sizeof...(TInds); ++i) {
+            result += indices[i] * static_cast<ptrdiff_t>(stride(i));
+        }
+        return result;
+    }
+};
+
+template<size_t... Dims>
+constexpr size_t Extents<Dims...>::shape[];
+
+namespace detail {
+
+/* Extents without the first N dimensions */
+template<size_t N, class TExtents>
+struct drop_extents;
+
+template<size_t N, size_t Dim, size_t... Dims>
+struct drop_extents<N, Extents<Dim, Dims...>> {
+    using type = typename drop_extents<N - 1, Extents<Dims...>>::type;
+};
+
+template<size_t Dim, size_t... Dims>
+struct drop_extents<0, Extents<Dim, Dims...>> {
+    using type = Extents<Dim, Dims...>;
+};
+
+} // detail
+
+/* Indices start:stop:step of a dimension, as in Python slicing. Negative start and stop count from the end,
+ * out of range bounds are clamped, omitted bounds (Range::none) extend to the end in the direction of the step. */
+struct Range {
+    static constexpr ptrdiff_t none = std::numeric_limits<ptrdiff_t>::min();
+
+    ptrdiff_t start;
+    ptrdiff_t stop;
+    ptrdiff_t step;
+
+    constexpr Range(ptrdiff_t start = none, ptrdiff_t stop = none, ptrdiff_t step = 1) :
+            start(start),
+            stop(stop),
+            step(step) {
     }
 };
 
+namespace detail {
+
+/* First index and number of indices of the range in a dimension of the given size */
+inline void resolve_range(const Range& range, size_t size, ptrdiff_t& start, size_t& length) {
+    const ptrdiff_t n = static_cast<ptrdiff_t>(size);
+    const ptrdiff_t step = range.step;
+    const ptrdiff_t lower = step > 0 ? 0 : -1;
+    const ptrdiff_t upper = step > 0 ? n : n - 1;
+    auto clamp = [&](ptrdiff_t index, ptrdiff_t default_index) {
+        if (index == Range::none) {
+            return default_index;
+        }
+        if (index < 0) {
+            return std::max(index + n, lower);
+        }
+        return std::min(index, upper);
+    };
+    start = clamp(range.start, step > 0 ? lower : upper);
+    ptrdiff_t stop = clamp(range.stop, step > 0 ? upper : lower);
+    if (step > 0) {
+        length = stop > start ? static_cast<size_t>((stop - start + step - 1) / step) : 0;
+    } else {
+        length = start > stop ? static_cast<size_t>((start - stop - step - 1) / -step) : 0;
+    }
+}
+
+template<class ...Ts>
+struct all_ranges : std::true_type {
+};
+
+template<class T, class ...Ts>
+struct all_ranges<T, Ts...>
+        : std::integral_constant<bool, std::is_same<std::decay_t<T>, Range>::value && all_ranges<Ts...>::value> {
+};
+
+} // detail
+
 inline void calculate_strides(const size_t* shapes, size_t* strides, size_t ndim) {
     size_t prod = 1;
     for (int i = ndim - 1; i >= 0; --i) {
@@ -36,7 +177,7 @@ inline void calculate_strides(const size_t* shapes, size_t* strides, size_t ndim
 namespace detail {
 
 template<class TensorViewLhs, class TensorViewRhs>
-bool check_shapes(TensorViewLhs first, TensorViewRhs second, implicit_broadcast) {
+bool check_shapes(const TensorViewLhs& first, const TensorViewRhs& second, implicit_broadcast) {
     size_t ndims = std::min(TensorViewLhs::NumDims, TensorViewRhs::NumDims);
     for (int i = 0; i < ndims; ++i) {
         size_t size_lhs = first.size(TensorViewLhs::NumDims - i - 1);
@@ -49,7 +190,7 @@ bool check_shapes(TensorViewLhs first, TensorViewRhs second, implicit_broadcast)
 }
 
 template<class TensorViewLhs, class TensorViewRhs>
-bool check_shapes(TensorViewLhs first, TensorViewRhs second, explicit_broadcast) {
+bool check_shapes(const TensorViewLhs& first, const TensorViewRhs& second, explicit_broadcast) {
     if (TensorViewLhs::NumDims != TensorViewRhs::NumDims) {
         return false;
     }
@@ -57,7 +198,7 @@ bool check_shapes(TensorViewLhs first, TensorViewRhs second, explicit_broadcast)
 }
 
 template<class TensorViewLhs, class TensorViewRhs>
-bool check_shapes(TensorViewLhs first, TensorViewRhs second, disable_broadcast) {
+bool check_shapes(const TensorViewLhs& first, const TensorViewRhs& second, disable_broadcast) {
     if (TensorViewLhs::NumDims != TensorViewRhs::NumDims) {
         return false;
     }
@@ -72,7 +213,7 @@ bool check_shapes(TensorViewLhs first, TensorViewRhs second, disable_broadcast)
 } // detail
 
 template<class TensorViewLhs, class TensorViewRhs>
-bool check_shapes(TensorViewLhs first, TensorViewRhs second) {
+bool check_shapes(const TensorViewLhs& first, const TensorViewRhs& second) {
     using LhsType = TensorViewChecked<TensorViewLhs>;
     using RhsType = TensorViewChecked<TensorViewRhs>;
     typename RhsType::BroadcastPolicyTag broadcast_tag;
@@ -0,0 +1,462 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MatMul.h"
+#include "Tensor.h"
+#include "Workspace.h"
+
+namespace tensor_view {
+
+namespace detail {
+
+/* Maximal number of distinct labels of an einsum operand */
+const size_t einsum_max_dims = 16;
+
+/* Operand of a contraction with the number of dims known at runtime, one distinct label per dim */
+template<class T>
+struct EinsumOperand {
+    T* data;
+    std::string labels;
+    std::vector<size_t> shape;
+    std::vector<ptrdiff_t> stride;
+
+    bool has(char label) const {
+        return labels.find(label) != std::string::npos;
+    }
+
+    size_t size(char label) const {
+        return shape[labels.find(label)];
+    }
+
+    ptrdiff_t stride_of(char label) const {
+        const size_t i = labels.find(label);
+        return i == std::string::npos ? 0 : stride[i];
+    }
+
+    size_t num_elements() const {
+        size_t result = 1;
+        for (size_t size : shape) {
+            result *= size;
+        }
+        return result;
+    }
+};
+
+template<class T>
+EinsumOperand<const T> as_const(const EinsumOperand<T>& operand) {
+    return {operand.data, operand.labels, operand.shape, operand.stride};
+}
+
+/* Operand for a view with the given labels. Dims with the same label are merged into one with the sum of strides,
+ * i.e. into the diagonal, without copying. */
+template<class TTensorView>
+EinsumOperand<std::remove_reference_t<decltype(*std::declval<TTensorView&>().data())>>
+einsum_operand(TTensorView& view, const std::string& labels) {
+    TV_ASSERT(labels.size() == TTensorView::NumDims, "Number of einsum labels differs from number of dims of tensor")
+    EinsumOperand<std::remove_reference_t<decltype(*view.data())>> operand{view.data(), {}, {}, {}};
+    for (size_t i = 0; i < labels.size(); ++i) {
+        const ptrdiff_t stride = static_cast<ptrdiff_t>(view.stride()[i]);
+        const size_t j = operand.labels.find(labels[i]);
+        if (j != std::string::npos) {
+            TV_ASSERT(operand.shape[j] == view.size(i), "Dims with the same einsum label have different sizes")
+            operand.stride[j] += stride;
+            continue;
+        }
+        operand.labels += labels[i];
+        operand.shape.push_back(view.size(i));
+        operand.stride.push_back(stride);
+    }
+    TV_ASSERT(operand.labels.size() <= einsum_max_dims, "Too many dims of einsum operand")
+    return operand;
+}
+
+/* Contiguous operand with dims in the order of labels, sizes are taken from a or b */
+template<class T, class U>
+EinsumOperand<T> contiguous_operand(T* data, const std::string& labels, const EinsumOperand<U>& a,
+                                    const EinsumOperand<U>& b) {
+    EinsumOperand<T> result{data, labels, std::vector<size_t>(labels.size()), std::vector<ptrdiff_t>(labels.size())};
+    ptrdiff_t stride = 1;
+    for (size_t i = labels.size(); i-- > 0;) {
+        result.shape[i] = a.has(labels[i]) ? a.size(labels[i]) : b.size(labels[i]);
+        result.stride[i] = stride;
+        stride *= static_cast<ptrdiff_t>(result.shape[i]);
+    }
+    return result;
+}
+
+struct EinsumSpec {
+    std::vector<std::string> inputs;
+    std::string output;
+};
+
+/* Parses subscripts like "ij,jk->ik". Without "->" the output has the labels, which appear once, in alphabetical
+ * order (as in numpy). Ellipsis is not supported. */
+inline EinsumSpec parse_einsum(const std::string& subscripts) {
+    EinsumSpec spec;
+    const size_t arrow = subscripts.find("->");
+    spec.inputs.emplace_back();
+    for (char c : subscripts.substr(0, arrow)) {
+        if (c == ',') {
+            spec.inputs.emplace_back();
+        } else if (std::isalpha(static_cast<unsigned char>(c))) {
+            spec.inputs.back() += c;
+        } else {
+            TV_ASSERT(std::isspace(static_cast<unsigned char>(c)), "Unsupported character in einsum subscripts")
+        }
+    }
+
+    if (arrow == std::string::npos) {
+        std::string labels;
+        for (auto& input : spec.inputs) {
+            labels += input;
+        }
+        std::sort(labels.begin(), labels.end());
+        for (size_t i = 0; i < labels.size(); ++i) {
+            if ((i == 0 || labels[i - 1] != labels[i]) && (i + 1 == labels.size() || labels[i + 1] != labels[i])) {
+                spec.output += labels[i];
+            }
+        }
+        return spec;
+    }
+    for (char c : subscripts.substr(arrow + 2)) {
+        if (std::isalpha(static_cast<unsigned char>(c))) {
+            TV_ASSERT(spec.output.find(c) == std::string::npos, "Repeated label in einsum output")
+            spec.output += c;
+        } else {
+            TV_ASSERT(std::isspace(static_cast<unsigned char>(c)), "Unsupported character in einsum subscripts")
+        }
+    }
+    return spec;
+}
+
+/* dst = src for operands with the same labels */
+template<class T>
+void copy_operand(const EinsumOperand<const T>& src, const EinsumOperand<T>& dst, const ExecutionPolicy& policy) {
+    StridedLayout<einsum_max_dims, 2> layout;
+    for (size_t i = 0; i < dst.labels.size(); ++i) {
+        ptrdiff_t strides[] = {dst.stride[i], src.stride_of(dst.labels[i])};
+        layout.append(dst.shape[i], strides);
+    }
+    layout.coalesce();
+    copy_layout(src.data, dst.data, layout, policy);
+}
+
+/* out = sum of a * b over the labels missing in out, by strided loops over all labels */
+template<class T>
+void contract_strided(const EinsumOperand<const T>& a, const EinsumOperand<const T>& b, const EinsumOperand<T>& out,
+                      const ExecutionPolicy& policy) {
+    const size_t M = 2 * einsum_max_dims;
+    /* operand 0 - out, 1 - a, 2 - b */
+    StridedLayout<M, 3> outer;
+    StridedLayout<M, 3> inner;
+    for (size_t i = 0; i < out.labels.size(); ++i) {
+        ptrdiff_t strides[] = {out.stride[i], a.stride_of(out.labels[i]), b.stride_of(out.labels[i])};
+        outer.append(out.shape[i], strides);
+    }
+    std::string summed;
+    for (char label : a.labels + b.labels) {
+        if (!out.has(label) && summed.find(label) == std::string::npos) {
+            summed += label;
+            ptrdiff_t strides[] = {0, a.stride_of(label), b.stride_of(label)};
+            inner.append(a.has(label) ? a.size(label) : b.size(label), strides);
+        }
+    }
+    outer.coalesce();
+    inner.coalesce();
+
+    const size_t count = outer.num_elements();
+    const size_t length = inner.num_elements();
+    if (count == 0) {
+        return;
+    }
+    parallel_for(policy, count, std::max<size_t>(length, 1), [&](size_t begin, size_t end) {
+        StridedCursor<M, 3> cursor(outer, outer.ndim, begin);
+        for (size_t i = begin; i < end; ++i) {
+            T sum = 0;
+            if (length > 0) {
+                StridedCursor<M, 3> position(inner, inner.ndim);
+                for (size_t j = 0; j < length; ++j) {
+                    sum += a.data[cursor.offset(1) + position.offset(1)] * b.data[cursor.offset(2) + position.offset(2)];
+                    position.next();
+                }
+            }
+            out.data[cursor.offset(0)] = sum;
+            cursor.next();
+        }
+    });
+}
+
+/* Size and stride of dims with the given labels traversed as a single dim (in the order of labels).
+ * Returns false if there is no such stride. */
+template<class T>
+bool merge_dims(const EinsumOperand<T>& operand, const std::string& labels, size_t& size, ptrdiff_t& stride) {
+    size = 1;
+    stride = 0;
+    for (char label : labels) {
+        const size_t dim_size = operand.size(label);
+        const ptrdiff_t dim_stride = operand.stride_of(label);
+        if (dim_size == 1) {
+            continue;
+        }
+        if (size > 1 && stride != static_cast<ptrdiff_t>(dim_size) * dim_stride) {
+            return false;
+        }
+        size *= dim_size;
+        stride = dim_stride;
+    }
+    return true;
+}
+
+/* Batch of matrices for an operand with labels grouped into batch, rows and cols */
+template<class T>
+bool merge_matrix_batch(const EinsumOperand<T>& operand, const std::string& batch, const std::string& rows,
+                        const std::string& cols, MatrixBatch<T>& result) {
+    result.data = operand.data;
+    return merge_dims(operand, batch, result.batch, result.batch_stride) &&
+           merge_dims(operand, rows, result.rows, result.row_stride) &&
+           merge_dims(operand, cols, result.cols, result.col_stride);
+}
+
+/* out = sum of a * b over the labels missing in out. Labels are grouped into batch (in a, b and out),
+ * rows (a and out), cols (b and out) and depth (a and b), so that the contraction is a batched matrix product.
+ * Operands, which can not be traversed as batches of matrices, are copied with dims in this order.
+ * Labels summed over a single operand go through strided loops. */
+template<class T>
+void contract_pair(const EinsumOperand<const T>& a, const EinsumOperand<const T>& b, const EinsumOperand<T>& out,
+                   const ExecutionPolicy& policy) {
+    std::string batch, rows, cols, depth;
+    for (char label : out.labels) {
+        if (a.has(label) && b.has(label)) {
+            batch += label;
+        } else {
+            (a.has(label) ? rows : cols) += label;
+        }
+    }
+    for (char label : a.labels + b.labels) {
+        if (!out.has(label) && !(a.has(label) && b.has(label))) {
+            contract_strided(a, b, out, policy);
+            return;
+        }
+        if (!out.has(label) && depth.find(label) == std::string::npos) {
+            depth += label;
+        }
+    }
+
+    WorkspaceScope scope;
+    std::vector<T, WorkspaceAllocator<T>> a_copy, b_copy, out_copy;
+    MatrixBatch<const T> lhs, rhs;
+    MatrixBatch<T> result;
+    if (!merge_matrix_batch(a, batch, rows, depth, lhs)) {
+        a_copy.resize(a.num_elements());
+        auto copy = contiguous_operand(a_copy.data(), batch + rows + depth, a, a);
+        copy_operand(a, copy, policy);
+        merge_matrix_batch(as_const(copy), batch, rows, depth, lhs);
+    }
+    if (!merge_matrix_batch(b, batch, depth, cols, rhs)) {
+        b_copy.resize(b.num_elements());
+        auto copy = contiguous_operand(b_copy.data(), batch + depth + cols, b, b);
+        copy_operand(b, copy, policy);
+        merge_matrix_batch(as_const(copy), batch, depth, cols, rhs);
+    }
+    if (merge_matrix_batch(out, batch, rows, cols, result)) {
+        matmul_impl(lhs, rhs, result, policy);
+        return;
+    }
+    out_copy.resize(out.num_elements());
+    auto product = contiguous_operand(out_copy.data(), batch + rows + cols, a, b);
+    merge_matrix_batch(product, batch, rows, cols, result);
+    matmul_impl(lhs, rhs, result, policy);
+    copy_operand(as_const(product), out, policy);
+}
+
+/* Labels of the product of operands i and j needed by the output or by other operands, grouped as
+ * batch, rows and cols of contract_pair(), so that the product is written without a copy */
+template<class T, class U>
+std::string kept_labels(const std::vector<EinsumOperand<const T>>& operands, size_t i, size_t j,
+                        const EinsumOperand<U>& out) {
+    auto needed = [&](char label) {
+        if (out.has(label)) {
+            return true;
+        }
+        for (size_t k = 0; k < operands.size(); ++k) {
+            if (k != i && k != j && operands[k].has(label)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    std::string batch, rows, cols;
+    for (char label : operands[i].labels) {
+        if (needed(label)) {
+            (operands[j].has(label) ? batch : rows) += label;
+        }
+    }
+    for (char label : operands[j].labels) {
+        if (needed(label) && !operands[i].has(label)) {
+            cols += label;
+        }
+    }
+    return batch + rows + cols;
+}
+
+/* Contracts operands pairwise. The next pair is chosen greedily: the one with the smallest product, then the one
+ * with the smallest number of multiplications. Intermediate products are allocated from the workspace. */
+template<class T>
+void einsum_impl(std::vector<EinsumOperand<const T>> operands, const EinsumOperand<T>& out,
+                 const ExecutionPolicy& policy) {
+    for (size_t i = 0; i < operands.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            for (char label : operands[i].labels) {
+                TV_ASSERT(!operands[j].has(label) || operands[j].size(label) == operands[i].size(label),
+                          "Dims with the same einsum label have different sizes")
+            }
+        }
+    }
+    for (char label : out.labels) {
+        auto it = std::find_if(operands.begin(), operands.end(), [&](const EinsumOperand<const T>& operand) {
+            return operand.has(label);
+        });
+        TV_ASSERT(it != operands.end(), "Einsum output label is missing in operands")
+        TV_ASSERT(it->size(label) == out.size(label), "Incorrect shape of einsum output")
+    }
+
+    if (operands.size() == 1) {
+        const T one = 1;
+        contract_strided(operands[0], EinsumOperand<const T>{&one, {}, {}, {}}, out, policy);
+        return;
+    }
+
+    WorkspaceScope scope;
+    std::vector<std::vector<T, WorkspaceAllocator<T>>> products;
+    products.reserve(operands.size());
+    while (operands.size() > 2) {
+        size_t best_i = 0;
+        size_t best_j = 1;
+        size_t best_size = std::numeric_limits<size_t>::max();
+        size_t best_cost = std::numeric_limits<size_t>::max();
+        for (size_t i = 0; i < operands.size(); ++i) {
+            for (size_t j = i + 1; j < operands.size(); ++j) {
+                size_t size = 1;
+                for (char label : kept_labels(operands, i, j, out)) {
+                    size *= operands[i].has(label) ? operands[i].size(label) : operands[j].size(label);
+                }
+                size_t cost = operands[i].num_elements();
+                for (char label : operands[j].labels) {
+                    cost *= operands[i].has(label) ? 1 : operands[j].size(label);
+                }
+                if (size < best_size || (size == best_size && cost < best_cost)) {
+                    best_i = i;
+                    best_j = j;
+                    best_size = size;
+                    best_cost = cost;
+                }
+            }
+        }
+
+        products.emplace_back(best_size);
+        auto product = contiguous_operand(products.back().data(), kept_labels(operands, best_i, best_j, out),
+                                          operands[best_i], operands[best_j]);
+        contract_pair(operands[best_i], operands[best_j], product, policy);
+        operands.erase(operands.begin() + best_j);
+        operands.erase(operands.begin() + best_i);
+        operands.push_back(as_const(product));
+    }
+    contract_pair(operands[0], operands[1], out, policy);
+}
+
+template<class TTensorView, class ...TTensorViews>
+struct einsum_value {
+    using type = std::remove_const_t<typename TTensorView::ValueType>;
+    static_assert(all_same<type, std::remove_const_t<typename TTensorViews::ValueType>...>::value,
+                  "Einsum operands must have the same type");
+    static_assert(std::is_arithmetic<type>::value, "Einsum needs tensors of arithmetic type");
+};
+
+template<class T, class ...TTensorViews>
+std::vector<EinsumOperand<const T>> einsum_operands(const EinsumSpec& spec, const TTensorViews& ... views) {
+    TV_ASSERT(spec.inputs.size() == sizeof...(TTensorViews), "Number of einsum operands differs from subscripts")
+    std::vector<EinsumOperand<const T>> operands;
+    size_t k = 0;
+    int expand[] = {(operands.push_back(einsum_operand(views, spec.inputs[k++])), 0)...};
+    (void) expand;
+    return operands;
+}
+
+} // detail
+
+/* Sum of products of operands over the labels missing in the output, as numpy.einsum:
+ *
+ *     einsum(dst, "ij,jk->ik", a, b);          // matrix product
+ *     einsum(scores, "bhqd,bhkd->bhqk", q, k);  // attention scores
+ *     einsum(dst, "ii->i", a);                 // diagonal
+ *
+ * Pairs of operands are contracted with batched matrix products, operands are permuted through strides and copied
+ * only if their dims can not be grouped into a batch of matrices. For three or more operands the contraction order
+ * is chosen greedily by the size of intermediate products. A label repeated in an operand takes its diagonal. */
+template<class TTensorViewDst, class ...TTensorViews,
+         std::enable_if_t<is_tensor_view_v<TTensorViewDst> && detail::all_tensor_views<TTensorViews...>::value, int> = 0>
+void einsum(TTensorViewDst& dst, const std::string& subscripts, const TTensorViews& ... operands) {
+    static_assert(sizeof...(TTensorViews) > 0, "Einsum needs at least one operand");
+    using T = typename detail::einsum_value<TTensorViewDst, TTensorViews...>::type;
+    const detail::EinsumSpec spec = detail::parse_einsum(subscripts);
+    detail::einsum_impl(detail::einsum_operands<T>(spec, operands...), detail::einsum_operand(dst, spec.output),
+                        get_execution_policy());
+}
+
+/* Einsum into a new tensor with N dims, e.g. einsum<2>("ij,jk->ik", a, b) */
+template<size_t N, class ...TTensorViews>
+Tensor<typename detail::einsum_value<TTensorViews...>::type, N>
+einsum(const std::string& subscripts, const TTensorViews& ... operands) {
+    using T = typename detail::einsum_value<TTensorViews...>::type;
+    const detail::EinsumSpec spec = detail::parse_einsum(subscripts);
+    auto inputs = detail::einsum_operands<T>(spec, operands...);
+    TV_ASSERT(spec.output.size() == N, "Number of einsum output labels differs from number of dims")
+    size_t shape[N > 0 ? N : 1];
+    for (size_t i = 0; i < N; ++i) {
+        auto it = std::find_if(inputs.begin(), inputs.end(), [&](const detail::EinsumOperand<const T>& operand) {
+            return operand.has(spec.output[i]);
+        });
+        TV_ASSERT(it != inputs.end(), "Einsum output label is missing in operands")
+        shape[i] = it->size(spec.output[i]);
+    }
+    Tensor<T, N> result(uninitialized, shape);
+    detail::einsum_impl(std::move(inputs), detail::einsum_operand(result, spec.output), get_execution_policy());
+    return result;
+}
+
+/* Contraction of a and b over pairs of axes, as numpy.tensordot: dims of the result are the remaining dims of a
+ * followed by the remaining dims of b */
+template<class TTensorViewA, class TTensorViewB, size_t K>
+Tensor<typename detail::einsum_value<TTensorViewA, TTensorViewB>::type,
+       TTensorViewA::NumDims + TTensorViewB::NumDims - 2 * K>
+tensordot(const TTensorViewA& a, const TTensorViewB& b, const size_t (&axes_a)[K], const size_t (&axes_b)[K]) {
+    static_assert(K <= TTensorViewA::NumDims && K <= TTensorViewB::NumDims, "Too many axes of tensordot");
+    const char* letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    std::string labels_a(letters, letters + TTensorViewA::NumDims);
+    std::string labels_b(letters + TTensorViewA::NumDims, letters + TTensorViewA::NumDims + TTensorViewB::NumDims);
+    for (size_t i = 0; i < K; ++i) {
+        TV_ASSERT(axes_a[i] < TTensorViewA::NumDims && axes_b[i] < TTensorViewB::NumDims, "Axis is out of range")
+        labels_b[axes_b[i]] = labels_a[axes_a[i]];
+    }
+    std::string output;
+    for (size_t i = 0; i < TTensorViewA::NumDims; ++i) {
+        if (std::find(axes_a, axes_a + K, i) == axes_a + K) {
+            output += labels_a[i];
+        }
+    }
+    for (size_t i = 0; i < TTensorViewB::NumDims; ++i) {
+        if (std::find(axes_b, axes_b + K, i) == axes_b + K) {
+            output += labels_b[i];
+        }
+    }
+    return einsum<TTensorViewA::NumDims + TTensorViewB::NumDims - 2 * K>(labels_a + "," + labels_b + "->" + output,
+                                                                          a, b);
+}
+
+} // namespace tensor_view
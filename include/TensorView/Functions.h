@@ -1,21 +1,236 @@
 #pragma once
 
+#include <cmath>
+#include <limits>
+
 #include "Tensor.h"
 #include "TensorView.h"
+#include "Workspace.h"
 
 namespace tensor_view {
 
+namespace detail {
+
+/* Softmax of a contiguous row. The maximum and the sum of exponents are computed in a single streaming pass:
+ * every chunk updates the running maximum and rescales the partial sum accordingly. */
+template<class T>
+void softmax_row(const T* src, T* dst, size_t n, bool log) {
+    const size_t chunk_length = 1024;
+
+    T max_value = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                       : std::numeric_limits<T>::lowest();
+    T sum = 0;
+    for (size_t offset = 0; offset < n; offset += chunk_length) {
+        size_t count = std::min(chunk_length, n - offset);
+        T chunk_max = accumulate(maximum<T>(), src + offset, count, max_value);
+        if (chunk_max != max_value) {
+            sum *= std::exp(max_value - chunk_max);
+            max_value = chunk_max;
+        }
+        sum += exp_sum(src + offset, max_value, count);
+    }
+
+    if (log) {
+        transform(bind_rhs(std::minus<T>(), max_value + std::log(sum)), src, dst, n);
+    } else {
+        exp_scale(src, max_value, T(1) / sum, dst, n);
+    }
+}
+
+/* Softmax over a strided axis for a block of contiguous inner elements: src[r * stride + i], r < length, i < count.
+ * The block is sized to stay in cache, so that the maximum and the sum passes do not reach memory. */
+template<class T>
+void softmax_block(const T* src, T* dst, size_t count, size_t length, ptrdiff_t src_stride, ptrdiff_t dst_stride,
+                   bool log, T* max_values, T* sums) {
+    std::copy(src, src + count, max_values);
+    for (size_t r = 1; r < length; ++r) {
+        transform(maximum<T>(), max_values, src + static_cast<ptrdiff_t>(r) * src_stride, max_values, count);
+    }
+    std::fill(sums, sums + count, T(0));
+    for (size_t r = 0; r < length; ++r) {
+        exp_accumulate(src + static_cast<ptrdiff_t>(r) * src_stride, max_values, sums, count);
+    }
+
+    if (log) {
+        for (size_t i = 0; i < count; ++i) {
+            sums[i] = max_values[i] + std::log(sums[i]);
+        }
+        for (size_t r = 0; r < length; ++r) {
+            transform(std::minus<T>(), src + static_cast<ptrdiff_t>(r) * src_stride, sums,
+                      dst + static_cast<ptrdiff_t>(r) * dst_stride, count);
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            sums[i] = T(1) / sums[i];
+        }
+        for (size_t r = 0; r < length; ++r) {
+            exp_scale(src + static_cast<ptrdiff_t>(r) * src_stride, max_values, sums,
+                      dst + static_cast<ptrdiff_t>(r) * dst_stride, count);
+        }
+    }
+}
+
+/* Softmax of an arbitrary strided row, computed in the accumulator type of the destination */
+template<class TSrc, class TDst>
+void softmax_strided(const TSrc* src, TDst* dst, size_t n, ptrdiff_t src_stride, ptrdiff_t dst_stride, bool log) {
+    using Acc = accumulator_t<TDst>;
+    Acc max_value = static_cast<Acc>(src[0]);
+    for (size_t i = 1; i < n; ++i) {
+        max_value = std::max<Acc>(max_value, src[static_cast<ptrdiff_t>(i) * src_stride]);
+    }
+    Acc sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += std::exp(static_cast<Acc>(src[static_cast<ptrdiff_t>(i) * src_stride]) - max_value);
+    }
+    Acc shift = max_value + std::log(sum);
+    for (size_t i = 0; i < n; ++i) {
+        Acc x = src[static_cast<ptrdiff_t>(i) * src_stride];
+        dst[static_cast<ptrdiff_t>(i) * dst_stride] = static_cast<TDst>(log ? x - shift : std::exp(x - shift));
+    }
+}
+
+/* Vectorized softmax over contiguous rows or over blocks of contiguous inner elements.
+ * Returns false if the layout is not supported. */
+template<size_t N, class T>
+bool softmax_vectorized(const StridedLayout<N, 2>& layout, const T* src, T* dst, size_t length,
+                        ptrdiff_t src_stride, ptrdiff_t dst_stride, bool log, const ExecutionPolicy& policy) {
+    const size_t block_length = 1024;
+    const size_t min_block_length = 64;
+    const size_t cache_elements = (size_t(128) << 10) / sizeof(T);
+    const size_t ndim = layout.ndim;
+
+    if (src_stride == 1 && dst_stride == 1) {
+        parallel_for(policy, layout.num_elements(), length, [&](size_t begin, size_t end) {
+            StridedCursor<N, 2> cursor(layout, ndim, begin);
+            for (size_t i = begin; i < end; ++i) {
+                softmax_row(src + cursor.offset(1), dst + cursor.offset(0), length, log);
+                cursor.next();
+            }
+        });
+        return true;
+    }
+
+    if (ndim == 0 || layout.stride[0][ndim - 1] != 1 || layout.stride[1][ndim - 1] != 1) {
+        return false;
+    }
+    const size_t row_length = layout.shape[ndim - 1];
+    const size_t block = std::max(min_block_length, std::min(block_length, cache_elements / length));
+    const size_t num_blocks = (row_length + block - 1) / block;
+    const size_t num_rows = layout.num_elements(ndim - 1);
+
+    parallel_for(policy, num_rows * num_blocks, std::min(row_length, block) * length,
+                 [&](size_t begin, size_t end) {
+        T max_values[block_length];
+        T sums[block_length];
+        StridedCursor<N, 2> cursor(layout, ndim - 1, begin / num_blocks);
+        size_t block_index = begin % num_blocks;
+        for (size_t item = begin; item < end; ++item) {
+            size_t offset = block_index * block;
+            softmax_block(src + cursor.offset(1) + offset, dst + cursor.offset(0) + offset,
+                          std::min(block, row_length - offset), length, src_stride, dst_stride, log,
+                          max_values, sums);
+            if (++block_index == num_blocks) {
+                block_index = 0;
+                cursor.next();
+            }
+        }
+    });
+    return true;
+}
+
+template<size_t N, class TSrc, class TDst>
+bool softmax_vectorized(const StridedLayout<N, 2>& layout, const TSrc* src, TDst* dst, size_t length,
+                        ptrdiff_t src_stride, ptrdiff_t dst_stride, bool log, const ExecutionPolicy& policy) {
+    return false;
+}
+
+/* Contiguous rows of half-precision values are converted to float in a workspace buffer, which is normalized by
+ * the float kernels and converted back */
+template<size_t N, class T>
+bool softmax_half(const StridedLayout<N, 2>& layout, const T* src, T* dst, size_t length,
+                  ptrdiff_t src_stride, ptrdiff_t dst_stride, bool log, const ExecutionPolicy& policy) {
+    if (src_stride != 1 || dst_stride != 1) {
+        return false;
+    }
+    parallel_for(policy, layout.num_elements(), length, [&](size_t begin, size_t end) {
+        WorkspaceScope scope;
+        float* row = WorkspaceAllocator<float>().allocate(length);
+        StridedCursor<N, 2> cursor(layout, layout.ndim, begin);
+        for (size_t i = begin; i < end; ++i) {
+            convert(src + cursor.offset(1), row, length);
+            softmax_row(row, row, length, log);
+            convert(row, dst + cursor.offset(0), length);
+            cursor.next();
+        }
+    });
+    return true;
+}
+
+template<size_t N>
+bool softmax_vectorized(const StridedLayout<N, 2>& layout, const float16* src, float16* dst, size_t length,
+                        ptrdiff_t src_stride, ptrdiff_t dst_stride, bool log, const ExecutionPolicy& policy) {
+    return softmax_half(layout, src, dst, length, src_stride, dst_stride, log, policy);
+}
+
+template<size_t N>
+bool softmax_vectorized(const StridedLayout<N, 2>& layout, const bfloat16* src, bfloat16* dst, size_t length,
+                        ptrdiff_t src_stride, ptrdiff_t dst_stride, bool log, const ExecutionPolicy& policy) {
+    return softmax_half(layout, src, dst, length, src_stride, dst_stride, log, policy);
+}
+
+template<class TTensorViewSrc, class TTensorViewDst>
+void softmax_impl(const TTensorViewSrc& src, TTensorViewDst& dst, size_t axis, bool log,
+                  const ExecutionPolicy& policy) {
+    const size_t NumDims = TTensorViewSrc::NumDims;
+    const size_t N = TTensorViewSrc::NumDims - 1;
+    static_assert(NumDims == TTensorViewDst::NumDims, "Incorrect number of dims of destination tensor");
+    TV_TRACE_SCOPE(log ? "log_softmax" : "softmax", dst,
+                   sizeof(typename TTensorViewSrc::ValueType) + sizeof(typename TTensorViewDst::ValueType))
+    /* operand 0 - destination, operand 1 - source */
+    StridedLayout<N, 2> layout;
+
+    TV_ASSERT(axis < NumDims, "Softmax axis is out of range")
+    for (size_t i = 0; i < NumDims; ++i) {
+        TV_ASSERT(dst.size(i) == src.size(i), "Incorrect shape of destination tensor")
+        if (i == axis) {
+            continue;
+        }
+        ptrdiff_t strides[] = {static_cast<ptrdiff_t>(dst.stride()[i]), static_cast<ptrdiff_t>(src.stride()[i])};
+        layout.append(src.size(i), strides);
+    }
+    layout.coalesce();
+    TV_TRACE_VIEWS(dst, src)
+
+    const size_t length = src.size(axis);
+    const ptrdiff_t src_stride = src.stride()[axis];
+    const ptrdiff_t dst_stride = dst.stride()[axis];
+    if (length == 0 || layout.num_elements() == 0 ||
+        softmax_vectorized(layout, src.data(), dst.data(), length, src_stride, dst_stride, log, policy)) {
+        return;
+    }
+
+    parallel_for(policy, layout.num_elements(), length, [&](size_t begin, size_t end) {
+        StridedCursor<N, 2> cursor(layout, layout.ndim, begin);
+        for (size_t i = begin; i < end; ++i) {
+            softmax_strided(src.data() + cursor.offset(1), dst.data() + cursor.offset(0), length,
+                            src_stride, dst_stride, log);
+            cursor.next();
+        }
+    });
+}
+
+} // detail
+
+/* dst = exp(src) / sum(exp(src)) along the axis. Does not allocate memory, dst may be the same view as src. */
+template<class T1, class T2>
+void softmax(const T1& src, T2& dst, size_t axis, const ExecutionPolicy& policy = get_execution_policy()) {
+    detail::softmax_impl(src, dst, axis, false, policy);
+}
+
+/* dst = src - log(sum(exp(src))) along the axis */
 template<class T1, class T2>
-void softmax(const T1& src, T2& dst, size_t axis) {
-    std::vector<size_t> size(src.shape(), src.shape() + T1::NumDims);
-    size.erase(size.begin() + axis);
-    Tensor<std::decay_t<typename T1::ValueType>, T1::NumDims - 1> tmp(size.data());
-    src.max(tmp, axis);
-    dst.assign_(src);
-    dst -= tmp.unsqueeze(axis);
-    dst.map_([](auto x) { return std::exp(x); });
-    dst.sum(tmp, axis);
-    dst /= tmp.unsqueeze(axis);
-}
-
-} // namespace tensor_view
\ No newline at end of file
+void log_softmax(const T1& src, T2& dst, size_t axis, const ExecutionPolicy& policy = get_execution_policy()) {
+    detail::softmax_impl(src, dst, axis, true, policy);
+}
+
+} // namespace tensor_view
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+/* Half-precision storage types.
+ *
+ * float16 (IEEE 754 binary16) and bfloat16 (the upper half of a float) only store values. They convert implicitly
+ * to float and back, so arithmetic on them is done in float and rounded when the result is stored. Reductions and
+ * softmax accumulate half-precision values in float (see accumulator_t), contiguous conversions to and from float
+ * are vectorized (see simd::ConvertKernel). */
+
+namespace tensor_view {
+
+namespace detail {
+
+inline float bits_to_float(uint32_t bits) {
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+inline uint32_t float_to_bits(float value) {
+    uint32_t result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+/* float -> binary16 with rounding to nearest even, NaN becomes quiet NaN */
+inline uint16_t float_to_half_bits(float value) {
+    const uint32_t bits = float_to_bits(value);
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t abs = bits & 0x7fffffffu;
+
+    if (abs >= 0x7f800000u) {
+        return static_cast<uint16_t>(sign | (abs > 0x7f800000u ? 0x7e00u : 0x7c00u));
+    }
+    /* values not less than 65520 round to infinity */
+    if (abs >= 0x477ff000u) {
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+    /* subnormal results: adding 0.5 aligns the last bit of the half-precision mantissa (2^-24)
+     * with the last bit of float mantissa, so that the sum is rounded by the FPU */
+    if (abs < 0x38800000u) {
+        const uint32_t half = 0x3f000000u;
+        return static_cast<uint16_t>(sign | (float_to_bits(bits_to_float(abs) + bits_to_float(half)) - half));
+    }
+    const uint32_t mantissa_odd = (abs >> 13) & 1u;
+    /* rebias the exponent from 127 to 15 and round, carry into the exponent is correct */
+    abs += ((15u - 127u) << 23) + 0xfffu + mantissa_odd;
+    return static_cast<uint16_t>(sign | (abs >> 13));
+}
+
+/* binary16 -> float, exact */
+inline float half_bits_to_float(uint16_t value) {
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    uint32_t bits = static_cast<uint32_t>(value & 0x7fffu) << 13;
+    const uint32_t exponent = bits & (0x7c00u << 13);
+
+    bits += (127u - 15u) << 23;
+    if (exponent == (0x7c00u << 13)) {
+        /* infinity or NaN */
+        bits += (128u - 16u) << 23;
+    } else if (exponent == 0) {
+        /* zero or subnormal, renormalized by the FPU */
+        const uint32_t magic = 113u << 23;
+        bits = float_to_bits(bits_to_float(bits + (1u << 23)) - bits_to_float(magic));
+    }
+    return bits_to_float(sign | bits);
+}
+
+/* float -> bfloat16 with rounding to nearest even, NaN becomes quiet NaN */
+inline uint16_t float_to_bfloat16_bits(float value) {
+    const uint32_t bits = float_to_bits(value);
+    if ((bits & 0x7fffffffu) > 0x7f800000u) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40u);
+    }
+    return static_cast<uint16_t>((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+}
+
+inline float bfloat16_bits_to_float(uint16_t value) {
+    return bits_to_float(static_cast<uint32_t>(value) << 16);
+}
+
+} // detail
+
+
+/* IEEE 754 half-precision value */
+struct float16 {
+    uint16_t bits;
+
+    float16() = default;
+
+    float16(float value) : bits(detail::float_to_half_bits(value)) {}
+
+    operator float() const {
+        return detail::half_bits_to_float(bits);
+    }
+
+    static constexpr float16 from_bits(uint16_t bits) {
+        return float16(bits, 0);
+    }
+
+private:
+    constexpr float16(uint16_t bits, int) : bits(bits) {}
+};
+
+/* Brain floating point value: 8 exponent bits as in float, 7 mantissa bits */
+struct bfloat16 {
+    uint16_t bits;
+
+    bfloat16() = default;
+
+    bfloat16(float value) : bits(detail::float_to_bfloat16_bits(value)) {}
+
+    operator float() const {
+        return detail::bfloat16_bits_to_float(bits);
+    }
+
+    static constexpr bfloat16 from_bits(uint16_t bits) {
+        return bfloat16(bits, 0);
+    }
+
+private:
+    constexpr bfloat16(uint16_t bits, int) : bits(bits) {}
+};
+
+inline std::ostream& operator<<(std::ostream& stream, float16 value) {
+    return stream << static_cast<float>(value);
+}
+
+inline std::ostream& operator<<(std::ostream& stream, bfloat16 value) {
+    return stream << static_cast<float>(value);
+}
+
+
+template<class T>
+struct is_half : std::integral_constant<bool, std::is_same<std::remove_cv_t<T>, float16>::value ||
+                                              std::is_same<std::remove_cv_t<T>, bfloat16>::value> {
+};
+
+/* Type in which reductions and softmax accumulate values of T */
+template<class T>
+struct accumulator_type {
+    using type = T;
+};
+
+template<>
+struct accumulator_type<float16> {
+    using type = float;
+};
+
+template<>
+struct accumulator_type<bfloat16> {
+    using type = float;
+};
+
+template<class T>
+using accumulator_t = typename accumulator_type<std::remove_const_t<T>>::type;
+
+} // namespace tensor_view
+
+
+namespace std {
+
+template<>
+struct numeric_limits<tensor_view::float16> {
+    using T = tensor_view::float16;
+
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = false;
+    static constexpr bool has_infinity = true;
+    static constexpr bool has_quiet_NaN = true;
+    static constexpr bool has_signaling_NaN = true;
+    static constexpr bool is_iec559 = true;
+    static constexpr bool is_bounded = true;
+    static constexpr int digits = 11;
+    static constexpr int digits10 = 3;
+    static constexpr int max_digits10 = 5;
+    static constexpr int radix = 2;
+    static constexpr int min_exponent = -13;
+    static constexpr int max_exponent = 16;
+
+    static constexpr T min() noexcept { return T::from_bits(0x0400); }
+    static constexpr T lowest() noexcept { return T::from_bits(0xfbff); }
+    static constexpr T max() noexcept { return T::from_bits(0x7bff); }
+    static constexpr T epsilon() noexcept { return T::from_bits(0x1400); }
+    static constexpr T round_error() noexcept { return T::from_bits(0x3800); }
+    static constexpr T infinity() noexcept { return T::from_bits(0x7c00); }
+    static constexpr T quiet_NaN() noexcept { return T::from_bits(0x7e00); }
+    static constexpr T signaling_NaN() noexcept { return T::from_bits(0x7d00); }
+    static constexpr T denorm_min() noexcept { return T::from_bits(0x0001); }
+};
+
+template<>
+struct numeric_limits<tensor_view::bfloat16> {
+    using T = tensor_view::bfloat16;
+
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = false;
+    static constexpr bool has_infinity = true;
+    static constexpr bool has_quiet_NaN = true;
+    static constexpr bool has_signaling_NaN = true;
+    static constexpr bool is_iec559 = false;
+    static constexpr bool is_bounded = true;
+    static constexpr int digits = 8;
+    static constexpr int digits10 = 2;
+    static constexpr int max_digits10 = 4;
+    static constexpr int radix = 2;
+    static constexpr int min_exponent = -125;
+    static constexpr int max_exponent = 128;
+
+    static constexpr T min() noexcept { return T::from_bits(0x0080); }
+    static constexpr T lowest() noexcept { return T::from_bits(0xff7f); }
+    static constexpr T max() noexcept { return T::from_bits(0x7f7f); }
+    static constexpr T epsilon() noexcept { return T::from_bits(0x3c00); }
+    static constexpr T round_error() noexcept { return T::from_bits(0x3f00); }
+    static constexpr T infinity() noexcept { return T::from_bits(0x7f80); }
+    static constexpr T quiet_NaN() noexcept { return T::from_bits(0x7fc0); }
+    static constexpr T signaling_NaN() noexcept { return T::from_bits(0x7fa0); }
+    static constexpr T denorm_min() noexcept { return T::from_bits(0x0001); }
+};
+
+} // namespace std
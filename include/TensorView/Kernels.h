@@ -0,0 +1,1866 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+#include "Half.h"
+
+/* Vectorized kernels for contiguous inner loops.
+ *
+ * Kernels are written once with GCC/Clang vector extensions and compiled for several instruction sets
+ * (SSE2, AVX2, AVX-512) via target attributes. The best instruction set supported by the CPU is chosen at
+ * runtime. Only built-in operations (see op_code below) on float, double, int32 and uint8 are vectorized,
+ * all other functors go through the scalar std::transform / std::accumulate path. Exponent kernels used by
+ * softmax are vectorized for float and double. Conversions between float and half-precision types use F16C and
+ * AVX-512 (BF16) instructions, which are detected separately. Quantization of float to int8 / uint8 and products of
+ * 8-bit values are computed in float and int32 lanes.
+ *
+ * Define TENSORVIEW_NO_SIMD to disable vectorized kernels. */
+
+#if !defined(TENSORVIEW_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TV_SIMD_X86 1
+#else
+#define TV_SIMD_X86 0
+#endif
+
+#if TV_SIMD_X86
+#define TV_ALWAYS_INLINE inline __attribute__((always_inline))
+#define TV_TARGET_SSE2 __attribute__((target("sse2")))
+#define TV_TARGET_AVX2 __attribute__((target("avx2")))
+#define TV_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#define TV_TARGET_F16C __attribute__((target("avx2,f16c")))
+#if (defined(__clang__) && __clang_major__ >= 16) || (!defined(__clang__) && __GNUC__ >= 10)
+#define TV_SIMD_BF16 1
+#define TV_TARGET_AVX512_BF16 __attribute__((target("avx512f,avx512bw,avx512bf16")))
+#else
+#define TV_SIMD_BF16 0
+#endif
+#include <immintrin.h>
+#else
+#define TV_ALWAYS_INLINE inline
+#endif
+
+namespace tensor_view {
+
+template<class T>
+struct maximum {
+    T operator()(const T& a, const T& b) const {
+        return a < b ? b : a;
+    }
+};
+
+template<class T>
+struct minimum {
+    T operator()(const T& a, const T& b) const {
+        return b < a ? b : a;
+    }
+};
+
+namespace detail {
+
+/* Binary functor with the first argument bound to a scalar, i.e. f(value, x) */
+template<class TFunc, class T>
+struct BindLhs {
+    TFunc func_;
+    T value_;
+
+    T operator()(const T& x) const {
+        return func_(value_, x);
+    }
+};
+
+/* Binary functor with the second argument bound to a scalar, i.e. f(x, value) */
+template<class TFunc, class T>
+struct BindRhs {
+    TFunc func_;
+    T value_;
+
+    T operator()(const T& x) const {
+        return func_(x, value_);
+    }
+};
+
+template<class TFunc, class T>
+BindLhs<TFunc, T> bind_lhs(TFunc f, T value) {
+    return {f, value};
+}
+
+template<class TFunc, class T>
+BindRhs<TFunc, T> bind_rhs(TFunc f, T value) {
+    return {f, value};
+}
+
+} // detail
+
+namespace simd {
+
+enum class Isa : int {
+    scalar = 0,
+    sse2 = 1,
+    avx2 = 2,
+    avx512 = 3
+};
+
+inline Isa detect_isa() {
+#if TV_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return Isa::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Isa::sse2;
+    }
+#endif
+    return Isa::scalar;
+}
+
+namespace detail {
+inline std::atomic<int>& max_isa_storage() {
+    static std::atomic<int> max_isa{static_cast<int>(Isa::avx512)};
+    return max_isa;
+}
+}
+
+/* Limits instruction set used by kernels (e.g. to compare implementations) */
+inline void set_max_isa(Isa isa) {
+    detail::max_isa_storage().store(static_cast<int>(isa), std::memory_order_relaxed);
+}
+
+inline Isa max_isa() {
+    return static_cast<Isa>(detail::max_isa_storage().load(std::memory_order_relaxed));
+}
+
+/* Instruction set which is used by kernels */
+inline Isa active_isa() {
+    static const Isa detected = detect_isa();
+    return std::min(detected, max_isa());
+}
+
+/* F16C conversions of float16, used together with AVX2 */
+inline bool has_f16c() {
+#if TV_SIMD_X86
+    static const bool supported = __builtin_cpu_supports("f16c");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/* AVX-512 BF16 conversions of float to bfloat16, used together with AVX-512 */
+inline bool has_avx512bf16() {
+#if TV_SIMD_X86 && TV_SIMD_BF16
+    static const bool supported = __builtin_cpu_supports("avx512bf16");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+
+enum class OpCode {
+    none, add, sub, mul, div, min, max, lt, le, gt, ge, eq, ne
+};
+
+template<class T>
+struct is_simd_type {
+    static constexpr bool value = std::is_same<T, float>::value ||
+                                  std::is_same<T, double>::value ||
+                                  std::is_same<T, int32_t>::value ||
+                                  std::is_same<T, uint8_t>::value;
+};
+
+template<class F, class T>
+struct op_code : std::integral_constant<OpCode, OpCode::none> {
+};
+
+#define TV_DEFINE_OP_CODE(FUNCTOR, CODE) \
+template<class T> struct op_code<FUNCTOR<T>, T> : std::integral_constant<OpCode, OpCode::CODE> {};
+
+TV_DEFINE_OP_CODE(std::plus, add)
+TV_DEFINE_OP_CODE(std::minus, sub)
+TV_DEFINE_OP_CODE(std::multiplies, mul)
+TV_DEFINE_OP_CODE(std::divides, div)
+TV_DEFINE_OP_CODE(minimum, min)
+TV_DEFINE_OP_CODE(maximum, max)
+TV_DEFINE_OP_CODE(std::less, lt)
+TV_DEFINE_OP_CODE(std::less_equal, le)
+TV_DEFINE_OP_CODE(std::greater, gt)
+TV_DEFINE_OP_CODE(std::greater_equal, ge)
+TV_DEFINE_OP_CODE(std::equal_to, eq)
+TV_DEFINE_OP_CODE(std::not_equal_to, ne)
+
+#undef TV_DEFINE_OP_CODE
+
+/* Functor can be executed by binary kernel */
+template<class F, class T>
+struct is_simd_binary_op {
+    static constexpr bool value = is_simd_type<T>::value && op_code<F, T>::value != OpCode::none;
+};
+
+/* Functor can be executed by reduction kernel */
+template<class F, class T>
+struct is_simd_reduce_op {
+    static constexpr OpCode code = op_code<F, T>::value;
+    static constexpr bool value = is_simd_type<T>::value &&
+                                  (code == OpCode::add || code == OpCode::mul ||
+                                   code == OpCode::min || code == OpCode::max);
+};
+
+
+/* Element-wise semantics of operations, same for scalars and vector types */
+template<OpCode Op>
+struct Apply;
+
+template<>
+struct Apply<OpCode::add> {
+    template<class V>
+    static TV_ALWAYS_INLINE void impl(const V& a, const V& b, V& out) { out = a + b; }
+};
+
+template<>
+struct Apply<OpCode::sub> {
+    template<class V>
+    static TV_ALWAYS_INLINE void impl(const V& a, const V& b, V& out) { out = a - b; }
+};
+
+template<>
+struct Apply<OpCode::mul> {
+    template<class V>
+    static TV_ALWAYS_INLINE void impl(const V& a, const V& b, V& out) { out = a * b; }
+};
+
+template<>
+struct Apply<OpCode::div> {
+    template<class V>
+    static TV_ALWAYS_INLINE void impl(const V& a, const V& b, V& out) { out = a / b; }
+};
+
+template<>
+struct Apply<OpCode::min> {
+    template<class V>
+    static TV_ALWAYS_INLINE void impl(const V& a, const V& b, V& out) { out = b < a ? b : a; }
+};
+
+template<>
+struct Apply<OpCode::max> {
+    template<class V>
+    static TV_ALWAYS_INLINE void impl(const V& a, const V& b, V& out) { out = a < b ? b : a; }
+};
+
+/* Comparison results are stored as 0 / 1 of the value type */
+template<class V, class TMask>
+TV_ALWAYS_INLINE void mask_to_value(const TMask& mask, V& out) {
+    V one = V{} + 1;
+    out = (V) (mask & (TMask) one);
+}
+
+template<class V>
+TV_ALWAYS_INLINE void mask_to_value(bool mask, V& out) {
+    out = static_cast<V>(mask);
+}
+
+#define TV_DEFINE_COMPARISON(CODE, OPERATOR) \
+template<> \
+struct Apply<OpCode::CODE> { \
+    template<class V> \
+    static TV_ALWAYS_INLINE void impl(const V& a, const V& b, V& out) { mask_to_value(a OPERATOR b, out); } \
+};
+
+TV_DEFINE_COMPARISON(lt, <)
+TV_DEFINE_COMPARISON(le, <=)
+TV_DEFINE_COMPARISON(gt, >)
+TV_DEFINE_COMPARISON(ge, >=)
+TV_DEFINE_COMPARISON(eq, ==)
+TV_DEFINE_COMPARISON(ne, !=)
+
+#undef TV_DEFINE_COMPARISON
+
+
+template<class T, size_t Bytes>
+struct Vec {
+#if TV_SIMD_X86
+    typedef T Type __attribute__((vector_size(Bytes)));
+#else
+    typedef T Type;
+#endif
+    static constexpr size_t Width = Bytes / sizeof(T);
+};
+
+template<class V, class T>
+TV_ALWAYS_INLINE void load(const T* ptr, V& out) {
+    std::memcpy(&out, ptr, sizeof(V));
+}
+
+template<class V, class T>
+TV_ALWAYS_INLINE void store(T* ptr, const V& v) {
+    std::memcpy(ptr, &v, sizeof(V));
+}
+
+/* dst[i] = op(a[i], b[i]), ScalarA / ScalarB means that the operand is a single broadcasted value */
+template<size_t Bytes, OpCode Op, class T, bool ScalarA, bool ScalarB>
+TV_ALWAYS_INLINE void binary_loop(const T* a, const T* b, T* dst, size_t n) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+
+    size_t i = 0;
+    if (width > 1) {
+        V va, vb, vr;
+        if (ScalarA) va = V{} + *a;
+        if (ScalarB) vb = V{} + *b;
+        for (; i + width <= n; i += width) {
+            if (!ScalarA) load(a + i, va);
+            if (!ScalarB) load(b + i, vb);
+            Apply<Op>::impl(va, vb, vr);
+            store(dst + i, vr);
+        }
+    }
+    for (; i < n; ++i) {
+        Apply<Op>::impl(a[ScalarA ? 0 : i], b[ScalarB ? 0 : i], dst[i]);
+    }
+}
+
+/* Returns op(...op(op(a[0], a[1]), a[2])..., a[n - 1]) in a vectorized (hence reordered) manner, n > 0 */
+template<size_t Bytes, OpCode Op, class T>
+TV_ALWAYS_INLINE T reduce_loop(const T* a, size_t n) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+    const size_t unroll = 4;
+
+    T result = a[0];
+    size_t i = 1;
+    if (width > 1 && n >= width * unroll) {
+        /* several independent accumulators to hide latency of the operation */
+        V acc[unroll], v;
+        for (size_t k = 0; k < unroll; ++k) {
+            load(a + k * width, acc[k]);
+        }
+        for (i = width * unroll; i + width * unroll <= n; i += width * unroll) {
+            for (size_t k = 0; k < unroll; ++k) {
+                load(a + i + k * width, v);
+                Apply<Op>::impl(acc[k], v, acc[k]);
+            }
+        }
+        Apply<Op>::impl(acc[0], acc[1], acc[0]);
+        Apply<Op>::impl(acc[2], acc[3], acc[2]);
+        Apply<Op>::impl(acc[0], acc[2], acc[0]);
+
+        T lanes[width];
+        store(lanes, acc[0]);
+        result = lanes[0];
+        for (size_t k = 1; k < width; ++k) {
+            Apply<Op>::impl(result, lanes[k], result);
+        }
+    }
+    for (; i < n; ++i) {
+        Apply<Op>::impl(result, a[i], result);
+    }
+    return result;
+}
+
+template<OpCode Op, class T, bool ScalarA, bool ScalarB>
+struct BinaryKernel {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static void avx512(const T* a, const T* b, T* dst, size_t n) {
+        binary_loop<64, Op, T, ScalarA, ScalarB>(a, b, dst, n);
+    }
+
+    TV_TARGET_AVX2 static void avx2(const T* a, const T* b, T* dst, size_t n) {
+        binary_loop<32, Op, T, ScalarA, ScalarB>(a, b, dst, n);
+    }
+
+    TV_TARGET_SSE2 static void sse2(const T* a, const T* b, T* dst, size_t n) {
+        binary_loop<16, Op, T, ScalarA, ScalarB>(a, b, dst, n);
+    }
+#endif
+
+    static void scalar(const T* a, const T* b, T* dst, size_t n) {
+        binary_loop<sizeof(T), Op, T, ScalarA, ScalarB>(a, b, dst, n);
+    }
+
+    static void run(const T* a, const T* b, T* dst, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(a, b, dst, n);
+            case Isa::avx2:
+                return avx2(a, b, dst, n);
+            case Isa::sse2:
+                return sse2(a, b, dst, n);
+#endif
+            default:
+                return scalar(a, b, dst, n);
+        }
+    }
+};
+
+template<OpCode Op, class T>
+struct ReduceKernel {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static T avx512(const T* a, size_t n) {
+        return reduce_loop<64, Op, T>(a, n);
+    }
+
+    TV_TARGET_AVX2 static T avx2(const T* a, size_t n) {
+        return reduce_loop<32, Op, T>(a, n);
+    }
+
+    TV_TARGET_SSE2 static T sse2(const T* a, size_t n) {
+        return reduce_loop<16, Op, T>(a, n);
+    }
+#endif
+
+    static T scalar(const T* a, size_t n) {
+        return reduce_loop<sizeof(T), Op, T>(a, n);
+    }
+
+    static T run(const T* a, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(a, n);
+            case Isa::avx2:
+                return avx2(a, n);
+            case Isa::sse2:
+                return sse2(a, n);
+#endif
+            default:
+                return scalar(a, n);
+        }
+    }
+};
+
+/* exp(x) for scalars and vectors of float / double. The argument is reduced to x = n * ln2 + r, |r| <= ln2 / 2,
+ * exp(r) is approximated by Taylor polynomial and multiplied by 2^n built from exponent bits.
+ * Results below the smallest normal value are flushed to zero, results above max_x are infinite. */
+template<class T>
+struct ExpConstants;
+
+template<>
+struct ExpConstants<float> {
+    using Int = int32_t;
+    using UInt = uint32_t;
+    static constexpr int mantissa_bits = 23;
+    static constexpr Int exponent_bias = 127;
+    static constexpr float min_x = -87.33f;
+    static constexpr float max_x = 88.37f;
+    static constexpr float magic = 12582912.0f; // 1.5 * 2^23, adding it rounds to integer
+    static constexpr float log2e = 1.44269504088896341f;
+    static constexpr float ln2_hi = 0.693359375f;
+    static constexpr float ln2_lo = -2.12194440e-4f;
+    static constexpr size_t degree = 7;
+
+    static float coefficient(size_t i) {
+        static const float c[degree + 1] = {1.f / 5040, 1.f / 720, 1.f / 120, 1.f / 24, 1.f / 6, 1.f / 2, 1.f, 1.f};
+        return c[i];
+    }
+};
+
+template<>
+struct ExpConstants<double> {
+    using Int = int64_t;
+    using UInt = uint64_t;
+    static constexpr int mantissa_bits = 52;
+    static constexpr Int exponent_bias = 1023;
+    static constexpr double min_x = -708.39;
+    static constexpr double max_x = 709.0;
+    static constexpr double magic = 6755399441055744.0; // 1.5 * 2^52
+    static constexpr double log2e = 1.4426950408889634074;
+    static constexpr double ln2_hi = 6.93145751953125e-1;
+    static constexpr double ln2_lo = 1.42860682030941723212e-6;
+    static constexpr size_t degree = 13;
+
+    static double coefficient(size_t i) {
+        static const double c[degree + 1] = {
+                1. / 6227020800, 1. / 479001600, 1. / 39916800, 1. / 3628800, 1. / 362880, 1. / 40320, 1. / 5040,
+                1. / 720, 1. / 120, 1. / 24, 1. / 6, 1. / 2, 1., 1.};
+        return c[i];
+    }
+};
+
+template<class T>
+struct is_simd_exp_type {
+    static constexpr bool value = std::is_same<T, float>::value || std::is_same<T, double>::value;
+};
+
+template<class T, class V>
+TV_ALWAYS_INLINE void fast_exp(const V& x, V& out) {
+    using C = ExpConstants<T>;
+    using UInt = typename C::UInt;
+    using VU = std::conditional_t<std::is_same<V, T>::value, UInt, typename Vec<UInt, sizeof(V)>::Type>;
+
+    V t = x * C::log2e + C::magic;
+    V n = t - C::magic;
+    V r = x - n * C::ln2_hi - n * C::ln2_lo;
+    V p = V{} + C::coefficient(0);
+    for (size_t i = 1; i <= C::degree; ++i) {
+        p = p * r + C::coefficient(i);
+    }
+
+    /* n + bias is negative below min_x, the shift is done on unsigned lanes to keep it defined,
+     * such results are replaced by zero below */
+    T magic = C::magic;
+    UInt magic_bits;
+    std::memcpy(&magic_bits, &magic, sizeof(T));
+    VU bits;
+    std::memcpy(&bits, &t, sizeof(V));
+    bits = (bits - magic_bits + static_cast<UInt>(C::exponent_bias)) << C::mantissa_bits;
+    V scale;
+    std::memcpy(&scale, &bits, sizeof(V));
+
+    out = p * scale;
+    out = x < C::min_x ? V{} : out;
+    out = x > C::max_x ? V{} + std::numeric_limits<T>::infinity() : out;
+}
+
+/* Returns sum of exp(x[i] - m) */
+template<size_t Bytes, class T>
+TV_ALWAYS_INLINE T exp_sum_loop(const T* x, T m, size_t n) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+
+    T result = 0;
+    size_t i = 0;
+    if (width > 1 && n >= width) {
+        V acc0 = V{}, acc1 = V{}, v, e, vm = V{} + m;
+        for (; i + 2 * width <= n; i += 2 * width) {
+            load(x + i, v);
+            fast_exp<T>(v - vm, e);
+            acc0 += e;
+            load(x + i + width, v);
+            fast_exp<T>(v - vm, e);
+            acc1 += e;
+        }
+        for (; i + width <= n; i += width) {
+            load(x + i, v);
+            fast_exp<T>(v - vm, e);
+            acc0 += e;
+        }
+        acc0 += acc1;
+
+        T lanes[width];
+        store(lanes, acc0);
+        for (size_t k = 0; k < width; ++k) {
+            result += lanes[k];
+        }
+    }
+    for (; i < n; ++i) {
+        T e;
+        fast_exp<T>(x[i] - m, e);
+        result += e;
+    }
+    return result;
+}
+
+/* acc[i] += exp(x[i] - m[i]) */
+template<size_t Bytes, class T>
+TV_ALWAYS_INLINE void exp_accumulate_loop(const T* x, const T* m, T* acc, size_t n) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+
+    size_t i = 0;
+    if (width > 1) {
+        V vx, vm, va, e;
+        for (; i + width <= n; i += width) {
+            load(x + i, vx);
+            load(m + i, vm);
+            load(acc + i, va);
+            fast_exp<T>(vx - vm, e);
+            store(acc + i, va + e);
+        }
+    }
+    for (; i < n; ++i) {
+        T e;
+        fast_exp<T>(x[i] - m[i], e);
+        acc[i] += e;
+    }
+}
+
+/* dst[i] = exp(x[i] - m[i]) * scale[i], Scalar means that m and scale are single broadcasted values */
+template<size_t Bytes, class T, bool Scalar>
+TV_ALWAYS_INLINE void exp_scale_loop(const T* x, const T* m, const T* scale, T* dst, size_t n) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+
+    size_t i = 0;
+    if (width > 1) {
+        V vx, vm, vs, e;
+        if (Scalar) vm = V{} + *m;
+        if (Scalar) vs = V{} + *scale;
+        for (; i + width <= n; i += width) {
+            load(x + i, vx);
+            if (!Scalar) load(m + i, vm);
+            if (!Scalar) load(scale + i, vs);
+            fast_exp<T>(vx - vm, e);
+            store(dst + i, e * vs);
+        }
+    }
+    for (; i < n; ++i) {
+        T e;
+        fast_exp<T>(x[i] - m[Scalar ? 0 : i], e);
+        dst[i] = e * scale[Scalar ? 0 : i];
+    }
+}
+
+template<class T>
+struct ExpSumKernel {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static T avx512(const T* x, T m, size_t n) {
+        return exp_sum_loop<64, T>(x, m, n);
+    }
+
+    TV_TARGET_AVX2 static T avx2(const T* x, T m, size_t n) {
+        return exp_sum_loop<32, T>(x, m, n);
+    }
+
+    TV_TARGET_SSE2 static T sse2(const T* x, T m, size_t n) {
+        return exp_sum_loop<16, T>(x, m, n);
+    }
+#endif
+
+    static T scalar(const T* x, T m, size_t n) {
+        return exp_sum_loop<sizeof(T), T>(x, m, n);
+    }
+
+    static T run(const T* x, T m, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(x, m, n);
+            case Isa::avx2:
+                return avx2(x, m, n);
+            case Isa::sse2:
+                return sse2(x, m, n);
+#endif
+            default:
+                return scalar(x, m, n);
+        }
+    }
+};
+
+template<class T>
+struct ExpAccumulateKernel {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static void avx512(const T* x, const T* m, T* acc, size_t n) {
+        exp_accumulate_loop<64, T>(x, m, acc, n);
+    }
+
+    TV_TARGET_AVX2 static void avx2(const T* x, const T* m, T* acc, size_t n) {
+        exp_accumulate_loop<32, T>(x, m, acc, n);
+    }
+
+    TV_TARGET_SSE2 static void sse2(const T* x, const T* m, T* acc, size_t n) {
+        exp_accumulate_loop<16, T>(x, m, acc, n);
+    }
+#endif
+
+    static void scalar(const T* x, const T* m, T* acc, size_t n) {
+        exp_accumulate_loop<sizeof(T), T>(x, m, acc, n);
+    }
+
+    static void run(const T* x, const T* m, T* acc, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(x, m, acc, n);
+            case Isa::avx2:
+                return avx2(x, m, acc, n);
+            case Isa::sse2:
+                return sse2(x, m, acc, n);
+#endif
+            default:
+                return scalar(x, m, acc, n);
+        }
+    }
+};
+
+template<class T, bool Scalar>
+struct ExpScaleKernel {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static void avx512(const T* x, const T* m, const T* scale, T* dst, size_t n) {
+        exp_scale_loop<64, T, Scalar>(x, m, scale, dst, n);
+    }
+
+    TV_TARGET_AVX2 static void avx2(const T* x, const T* m, const T* scale, T* dst, size_t n) {
+        exp_scale_loop<32, T, Scalar>(x, m, scale, dst, n);
+    }
+
+    TV_TARGET_SSE2 static void sse2(const T* x, const T* m, const T* scale, T* dst, size_t n) {
+        exp_scale_loop<16, T, Scalar>(x, m, scale, dst, n);
+    }
+#endif
+
+    static void scalar(const T* x, const T* m, const T* scale, T* dst, size_t n) {
+        exp_scale_loop<sizeof(T), T, Scalar>(x, m, scale, dst, n);
+    }
+
+    static void run(const T* x, const T* m, const T* scale, T* dst, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(x, m, scale, dst, n);
+            case Isa::avx2:
+                return avx2(x, m, scale, dst, n);
+            case Isa::sse2:
+                return sse2(x, m, scale, dst, n);
+#endif
+            default:
+                return scalar(x, m, scale, dst, n);
+        }
+    }
+};
+
+/* y[i] += a * x[i] */
+template<size_t Bytes, class T>
+TV_ALWAYS_INLINE void scale_add_loop(T a, const T* x, T* y, size_t n) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+
+    size_t i = 0;
+    if (width > 1) {
+        V va = V{} + a, vx, vy;
+        for (; i + width <= n; i += width) {
+            load(x + i, vx);
+            load(y + i, vy);
+            vy += va * vx;
+            store(y + i, vy);
+        }
+    }
+    for (; i < n; ++i) {
+        y[i] += a * x[i];
+    }
+}
+
+template<class T>
+struct ScaleAddKernel {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static void avx512(T a, const T* x, T* y, size_t n) {
+        scale_add_loop<64, T>(a, x, y, n);
+    }
+
+    TV_TARGET_AVX2 static void avx2(T a, const T* x, T* y, size_t n) {
+        scale_add_loop<32, T>(a, x, y, n);
+    }
+
+    TV_TARGET_SSE2 static void sse2(T a, const T* x, T* y, size_t n) {
+        scale_add_loop<16, T>(a, x, y, n);
+    }
+#endif
+
+    static void scalar(T a, const T* x, T* y, size_t n) {
+        scale_add_loop<sizeof(T), T>(a, x, y, n);
+    }
+
+    static void run(T a, const T* x, T* y, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(a, x, y, n);
+            case Isa::avx2:
+                return avx2(a, x, y, n);
+            case Isa::sse2:
+                return sse2(a, x, y, n);
+#endif
+            default:
+                return scalar(a, x, y, n);
+        }
+    }
+};
+
+/* Element types transposed in registers: everything, which is moved as 4 or 8 bytes lanes */
+template<class T>
+struct is_simd_transpose_type {
+    static constexpr bool value = std::is_arithmetic<T>::value && (sizeof(T) == 4 || sizeof(T) == 8);
+};
+
+template<size_t Size>
+struct LaneIndex;
+
+template<>
+struct LaneIndex<4> {
+    using Type = int32_t;
+};
+
+template<>
+struct LaneIndex<8> {
+    using Type = int64_t;
+};
+
+/* Interleaves halves of a and b (the low halves, Offset = 0, or the high ones, Offset = Width / 2):
+ * a[o], b[o], a[o + 1], b[o + 1], ... */
+template<size_t Bytes, size_t Offset, class V, size_t ...I>
+TV_ALWAYS_INLINE V interleave(const V& a, const V& b, std::index_sequence<I...>) {
+    const size_t width = sizeof...(I);
+#ifdef __clang__
+    return __builtin_shufflevector(a, b, ((I % 2 ? width : 0) + Offset + I / 2)...);
+#else
+    using Index = typename LaneIndex<sizeof(V) / width>::Type;
+    using Mask = typename Vec<Index, Bytes>::Type;
+    return __builtin_shuffle(a, b, Mask{static_cast<Index>((I % 2 ? width : 0) + Offset + I / 2)...});
+#endif
+}
+
+/* dst[r * dst_stride + c] = src[r + c * src_stride] for a block of Width x Width elements.
+ * Columns of the source are loaded as vectors and transposed with log2(Width) rounds of interleaving. */
+template<size_t Bytes, class T>
+TV_ALWAYS_INLINE void transpose_block(const T* src, T* dst, ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+    using Lanes = std::make_index_sequence<width>;
+
+    V v[width];
+    V u[width];
+    for (size_t k = 0; k < width; ++k) {
+        load(src + static_cast<ptrdiff_t>(k) * src_stride, v[k]);
+    }
+    for (size_t round = 1; round < width; round *= 2) {
+        for (size_t k = 0; k < width / 2; ++k) {
+            u[2 * k] = interleave<Bytes, 0>(v[k], v[k + width / 2], Lanes{});
+            u[2 * k + 1] = interleave<Bytes, width / 2>(v[k], v[k + width / 2], Lanes{});
+        }
+        for (size_t k = 0; k < width; ++k) {
+            v[k] = u[k];
+        }
+    }
+    for (size_t k = 0; k < width; ++k) {
+        store(dst + static_cast<ptrdiff_t>(k) * dst_stride, v[k]);
+    }
+}
+
+template<class T>
+TV_ALWAYS_INLINE void transpose_scalar(const T* src, T* dst, size_t rows, size_t cols,
+                                       ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            dst[static_cast<ptrdiff_t>(r) * dst_stride + c] = src[r + static_cast<ptrdiff_t>(c) * src_stride];
+        }
+    }
+}
+
+/* dst[r * dst_stride + c] = src[r + c * src_stride], r < rows, c < cols */
+template<size_t Bytes, class T>
+TV_ALWAYS_INLINE void transpose_loop(const T* src, T* dst, size_t rows, size_t cols,
+                                     ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+    const size_t width = Vec<T, Bytes>::Width;
+    size_t r = 0;
+    for (; r + width <= rows; r += width) {
+        size_t c = 0;
+        for (; c + width <= cols; c += width) {
+            transpose_block<Bytes>(src + r + static_cast<ptrdiff_t>(c) * src_stride,
+                                   dst + static_cast<ptrdiff_t>(r) * dst_stride + c, src_stride, dst_stride);
+        }
+        transpose_scalar(src + r + static_cast<ptrdiff_t>(c) * src_stride,
+                         dst + static_cast<ptrdiff_t>(r) * dst_stride + c, width, cols - c, src_stride, dst_stride);
+    }
+    transpose_scalar(src + r, dst + static_cast<ptrdiff_t>(r) * dst_stride, rows - r, cols, src_stride, dst_stride);
+}
+
+/* Blocks are transposed in 16 bytes vectors also with AVX2 / AVX-512: their interleaving across 128-bit lanes
+ * takes several permutations per round and is slower than twice as many unpacks */
+template<class T>
+struct TransposeKernel {
+#if TV_SIMD_X86
+    TV_TARGET_SSE2 static void sse2(const T* src, T* dst, size_t rows, size_t cols,
+                                    ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+        transpose_loop<16>(src, dst, rows, cols, src_stride, dst_stride);
+    }
+#endif
+
+    static void scalar(const T* src, T* dst, size_t rows, size_t cols, ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+        transpose_scalar(src, dst, rows, cols, src_stride, dst_stride);
+    }
+
+    static void run(const T* src, T* dst, size_t rows, size_t cols, ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+            case Isa::avx2:
+            case Isa::sse2:
+                return sse2(src, dst, rows, cols, src_stride, dst_stride);
+#endif
+            default:
+                return scalar(src, dst, rows, cols, src_stride, dst_stride);
+        }
+    }
+};
+
+/* Matrix product of packed panels: c[i * ldc + j] (+)= sum_p a[p * MR + i] * b[p * NR + j], i < MR, j < NR.
+ * Panels of a and b are read sequentially, the MR x NR block of c is kept in registers, NR is two vectors. */
+template<size_t Bytes, size_t MR, class T>
+TV_ALWAYS_INLINE void gemm_micro(size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+    using V = typename Vec<T, Bytes>::Type;
+    const size_t width = Vec<T, Bytes>::Width;
+    const size_t nr = 2 * width;
+
+    /* loops over rows are unrolled, so that accumulators are allocated to registers */
+    V acc[MR][2];
+#pragma GCC unroll 16
+    for (size_t i = 0; i < MR; ++i) {
+        acc[i][0] = V{};
+        acc[i][1] = V{};
+    }
+    for (size_t p = 0; p < k; ++p) {
+        V b0, b1;
+        load(b + p * nr, b0);
+        load(b + p * nr + width, b1);
+#pragma GCC unroll 16
+        for (size_t i = 0; i < MR; ++i) {
+            V ai = V{} + a[p * MR + i];
+            acc[i][0] += ai * b0;
+            acc[i][1] += ai * b1;
+        }
+    }
+#pragma GCC unroll 16
+    for (size_t i = 0; i < MR; ++i) {
+        T* row = c + static_cast<ptrdiff_t>(i) * ldc;
+        if (accumulate) {
+            V c0, c1;
+            load(row, c0);
+            load(row + width, c1);
+            acc[i][0] += c0;
+            acc[i][1] += c1;
+        }
+        store(row, acc[i][0]);
+        store(row + width, acc[i][1]);
+    }
+}
+
+template<size_t MR, size_t NR, class T>
+TV_ALWAYS_INLINE void gemm_scalar(size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+    T acc[MR][NR]{};
+    for (size_t p = 0; p < k; ++p) {
+        for (size_t i = 0; i < MR; ++i) {
+            for (size_t j = 0; j < NR; ++j) {
+                acc[i][j] += a[p * MR + i] * b[p * NR + j];
+            }
+        }
+    }
+    for (size_t i = 0; i < MR; ++i) {
+        T* row = c + static_cast<ptrdiff_t>(i) * ldc;
+        for (size_t j = 0; j < NR; ++j) {
+            row[j] = accumulate ? row[j] + acc[i][j] : acc[i][j];
+        }
+    }
+}
+
+/* Micro-kernel of matrix product. The panel sizes (rows x cols of the block of c) depend on the instruction set,
+ * panels have to be packed for the same instruction set which runs the kernel. int32 panels are used by the
+ * product of quantized 8-bit matrices. */
+template<class T, bool Vectorized = std::is_same<T, float>::value || std::is_same<T, double>::value ||
+                                    std::is_same<T, int32_t>::value>
+struct GemmKernel {
+    static Isa isa() {
+        return Isa::scalar;
+    }
+
+    static size_t rows(Isa) {
+        return 4;
+    }
+
+    static size_t cols(Isa) {
+        return 4;
+    }
+
+    static void run(Isa, size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+        gemm_scalar<4, 4>(k, a, b, c, ldc, accumulate);
+    }
+};
+
+template<class T>
+struct GemmKernel<T, true> {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static void avx512(size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+        gemm_micro<64, 12>(k, a, b, c, ldc, accumulate);
+    }
+
+    TV_TARGET_AVX2 static void avx2(size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+        gemm_micro<32, 6>(k, a, b, c, ldc, accumulate);
+    }
+
+    TV_TARGET_SSE2 static void sse2(size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+        gemm_micro<16, 6>(k, a, b, c, ldc, accumulate);
+    }
+#endif
+
+    static void scalar(size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+        gemm_scalar<4, 4>(k, a, b, c, ldc, accumulate);
+    }
+
+    static Isa isa() {
+        return active_isa();
+    }
+
+    static size_t rows(Isa isa) {
+        switch (isa) {
+            case Isa::avx512:
+                return 12;
+            case Isa::avx2:
+            case Isa::sse2:
+                return 6;
+            default:
+                return 4;
+        }
+    }
+
+    static size_t cols(Isa isa) {
+        switch (isa) {
+            case Isa::avx512:
+                return 2 * 64 / sizeof(T);
+            case Isa::avx2:
+                return 2 * 32 / sizeof(T);
+            case Isa::sse2:
+                return 2 * 16 / sizeof(T);
+            default:
+                return 4;
+        }
+    }
+
+    static void run(Isa isa, size_t k, const T* a, const T* b, T* c, ptrdiff_t ldc, bool accumulate) {
+        switch (isa) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(k, a, b, c, ldc, accumulate);
+            case Isa::avx2:
+                return avx2(k, a, b, c, ldc, accumulate);
+            case Isa::sse2:
+                return sse2(k, a, b, c, ldc, accumulate);
+#endif
+            default:
+                return scalar(k, a, b, c, ldc, accumulate);
+        }
+    }
+};
+
+
+/* Conversions between float and half-precision types: dst[i] = src[i]. float16 is converted by F16C (with AVX2)
+ * and AVX-512 instructions. bfloat16 is widened with integer shifts; it is narrowed with AVX-512 BF16 instructions
+ * if available (they flush subnormal values to zero) and with integer rounding to nearest even otherwise. */
+template<class TSrc, class TDst>
+struct ConvertKernel;
+
+template<class TSrc, class TDst>
+TV_ALWAYS_INLINE void convert_scalar(const TSrc* src, TDst* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<TDst>(src[i]);
+    }
+}
+
+template<>
+struct ConvertKernel<float16, float> {
+#if TV_SIMD_X86
+    /* AVX-512 conversions use masked intrinsics with all lanes set: GCC implements the unmasked ones on top of
+     * an undefined register, which -Wmaybe-uninitialized reports */
+    TV_TARGET_AVX512 static void avx512(const float16* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm512_storeu_ps(dst + i, _mm512_maskz_cvtph_ps(0xffff, h));
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+
+    TV_TARGET_F16C static void f16c(const float16* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+#endif
+
+    static void run(const float16* src, float* dst, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(src, dst, n);
+            case Isa::avx2:
+                if (has_f16c()) {
+                    return f16c(src, dst, n);
+                }
+                break;
+#endif
+            default:
+                break;
+        }
+        convert_scalar(src, dst, n);
+    }
+};
+
+template<>
+struct ConvertKernel<float, float16> {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static void avx512(const float* src, float16* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m256i h = _mm512_maskz_cvtps_ph(0xffff, _mm512_loadu_ps(src + i),
+                                              _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), h);
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+
+    TV_TARGET_F16C static void f16c(const float* src, float16* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+#endif
+
+    static void run(const float* src, float16* dst, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(src, dst, n);
+            case Isa::avx2:
+                if (has_f16c()) {
+                    return f16c(src, dst, n);
+                }
+                break;
+#endif
+            default:
+                break;
+        }
+        convert_scalar(src, dst, n);
+    }
+};
+
+template<>
+struct ConvertKernel<bfloat16, float> {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static void avx512(const bfloat16* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m512i h = _mm512_maskz_cvtepu16_epi32(0xffff,
+                                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+            _mm512_storeu_si512(dst + i, _mm512_maskz_slli_epi32(0xffff, h, 16));
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+
+    TV_TARGET_AVX2 static void avx2(const bfloat16* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_slli_epi32(h, 16));
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+#endif
+
+    static void run(const bfloat16* src, float* dst, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(src, dst, n);
+            case Isa::avx2:
+                return avx2(src, dst, n);
+#endif
+            default:
+                return convert_scalar(src, dst, n);
+        }
+    }
+};
+
+template<>
+struct ConvertKernel<float, bfloat16> {
+#if TV_SIMD_X86
+    /* Same rounding as float_to_bfloat16_bits */
+    TV_TARGET_AVX512 static __m512i round_avx512(__m512 v) {
+        __m512i bits = _mm512_castps_si512(v);
+        __m512i high = _mm512_maskz_srli_epi32(0xffff, bits, 16);
+        __m512i rounded = _mm512_add_epi32(bits, _mm512_add_epi32(_mm512_set1_epi32(0x7fff),
+                                                                 _mm512_and_si512(high, _mm512_set1_epi32(1))));
+        rounded = _mm512_maskz_srli_epi32(0xffff, rounded, 16);
+        return _mm512_mask_mov_epi32(rounded, _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q),
+                                     _mm512_or_si512(high, _mm512_set1_epi32(0x40)));
+    }
+
+#if TV_SIMD_BF16
+    /* vcvtneps2bf16 flushes subnormal inputs to zero, vectors with such values are rounded with integer arithmetic
+     * to give the same result as the other instruction sets */
+    TV_TARGET_AVX512_BF16 static void avx512_bf16(const float* src, bfloat16* dst, size_t n) {
+        const __m512i abs_mask = _mm512_set1_epi32(0x7fffffff);
+        const __m512i one = _mm512_set1_epi32(1);
+        const __m512i max_subnormal = _mm512_set1_epi32(0x007fffff);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m512 v = _mm512_loadu_ps(src + i);
+            __m512i abs = _mm512_and_si512(_mm512_castps_si512(v), abs_mask);
+            /* abs - 1 < 0x7fffff for non-zero subnormal values only */
+            if (_mm512_cmplt_epu32_mask(_mm512_sub_epi32(abs, one), max_subnormal)) {
+                _mm512_mask_cvtepi32_storeu_epi16(dst + i, 0xffff, round_avx512(v));
+            } else {
+                store(dst + i, _mm512_cvtneps_pbh(v));
+            }
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+#endif
+
+    TV_TARGET_AVX512 static void avx512(const float* src, bfloat16* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            _mm512_mask_cvtepi32_storeu_epi16(dst + i, 0xffff, round_avx512(_mm512_loadu_ps(src + i)));
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+
+    TV_TARGET_AVX2 static __m256i round_avx2(__m256 v) {
+        __m256i bits = _mm256_castps_si256(v);
+        __m256i high = _mm256_srli_epi32(bits, 16);
+        __m256i rounded = _mm256_add_epi32(bits, _mm256_add_epi32(_mm256_set1_epi32(0x7fff),
+                                                                 _mm256_and_si256(high, _mm256_set1_epi32(1))));
+        rounded = _mm256_srli_epi32(rounded, 16);
+        __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+        return _mm256_blendv_epi8(rounded, _mm256_or_si256(high, _mm256_set1_epi32(0x40)), nan);
+    }
+
+    TV_TARGET_AVX2 static void avx2(const float* src, bfloat16* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            /* packing works within 128-bit lanes, the permutation restores the order of elements */
+            __m256i packed = _mm256_packus_epi32(round_avx2(_mm256_loadu_ps(src + i)),
+                                                 round_avx2(_mm256_loadu_ps(src + i + 8)));
+            packed = _mm256_permute4x64_epi64(packed, 0xd8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+        }
+        convert_scalar(src + i, dst + i, n - i);
+    }
+#endif
+
+    static void run(const float* src, bfloat16* dst, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+#if TV_SIMD_BF16
+                if (has_avx512bf16()) {
+                    return avx512_bf16(src, dst, n);
+                }
+#endif
+                return avx512(src, dst, n);
+            case Isa::avx2:
+                return avx2(src, dst, n);
+#endif
+            default:
+                return convert_scalar(src, dst, n);
+        }
+    }
+};
+
+
+/* Vector conversion between element types with the same number of lanes, a static_cast of scalars */
+template<class VSrc, class VDst, std::enable_if_t<std::is_arithmetic<VSrc>::value, int> = 0>
+TV_ALWAYS_INLINE void convert_vector(const VSrc& v, VDst& out) {
+    out = static_cast<VDst>(v);
+}
+
+#if TV_SIMD_X86
+template<class VSrc, class VDst, std::enable_if_t<!std::is_arithmetic<VSrc>::value, int> = 0>
+TV_ALWAYS_INLINE void convert_vector(const VSrc& v, VDst& out) {
+    out = __builtin_convertvector(v, VDst);
+}
+#endif
+
+/* Loads quantized values widened to the int32 lanes of a Bytes vector, stores int32 lanes (in the range of TQ)
+ * narrowed to TQ. GCC does not vectorize conversions of 8-bit vector extensions, so that they use intrinsics. */
+template<size_t Bytes, class TQ, bool Bytewise = sizeof(TQ) == 1 && Bytes >= 16>
+struct QuantizedLanes {
+    using VI = typename Vec<int32_t, Bytes>::Type;
+    using VQ = typename Vec<TQ, Bytes / sizeof(int32_t) * sizeof(TQ)>::Type;
+
+    static TV_ALWAYS_INLINE void load(const TQ* ptr, VI& out) {
+        VQ v;
+        simd::load(ptr, v);
+        convert_vector(v, out);
+    }
+
+    static TV_ALWAYS_INLINE void store(TQ* ptr, const VI& v) {
+        VQ out;
+        convert_vector(v, out);
+        simd::store(ptr, out);
+    }
+};
+
+#if TV_SIMD_X86
+template<class TQ>
+struct QuantizedLanes<64, TQ, true> {
+    using VI = Vec<int32_t, 64>::Type;
+
+    /* The unmasked conversions start from an undefined register, which -Wmaybe-uninitialized reports,
+     * the masked forms with all lanes set are the same instructions */
+    TV_TARGET_AVX512 static void load(const TQ* ptr, VI& out) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+        out = (VI) (std::is_signed<TQ>::value ? _mm512_maskz_cvtepi8_epi32(0xffff, v)
+                                              : _mm512_maskz_cvtepu8_epi32(0xffff, v));
+    }
+
+    TV_TARGET_AVX512 static void store(TQ* ptr, const VI& v) {
+        _mm512_mask_cvtepi32_storeu_epi8(ptr, 0xffff, (__m512i) v);
+    }
+};
+
+template<class TQ>
+struct QuantizedLanes<32, TQ, true> {
+    using VI = Vec<int32_t, 32>::Type;
+
+    TV_TARGET_AVX2 static void load(const TQ* ptr, VI& out) {
+        const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr));
+        out = (VI) (std::is_signed<TQ>::value ? _mm256_cvtepi8_epi32(v) : _mm256_cvtepu8_epi32(v));
+    }
+
+    TV_TARGET_AVX2 static void store(TQ* ptr, const VI& v) {
+        const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128((__m256i) v),
+                                              _mm256_extracti128_si256((__m256i) v, 1));
+        const __m128i bytes = std::is_signed<TQ>::value ? _mm_packs_epi16(words, words)
+                                                        : _mm_packus_epi16(words, words);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(ptr), bytes);
+    }
+};
+
+template<class TQ>
+struct QuantizedLanes<16, TQ, true> {
+    using VI = Vec<int32_t, 16>::Type;
+
+    TV_TARGET_SSE2 static void load(const TQ* ptr, VI& out) {
+        int32_t packed;
+        std::memcpy(&packed, ptr, sizeof(packed));
+        const __m128i v = _mm_cvtsi32_si128(packed);
+        if (std::is_signed<TQ>::value) {
+            /* bytes are moved to the top of the lanes and shifted back with sign extension */
+            const __m128i words = _mm_unpacklo_epi8(v, v);
+            out = (VI) _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 24);
+        } else {
+            const __m128i zero = _mm_setzero_si128();
+            out = (VI) _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+        }
+    }
+
+    TV_TARGET_SSE2 static void store(TQ* ptr, const VI& v) {
+        const __m128i words = _mm_packs_epi32((__m128i) v, (__m128i) v);
+        const __m128i bytes = std::is_signed<TQ>::value ? _mm_packs_epi16(words, words)
+                                                        : _mm_packus_epi16(words, words);
+        const int32_t packed = _mm_cvtsi128_si32(bytes);
+        std::memcpy(ptr, &packed, sizeof(packed));
+    }
+};
+#endif
+
+/* out = clamp(round_even(x * inverse_scale) + zero_point) to the range of TQ, NaN becomes the minimum. The value is
+ * clamped before rounding, so that it fits into int32 and (x + 1.5 * 2^23) - 1.5 * 2^23 rounds it to nearest even. */
+template<class TQ, class V, class VI>
+TV_ALWAYS_INLINE void quantize_value(const V& x, const V& inverse_scale, const VI& zero_point, VI& out) {
+    const float magic = 12582912.f;
+    V lo, hi;
+    convert_vector(static_cast<int32_t>(std::numeric_limits<TQ>::min()) - zero_point, lo);
+    convert_vector(static_cast<int32_t>(std::numeric_limits<TQ>::max()) - zero_point, hi);
+    V v = x * inverse_scale;
+    v = v > lo ? v : lo;
+    v = v < hi ? v : hi;
+    v = (v + magic) - magic;
+    convert_vector(v, out);
+    out += zero_point;
+}
+
+/* q[i] = quantize_value(x[i], inverse_scale[i], zero_point[i]), ScaleVector / ZeroPointVector mean that the parameter
+ * is given for every element, otherwise it is a single value */
+template<size_t Bytes, bool ScaleVector, bool ZeroPointVector, class TQ>
+TV_ALWAYS_INLINE void quantize_loop(const float* x, const float* inverse_scale, const int32_t* zero_point, TQ* q,
+                                    size_t n) {
+    using V = typename Vec<float, Bytes>::Type;
+    using VI = typename Vec<int32_t, Bytes>::Type;
+    const size_t width = Vec<float, Bytes>::Width;
+
+    size_t i = 0;
+    if (width > 1) {
+        V vx, vs = V{} + *inverse_scale;
+        VI vz = VI{} + *zero_point, vq;
+        for (; i + width <= n; i += width) {
+            load(x + i, vx);
+            if (ScaleVector) load(inverse_scale + i, vs);
+            if (ZeroPointVector) load(zero_point + i, vz);
+            quantize_value<TQ>(vx, vs, vz, vq);
+            QuantizedLanes<Bytes, TQ>::store(q + i, vq);
+        }
+    }
+    for (; i < n; ++i) {
+        int32_t value;
+        quantize_value<TQ>(x[i], inverse_scale[ScaleVector ? i : 0], zero_point[ZeroPointVector ? i : 0], value);
+        q[i] = static_cast<TQ>(value);
+    }
+}
+
+/* x[i] = (q[i] - zero_point[i]) * scale[i], parameters are passed as in quantize_loop */
+template<size_t Bytes, bool ScaleVector, bool ZeroPointVector, class TQ>
+TV_ALWAYS_INLINE void dequantize_loop(const TQ* q, const float* scale, const int32_t* zero_point, float* x, size_t n) {
+    using V = typename Vec<float, Bytes>::Type;
+    using VI = typename Vec<int32_t, Bytes>::Type;
+    const size_t width = Vec<float, Bytes>::Width;
+
+    size_t i = 0;
+    if (width > 1) {
+        V vs = V{} + *scale, vx;
+        VI vz = VI{} + *zero_point, vq;
+        for (; i + width <= n; i += width) {
+            QuantizedLanes<Bytes, TQ>::load(q + i, vq);
+            if (ScaleVector) load(scale + i, vs);
+            if (ZeroPointVector) load(zero_point + i, vz);
+            convert_vector(vq - vz, vx);
+            store(x + i, vx * vs);
+        }
+    }
+    for (; i < n; ++i) {
+        x[i] = static_cast<float>(static_cast<int32_t>(q[i]) - zero_point[ZeroPointVector ? i : 0]) *
+               scale[ScaleVector ? i : 0];
+    }
+}
+
+/* Conversions between float and quantized values: q = clamp(round(x * inverse_scale) + zero_point),
+ * x = (q - zero_point) * scale. Scales and zero points are either single values or arrays of n elements (per-axis
+ * parameters along the row). TQ is int8_t or uint8_t, dequantization also accepts int32_t (matrix product
+ * accumulators). */
+template<class TQ>
+struct QuantizeKernel {
+    template<bool ScaleVector, bool ZeroPointVector>
+    struct Impl {
+#if TV_SIMD_X86
+        TV_TARGET_AVX512 static void quantize_avx512(const float* x, const float* s, const int32_t* z, TQ* q,
+                                                     size_t n) {
+            quantize_loop<64, ScaleVector, ZeroPointVector>(x, s, z, q, n);
+        }
+
+        TV_TARGET_AVX2 static void quantize_avx2(const float* x, const float* s, const int32_t* z, TQ* q, size_t n) {
+            quantize_loop<32, ScaleVector, ZeroPointVector>(x, s, z, q, n);
+        }
+
+        TV_TARGET_SSE2 static void quantize_sse2(const float* x, const float* s, const int32_t* z, TQ* q, size_t n) {
+            quantize_loop<16, ScaleVector, ZeroPointVector>(x, s, z, q, n);
+        }
+
+        TV_TARGET_AVX512 static void dequantize_avx512(const TQ* q, const float* s, const int32_t* z, float* x,
+                                                       size_t n) {
+            dequantize_loop<64, ScaleVector, ZeroPointVector>(q, s, z, x, n);
+        }
+
+        TV_TARGET_AVX2 static void dequantize_avx2(const TQ* q, const float* s, const int32_t* z, float* x,
+                                                   size_t n) {
+            dequantize_loop<32, ScaleVector, ZeroPointVector>(q, s, z, x, n);
+        }
+
+        TV_TARGET_SSE2 static void dequantize_sse2(const TQ* q, const float* s, const int32_t* z, float* x,
+                                                   size_t n) {
+            dequantize_loop<16, ScaleVector, ZeroPointVector>(q, s, z, x, n);
+        }
+#endif
+
+        static void quantize(const float* x, const float* s, const int32_t* z, TQ* q, size_t n) {
+            switch (active_isa()) {
+#if TV_SIMD_X86
+                case Isa::avx512:
+                    return quantize_avx512(x, s, z, q, n);
+                case Isa::avx2:
+                    return quantize_avx2(x, s, z, q, n);
+                case Isa::sse2:
+                    return quantize_sse2(x, s, z, q, n);
+#endif
+                default:
+                    return quantize_loop<sizeof(float), ScaleVector, ZeroPointVector>(x, s, z, q, n);
+            }
+        }
+
+        static void dequantize(const TQ* q, const float* s, const int32_t* z, float* x, size_t n) {
+            switch (active_isa()) {
+#if TV_SIMD_X86
+                case Isa::avx512:
+                    return dequantize_avx512(q, s, z, x, n);
+                case Isa::avx2:
+                    return dequantize_avx2(q, s, z, x, n);
+                case Isa::sse2:
+                    return dequantize_sse2(q, s, z, x, n);
+#endif
+                default:
+                    return dequantize_loop<sizeof(float), ScaleVector, ZeroPointVector>(q, s, z, x, n);
+            }
+        }
+    };
+
+    static void quantize(const float* x, const float* inverse_scale, bool scale_vector, const int32_t* zero_point,
+                         bool zero_point_vector, TQ* q, size_t n) {
+        if (scale_vector) {
+            return zero_point_vector ? Impl<true, true>::quantize(x, inverse_scale, zero_point, q, n)
+                                     : Impl<true, false>::quantize(x, inverse_scale, zero_point, q, n);
+        }
+        return zero_point_vector ? Impl<false, true>::quantize(x, inverse_scale, zero_point, q, n)
+                                 : Impl<false, false>::quantize(x, inverse_scale, zero_point, q, n);
+    }
+
+    static void dequantize(const TQ* q, const float* scale, bool scale_vector, const int32_t* zero_point,
+                           bool zero_point_vector, float* x, size_t n) {
+        if (scale_vector) {
+            return zero_point_vector ? Impl<true, true>::dequantize(q, scale, zero_point, x, n)
+                                     : Impl<true, false>::dequantize(q, scale, zero_point, x, n);
+        }
+        return zero_point_vector ? Impl<false, true>::dequantize(q, scale, zero_point, x, n)
+                                 : Impl<false, false>::dequantize(q, scale, zero_point, x, n);
+    }
+};
+
+/* Returns sum (a[i] - a_zero) * (b[i] - b_zero) of 8-bit values. Every product fits in int32, the sum is
+ * accumulated in uint32 lanes, so that it wraps modulo 2^32 instead of overflowing a signed integer. */
+template<size_t Bytes, class TA, class TB>
+TV_ALWAYS_INLINE int32_t dot_loop(const TA* a, const TB* b, int32_t a_zero, int32_t b_zero, size_t n) {
+    using VI = typename Vec<int32_t, Bytes>::Type;
+    using VU = typename Vec<uint32_t, Bytes>::Type;
+    const size_t width = Vec<int32_t, Bytes>::Width;
+
+    uint32_t result = 0;
+    size_t i = 0;
+    if (width > 1 && n >= width) {
+        const VI za = VI{} + a_zero;
+        const VI zb = VI{} + b_zero;
+        VU acc{};
+        VI va, vb;
+        for (; i + width <= n; i += width) {
+            QuantizedLanes<Bytes, TA>::load(a + i, va);
+            QuantizedLanes<Bytes, TB>::load(b + i, vb);
+            acc += (VU) ((va - za) * (vb - zb));
+        }
+        uint32_t lanes[width];
+        store(lanes, acc);
+        for (size_t k = 0; k < width; ++k) {
+            result += lanes[k];
+        }
+    }
+    for (; i < n; ++i) {
+        result += static_cast<uint32_t>((static_cast<int32_t>(a[i]) - a_zero) * (static_cast<int32_t>(b[i]) - b_zero));
+    }
+    return static_cast<int32_t>(result);
+}
+
+template<class TA, class TB>
+struct DotKernel {
+#if TV_SIMD_X86
+    TV_TARGET_AVX512 static int32_t avx512(const TA* a, const TB* b, int32_t a_zero, int32_t b_zero, size_t n) {
+        return dot_loop<64>(a, b, a_zero, b_zero, n);
+    }
+
+    TV_TARGET_AVX2 static int32_t avx2(const TA* a, const TB* b, int32_t a_zero, int32_t b_zero, size_t n) {
+        return dot_loop<32>(a, b, a_zero, b_zero, n);
+    }
+
+    TV_TARGET_SSE2 static int32_t sse2(const TA* a, const TB* b, int32_t a_zero, int32_t b_zero, size_t n) {
+        return dot_loop<16>(a, b, a_zero, b_zero, n);
+    }
+#endif
+
+    static int32_t scalar(const TA* a, const TB* b, int32_t a_zero, int32_t b_zero, size_t n) {
+        return dot_loop<sizeof(int32_t)>(a, b, a_zero, b_zero, n);
+    }
+
+    static int32_t run(const TA* a, const TB* b, int32_t a_zero, int32_t b_zero, size_t n) {
+        switch (active_isa()) {
+#if TV_SIMD_X86
+            case Isa::avx512:
+                return avx512(a, b, a_zero, b_zero, n);
+            case Isa::avx2:
+                return avx2(a, b, a_zero, b_zero, n);
+            case Isa::sse2:
+                return sse2(a, b, a_zero, b_zero, n);
+#endif
+            default:
+                return scalar(a, b, a_zero, b_zero, n);
+        }
+    }
+};
+
+} // simd
+
+namespace detail {
+
+template<class F, class TA, class TB, class TDst>
+void transform_impl(const F& f, const TA* a, const TB* b, TDst* dst, size_t n, std::false_type) {
+    std::transform(a, a + n, b, dst, f);
+}
+
+template<class F, class T>
+void transform_impl(const F& f, const T* a, const T* b, T* dst, size_t n, std::true_type) {
+    simd::BinaryKernel<simd::op_code<F, T>::value, T, false, false>::run(a, b, dst, n);
+}
+
+template<class F, class TSrc, class TDst>
+void transform_impl(const F& f, const TSrc* src, TDst* dst, size_t n, std::false_type) {
+    std::transform(src, src + n, dst, f);
+}
+
+template<class F, class T>
+void transform_impl(const BindLhs<F, T>& f, const T* src, T* dst, size_t n, std::true_type) {
+    simd::BinaryKernel<simd::op_code<F, T>::value, T, true, false>::run(&f.value_, src, dst, n);
+}
+
+template<class F, class T>
+void transform_impl(const BindRhs<F, T>& f, const T* src, T* dst, size_t n, std::true_type) {
+    simd::BinaryKernel<simd::op_code<F, T>::value, T, false, true>::run(src, &f.value_, dst, n);
+}
+
+template<class F, class TSrc, class TDst>
+struct is_simd_unary_op : std::false_type {
+};
+
+template<class F, class T>
+struct is_simd_unary_op<BindLhs<F, T>, T, T> : std::integral_constant<bool, simd::is_simd_binary_op<F, T>::value> {
+};
+
+template<class F, class T>
+struct is_simd_unary_op<BindRhs<F, T>, T, T> : std::integral_constant<bool, simd::is_simd_binary_op<F, T>::value> {
+};
+
+/* dst[i] = f(a[i], b[i]) for contiguous arrays */
+template<class F, class TA, class TB, class TDst>
+void transform(const F& f, const TA* a, const TB* b, TDst* dst, size_t n) {
+    using is_simd = std::integral_constant<bool, std::is_same<TA, TDst>::value &&
+                                                 std::is_same<TB, TDst>::value &&
+                                                 simd::is_simd_binary_op<F, TDst>::value>;
+    transform_impl(f, a, b, dst, n, is_simd{});
+}
+
+/* dst[i] = f(src[i]) for contiguous arrays */
+template<class F, class TSrc, class TDst>
+void transform(const F& f, const TSrc* src, TDst* dst, size_t n) {
+    transform_impl(f, src, dst, n, is_simd_unary_op<F, TSrc, TDst>{});
+}
+
+/* dst[i * dst_stride] = f(src[i * src_stride]) */
+template<class F, class TSrc, class TDst>
+void transform_strided(const F& f, const TSrc* src, TDst* dst, size_t n, ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+    if (src_stride == 1 && dst_stride == 1) {
+        transform(f, src, dst, n);
+        return;
+    }
+    if (src_stride == 0 && dst_stride == 1 && n > 0) {
+        std::fill_n(dst, n, f(*src));
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        dst[static_cast<ptrdiff_t>(i) * dst_stride] = f(src[static_cast<ptrdiff_t>(i) * src_stride]);
+    }
+}
+
+template<class F, class TA, class TB, class TDst>
+bool transform_broadcast(const F& f, const TA* a, const TB* b, TDst* dst, size_t n,
+                         ptrdiff_t a_stride, ptrdiff_t b_stride) {
+    return false;
+}
+
+/* Contiguous rows with one operand broadcasted (stride 0) are transformed with the operand bound to the functor,
+ * which the SIMD kernels splat into a vector register */
+template<class F, class T>
+bool transform_broadcast(const F& f, const T* a, const T* b, T* dst, size_t n, ptrdiff_t a_stride,
+                         ptrdiff_t b_stride) {
+    if (a_stride == 1 && b_stride == 0) {
+        transform(bind_rhs(f, *b), a, dst, n);
+        return true;
+    }
+    if (a_stride == 0 && b_stride == 1) {
+        transform(bind_lhs(f, *a), b, dst, n);
+        return true;
+    }
+    return false;
+}
+
+/* dst[i * dst_stride] = f(a[i * a_stride], b[i * b_stride]) */
+template<class F, class TA, class TB, class TDst>
+void transform_strided(const F& f, const TA* a, const TB* b, TDst* dst, size_t n,
+                       ptrdiff_t a_stride, ptrdiff_t b_stride, ptrdiff_t dst_stride) {
+    if (a_stride == 1 && b_stride == 1 && dst_stride == 1) {
+        transform(f, a, b, dst, n);
+        return;
+    }
+    if (dst_stride == 1 && n > 0 && transform_broadcast(f, a, b, dst, n, a_stride, b_stride)) {
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        dst[static_cast<ptrdiff_t>(i) * dst_stride] = f(a[static_cast<ptrdiff_t>(i) * a_stride],
+                                                        b[static_cast<ptrdiff_t>(i) * b_stride]);
+    }
+}
+
+/* dst[i] = src[i] for contiguous arrays, conversions between float and half-precision types are vectorized */
+template<class TSrc, class TDst>
+void convert(const TSrc* src, TDst* dst, size_t n) {
+    std::copy(src, src + n, dst);
+}
+
+inline void convert(const float16* src, float* dst, size_t n) {
+    simd::ConvertKernel<float16, float>::run(src, dst, n);
+}
+
+inline void convert(const float* src, float16* dst, size_t n) {
+    simd::ConvertKernel<float, float16>::run(src, dst, n);
+}
+
+inline void convert(const bfloat16* src, float* dst, size_t n) {
+    simd::ConvertKernel<bfloat16, float>::run(src, dst, n);
+}
+
+inline void convert(const float* src, bfloat16* dst, size_t n) {
+    simd::ConvertKernel<float, bfloat16>::run(src, dst, n);
+}
+
+/* dst[i * dst_stride] = src[i * src_stride] */
+template<class TSrc, class TDst>
+void copy_strided(const TSrc* src, TDst* dst, size_t n, ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+    if (src_stride == 1 && dst_stride == 1) {
+        convert(src, dst, n);
+        return;
+    }
+    if (src_stride == 0 && dst_stride == 1 && n > 0) {
+        std::fill_n(dst, n, *src);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        dst[static_cast<ptrdiff_t>(i) * dst_stride] = src[static_cast<ptrdiff_t>(i) * src_stride];
+    }
+}
+
+template<class TSrc, class TDst>
+void transpose_impl(const TSrc* src, TDst* dst, size_t rows, size_t cols, ptrdiff_t src_stride,
+                    ptrdiff_t dst_stride, std::false_type) {
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            dst[static_cast<ptrdiff_t>(r) * dst_stride + c] = src[r + static_cast<ptrdiff_t>(c) * src_stride];
+        }
+    }
+}
+
+template<class T>
+void transpose_impl(const T* src, T* dst, size_t rows, size_t cols, ptrdiff_t src_stride, ptrdiff_t dst_stride,
+                    std::true_type) {
+    simd::TransposeKernel<T>::run(src, dst, rows, cols, src_stride, dst_stride);
+}
+
+/* dst[r * dst_stride + c] = src[r + c * src_stride], r < rows, c < cols (a tile of a transposition) */
+template<class TSrc, class TDst>
+void transpose(const TSrc* src, TDst* dst, size_t rows, size_t cols, ptrdiff_t src_stride, ptrdiff_t dst_stride) {
+    using is_simd = std::integral_constant<bool, std::is_same<TSrc, TDst>::value &&
+                                                 simd::is_simd_transpose_type<TDst>::value>;
+    transpose_impl(src, dst, rows, cols, src_stride, dst_stride, is_simd{});
+}
+
+template<class F, class T, class TResult>
+TResult accumulate_impl(const F& f, const T* data, size_t n, TResult initial_value, std::false_type) {
+    return std::accumulate(data, data + n, initial_value, f);
+}
+
+template<class F, class T>
+T accumulate_impl(const F& f, const T* data, size_t n, T initial_value, std::true_type) {
+    if (n == 0) {
+        return initial_value;
+    }
+    return f(initial_value, simd::ReduceKernel<simd::op_code<F, T>::value, T>::run(data, n));
+}
+
+/* Folds contiguous array into initial_value */
+template<class F, class T, class TResult>
+TResult accumulate(const F& f, const T* data, size_t n, TResult initial_value) {
+    using is_simd = std::integral_constant<bool, std::is_same<T, TResult>::value &&
+                                                 simd::is_simd_reduce_op<F, T>::value>;
+    return accumulate_impl(f, data, n, initial_value, is_simd{});
+}
+
+template<class T>
+T exp_sum_impl(const T* x, T m, size_t n, std::false_type) {
+    T result = 0;
+    for (size_t i = 0; i < n; ++i) {
+        result += std::exp(x[i] - m);
+    }
+    return result;
+}
+
+template<class T>
+T exp_sum_impl(const T* x, T m, size_t n, std::true_type) {
+    return simd::ExpSumKernel<T>::run(x, m, n);
+}
+
+/* Returns sum of exp(x[i] - m) for contiguous array */
+template<class T>
+T exp_sum(const T* x, T m, size_t n) {
+    return exp_sum_impl(x, m, n, std::integral_constant<bool, simd::is_simd_exp_type<T>::value>{});
+}
+
+template<class T>
+void exp_accumulate_impl(const T* x, const T* m, T* acc, size_t n, std::false_type) {
+    for (size_t i = 0; i < n; ++i) {
+        acc[i] += std::exp(x[i] - m[i]);
+    }
+}
+
+template<class T>
+void exp_accumulate_impl(const T* x, const T* m, T* acc, size_t n, std::true_type) {
+    simd::ExpAccumulateKernel<T>::run(x, m, acc, n);
+}
+
+/* acc[i] += exp(x[i] - m[i]) for contiguous arrays */
+template<class T>
+void exp_accumulate(const T* x, const T* m, T* acc, size_t n) {
+    exp_accumulate_impl(x, m, acc, n, std::integral_constant<bool, simd::is_simd_exp_type<T>::value>{});
+}
+
+template<bool Scalar, class T>
+void exp_scale_impl(const T* x, const T* m, const T* scale, T* dst, size_t n, std::false_type) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = std::exp(x[i] - m[Scalar ? 0 : i]) * scale[Scalar ? 0 : i];
+    }
+}
+
+template<bool Scalar, class T>
+void exp_scale_impl(const T* x, const T* m, const T* scale, T* dst, size_t n, std::true_type) {
+    simd::ExpScaleKernel<T, Scalar>::run(x, m, scale, dst, n);
+}
+
+/* dst[i] = exp(x[i] - m) * scale for contiguous arrays */
+template<class T>
+void exp_scale(const T* x, T m, T scale, T* dst, size_t n) {
+    exp_scale_impl<true>(x, &m, &scale, dst, n, std::integral_constant<bool, simd::is_simd_exp_type<T>::value>{});
+}
+
+/* dst[i] = exp(x[i] - m[i]) * scale[i] for contiguous arrays */
+template<class T>
+void exp_scale(const T* x, const T* m, const T* scale, T* dst, size_t n) {
+    exp_scale_impl<false>(x, m, scale, dst, n, std::integral_constant<bool, simd::is_simd_exp_type<T>::value>{});
+}
+
+template<class T>
+void scale_add_impl(T a, const T* x, T* y, size_t n, std::false_type) {
+    for (size_t i = 0; i < n; ++i) {
+        y[i] += a * x[i];
+    }
+}
+
+template<class T>
+void scale_add_impl(T a, const T* x, T* y, size_t n, std::true_type) {
+    simd::ScaleAddKernel<T>::run(a, x, y, n);
+}
+
+/* y[i] += a * x[i] for contiguous arrays */
+template<class T>
+void scale_add(T a, const T* x, T* y, size_t n) {
+    scale_add_impl(a, x, y, n, std::integral_constant<bool, simd::is_simd_type<T>::value>{});
+}
+
+} // detail
+
+} // namespace
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+
+namespace tensor_view {
+namespace detail {
+
+/* Common iteration space of K strided operands: shape and per-operand strides (in elements) */
+template<size_t N, size_t K>
+struct StridedLayout {
+    static constexpr size_t MaxDims = N > 0 ? N : 1;
+    static constexpr size_t NumOperands = K;
+
+    size_t ndim = 0;
+    size_t shape[MaxDims];
+    ptrdiff_t stride[K][MaxDims];
+
+    /* Appends dimension with given size and strides of operands */
+    void append(size_t size, const ptrdiff_t* strides) {
+        shape[ndim] = size;
+        for (size_t k = 0; k < K; ++k) {
+            stride[k][ndim] = strides[k];
+        }
+        ++ndim;
+    }
+
+    size_t num_elements() const {
+        size_t result = 1;
+        for (size_t i = 0; i < ndim; ++i) {
+            result *= shape[i];
+        }
+        return result;
+    }
+
+    /* Drops dimensions of size 1 and merges adjacent dimensions, which can be traversed as a single one
+     * by every operand (stride[i] == shape[i + 1] * stride[i + 1]). Traversal order is preserved. */
+    void coalesce() {
+        size_t n = 0;
+        for (size_t i = 0; i < ndim; ++i) {
+            if (shape[i] == 1) {
+                continue;
+            }
+            if (n > 0 && mergeable(n - 1, i)) {
+                shape[n - 1] *= shape[i];
+                for (size_t k = 0; k < K; ++k) {
+                    stride[k][n - 1] = stride[k][i];
+                }
+                continue;
+            }
+            shape[n] = shape[i];
+            for (size_t k = 0; k < K; ++k) {
+                stride[k][n] = stride[k][i];
+            }
+            ++n;
+        }
+        ndim = n;
+    }
+
+    bool mergeable(size_t outer, size_t inner) const {
+        for (size_t k = 0; k < K; ++k) {
+            if (stride[k][outer] != static_cast<ptrdiff_t>(shape[inner]) * stride[k][inner]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Number of elements in the first `dims` dimensions */
+    size_t num_elements(size_t dims) const {
+        size_t result = 1;
+        for (size_t i = 0; i < dims; ++i) {
+            result *= shape[i];
+        }
+        return result;
+    }
+};
+
+/* Coalesced layout of N-dimensional shape traversed by K operands with the given strides */
+template<size_t N, size_t K>
+StridedLayout<N, K> make_layout(const size_t* shape, const ptrdiff_t (&strides)[K][N]) {
+    StridedLayout<N, K> layout;
+    for (size_t i = 0; i < N; ++i) {
+        ptrdiff_t dim_strides[K];
+        for (size_t k = 0; k < K; ++k) {
+            dim_strides[k] = strides[k][i];
+        }
+        layout.append(shape[i], dim_strides);
+    }
+    layout.coalesce();
+    return layout;
+}
+
+
+/* Walks over positions of the first `dims` dimensions of a layout in row-major order,
+ * keeping offsets of all operands up to date. */
+template<size_t N, size_t K>
+class StridedCursor {
+public:
+    StridedCursor(const StridedLayout<N, K>& layout, size_t dims, size_t position = 0) :
+            layout_(layout),
+            dims_(dims) {
+        for (size_t k = 0; k < K; ++k) {
+            offset_[k] = 0;
+        }
+        for (size_t i = dims; i-- > 0;) {
+            size_t size = layout.shape[i];
+            index_[i] = position % size;
+            position /= size;
+            for (size_t k = 0; k < K; ++k) {
+                offset_[k] += static_cast<ptrdiff_t>(index_[i]) * layout.stride[k][i];
+            }
+        }
+    }
+
+    /* Moves to the next position */
+    void next() {
+        for (size_t i = dims_; i-- > 0;) {
+            if (++index_[i] < layout_.shape[i]) {
+                for (size_t k = 0; k < K; ++k) {
+                    offset_[k] += layout_.stride[k][i];
+                }
+                return;
+            }
+            index_[i] = 0;
+            for (size_t k = 0; k < K; ++k) {
+                offset_[k] -= static_cast<ptrdiff_t>(layout_.shape[i] - 1) * layout_.stride[k][i];
+            }
+        }
+    }
+
+    ptrdiff_t offset(size_t k) const {
+        return offset_[k];
+    }
+
+private:
+    const StridedLayout<N, K>& layout_;
+    size_t dims_;
+    size_t index_[StridedLayout<N, K>::MaxDims] = {};
+    ptrdiff_t offset_[K];
+};
+
+} // detail
+} // namespace
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+
+#include "Tensor.h"
+#include "TensorView.h"
+#include "Workspace.h"
+
+namespace tensor_view {
+
+namespace detail {
+
+/* Batch of matrices: element (b, i, j) is data[b * batch_stride + i * row_stride + j * col_stride].
+ * A single matrix has batch = 1 and batch_stride = 0, so that it is broadcasted over the batch. */
+template<class T>
+struct MatrixBatch {
+    T* data;
+    size_t batch;
+    size_t rows;
+    size_t cols;
+    ptrdiff_t batch_stride;
+    ptrdiff_t row_stride;
+    ptrdiff_t col_stride;
+
+    T* matrix(size_t b) const {
+        return data + (batch == 1 ? 0 : static_cast<ptrdiff_t>(b) * batch_stride);
+    }
+};
+
+template<class TTensorView>
+MatrixBatch<std::remove_reference_t<decltype(*std::declval<TTensorView&>().data())>>
+matrix_batch(TTensorView& view, std::integral_constant<size_t, 2>) {
+    return {view.data(), 1, view.size(0), view.size(1), 0,
+            static_cast<ptrdiff_t>(view.stride()[0]), static_cast<ptrdiff_t>(view.stride()[1])};
+}
+
+template<class TTensorView>
+MatrixBatch<std::remove_reference_t<decltype(*std::declval<TTensorView&>().data())>>
+matrix_batch(TTensorView& view, std::integral_constant<size_t, 3>) {
+    return {view.data(), view.size(0), view.size(1), view.size(2), static_cast<ptrdiff_t>(view.stride()[0]),
+            static_cast<ptrdiff_t>(view.stride()[1]), static_cast<ptrdiff_t>(view.stride()[2])};
+}
+
+template<class TTensorView>
+auto matrix_batch(TTensorView& view) -> decltype(matrix_batch(view, std::integral_constant<size_t, 2>{})) {
+    static_assert(TTensorView::NumDims == 2 || TTensorView::NumDims == 3, "Matrix product needs 2-D or 3-D tensors");
+    return matrix_batch(view, std::integral_constant<size_t, TTensorView::NumDims>{});
+}
+
+/* Copies an m x k block of a into panels of mr rows, out[panel][p * mr + i]. Rows past m are zero padded.
+ * Elements are converted to T and shifted by -zero (quantized operands are packed as int32 without zero point). */
+template<class TSrc, class T>
+void pack_a(const TSrc* a, ptrdiff_t row_stride, ptrdiff_t col_stride, size_t m, size_t k, size_t mr, T zero,
+            T* out) {
+    for (size_t i0 = 0; i0 < m; i0 += mr) {
+        const size_t rows = std::min(mr, m - i0);
+        for (size_t p = 0; p < k; ++p) {
+            const TSrc* column = a + static_cast<ptrdiff_t>(i0) * row_stride + static_cast<ptrdiff_t>(p) * col_stride;
+            for (size_t i = 0; i < rows; ++i) {
+                out[i] = static_cast<T>(column[static_cast<ptrdiff_t>(i) * row_stride]) - zero;
+            }
+            std::fill(out + rows, out + mr, T(0));
+            out += mr;
+        }
+    }
+}
+
+/* Copies a k x n block of b into panels of nr columns, out[panel][p * nr + j]. Columns past n are zero padded.
+ * Elements are converted to T and shifted by -zero, as in pack_a. */
+template<class TSrc, class T>
+void pack_b(const TSrc* b, ptrdiff_t row_stride, ptrdiff_t col_stride, size_t k, size_t n, size_t nr, T zero,
+            T* out) {
+    for (size_t j0 = 0; j0 < n; j0 += nr) {
+        const size_t cols = std::min(nr, n - j0);
+        for (size_t p = 0; p < k; ++p) {
+            const TSrc* row = b + static_cast<ptrdiff_t>(p) * row_stride + static_cast<ptrdiff_t>(j0) * col_stride;
+            copy_strided(row, out, cols, col_stride, 1);
+            if (zero != T(0)) {
+                for (size_t j = 0; j < cols; ++j) {
+                    out[j] -= zero;
+                }
+            }
+            std::fill(out + cols, out + nr, T(0));
+            out += nr;
+        }
+    }
+}
+
+/* Block sizes: a panel of b (kc x nr) stays in L1, a block of a (mc x kc) in L2 */
+struct GemmBlocking {
+    size_t mr;
+    size_t nr;
+    size_t mc;
+    size_t kc;
+    size_t nc;
+};
+
+template<class T>
+GemmBlocking gemm_blocking(simd::Isa isa) {
+    GemmBlocking blocking;
+    blocking.mr = simd::GemmKernel<T>::rows(isa);
+    blocking.nr = simd::GemmKernel<T>::cols(isa);
+    blocking.kc = std::max<size_t>(64, 1024 / sizeof(T));
+    blocking.mc = std::max<size_t>(1, 120 / blocking.mr) * blocking.mr;
+    blocking.nc = std::max<size_t>(1, 512 / blocking.nr) * blocking.nr;
+    return blocking;
+}
+
+/* c = (a - a_zero) * (b - b_zero) for an m x n block of c, operands are addressed by strides and converted to T */
+template<class TA, class TB, class T>
+void gemm_block(const TA* a, ptrdiff_t a_row_stride, ptrdiff_t a_col_stride,
+                const TB* b, ptrdiff_t b_row_stride, ptrdiff_t b_col_stride,
+                T* c, ptrdiff_t c_row_stride, ptrdiff_t c_col_stride,
+                size_t m, size_t n, size_t k, simd::Isa isa, const GemmBlocking& blocking, T a_zero, T b_zero) {
+    const size_t mr = blocking.mr;
+    const size_t nr = blocking.nr;
+    if (k == 0) {
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                c[static_cast<ptrdiff_t>(i) * c_row_stride + static_cast<ptrdiff_t>(j) * c_col_stride] = T(0);
+            }
+        }
+        return;
+    }
+
+    Workspace& workspace = Workspace::local();
+    WorkspaceScope scope(workspace);
+    const size_t kc = std::min(blocking.kc, k);
+    T* packed_a = static_cast<T*>(workspace.allocate((m + mr - 1) / mr * mr * kc * sizeof(T)));
+    T* packed_b = static_cast<T*>(workspace.allocate((n + nr - 1) / nr * nr * kc * sizeof(T)));
+    T* tile = static_cast<T*>(workspace.allocate(mr * nr * sizeof(T)));
+
+    for (size_t p0 = 0; p0 < k; p0 += kc) {
+        const size_t depth = std::min(kc, k - p0);
+        const bool accumulate = p0 > 0;
+        pack_b(b + static_cast<ptrdiff_t>(p0) * b_row_stride, b_row_stride, b_col_stride, depth, n, nr, b_zero,
+               packed_b);
+        pack_a(a + static_cast<ptrdiff_t>(p0) * a_col_stride, a_row_stride, a_col_stride, m, depth, mr, a_zero,
+               packed_a);
+
+        for (size_t j0 = 0; j0 < n; j0 += nr) {
+            const size_t cols = std::min(nr, n - j0);
+            const T* panel_b = packed_b + j0 * depth;
+            for (size_t i0 = 0; i0 < m; i0 += mr) {
+                const size_t rows = std::min(mr, m - i0);
+                const T* panel_a = packed_a + i0 * depth;
+                T* block = c + static_cast<ptrdiff_t>(i0) * c_row_stride + static_cast<ptrdiff_t>(j0) * c_col_stride;
+                if (rows == mr && cols == nr && c_col_stride == 1) {
+                    simd::GemmKernel<T>::run(isa, depth, panel_a, panel_b, block, c_row_stride, accumulate);
+                    continue;
+                }
+                /* edges and strided rows of c go through a tile */
+                simd::GemmKernel<T>::run(isa, depth, panel_a, panel_b, tile, nr, false);
+                for (size_t i = 0; i < rows; ++i) {
+                    T* row = block + static_cast<ptrdiff_t>(i) * c_row_stride;
+                    for (size_t j = 0; j < cols; ++j) {
+                        T& value = row[static_cast<ptrdiff_t>(j) * c_col_stride];
+                        value = accumulate ? value + tile[i * nr + j] : tile[i * nr + j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* c = (a - a_zero) * (b - b_zero) computed in T, a and b may have narrower types (e.g. int8 with int32 c) */
+template<class T, class TA, class TB>
+void matmul_impl(const MatrixBatch<const TA>& a, const MatrixBatch<const TB>& b, const MatrixBatch<T>& c,
+                 const ExecutionPolicy& policy, T a_zero = T(0), T b_zero = T(0)) {
+    TV_ASSERT(a.cols == b.rows && c.rows == a.rows && c.cols == b.cols, "Incorrect shapes of matrices")
+    TV_ASSERT((a.batch == c.batch || a.batch == 1) && (b.batch == c.batch || b.batch == 1),
+              "Batch sizes of tensors are not compatible")
+    const size_t m = c.rows;
+    const size_t n = c.cols;
+    const size_t k = a.cols;
+    if (c.batch == 0 || m == 0 || n == 0) {
+        return;
+    }
+
+    const simd::Isa isa = simd::GemmKernel<T>::isa();
+    const GemmBlocking blocking = gemm_blocking<T>(isa);
+    /* work items are mc x nc blocks of c in every matrix of the batch */
+    const size_t row_blocks = (m + blocking.mc - 1) / blocking.mc;
+    const size_t col_blocks = (n + blocking.nc - 1) / blocking.nc;
+    const size_t num_items = c.batch * row_blocks * col_blocks;
+    const size_t item_elements = std::min(m, blocking.mc) * std::min(n, blocking.nc) * std::max<size_t>(k, 1);
+
+    parallel_for(policy, num_items, item_elements, [&](size_t begin, size_t end) {
+        for (size_t item = begin; item < end; ++item) {
+            const size_t batch = item / (row_blocks * col_blocks);
+            const size_t i0 = item / col_blocks % row_blocks * blocking.mc;
+            const size_t j0 = item % col_blocks * blocking.nc;
+            gemm_block(a.matrix(batch) + static_cast<ptrdiff_t>(i0) * a.row_stride, a.row_stride, a.col_stride,
+                       b.matrix(batch) + static_cast<ptrdiff_t>(j0) * b.col_stride, b.row_stride, b.col_stride,
+                       c.matrix(batch) + static_cast<ptrdiff_t>(i0) * c.row_stride +
+                               static_cast<ptrdiff_t>(j0) * c.col_stride, c.row_stride, c.col_stride,
+                       std::min(blocking.mc, m - i0), std::min(blocking.nc, n - j0), k, isa, blocking,
+                       a_zero, b_zero);
+        }
+    });
+}
+
+/* Number of dims of a product: 3 if any of operands is a batch */
+template<class TTensorViewA, class TTensorViewB>
+struct matmul_dims : std::integral_constant<size_t, TTensorViewA::NumDims == 3 || TTensorViewB::NumDims == 3 ? 3 : 2> {
+};
+
+template<class T>
+MatrixBatch<const T> as_const(const MatrixBatch<T>& m) {
+    return {m.data, m.batch, m.rows, m.cols, m.batch_stride, m.row_stride, m.col_stride};
+}
+
+} // detail
+
+/* Matrix product dst = a * b of 2-D views or batches of matrices (3-D views, the batch is the first dimension).
+ * A 2-D operand or a batch of size 1 is broadcasted over the batch of dst. Transposed (permuted) operands are read
+ * through strides, without copying. dst must not overlap with a or b. */
+template<class TTensorViewA, class TTensorViewB, class TTensorViewDst,
+         std::enable_if_t<is_tensor_view_v<TTensorViewDst>, int> = 0>
+void matmul(const TTensorViewA& a, const TTensorViewB& b, TTensorViewDst& dst,
+            const ExecutionPolicy& policy = get_execution_policy()) {
+    using T = typename TTensorViewDst::ValueType;
+    static_assert(TTensorViewDst::NumDims == detail::matmul_dims<TTensorViewA, TTensorViewB>::value,
+                  "Incorrect number of dims of destination tensor");
+    static_assert(std::is_same<std::remove_const_t<typename TTensorViewA::ValueType>, T>::value &&
+                  std::is_same<std::remove_const_t<typename TTensorViewB::ValueType>, T>::value,
+                  "Matrix product needs tensors of the same type");
+    static_assert(std::is_arithmetic<T>::value, "Matrix product needs tensors of arithmetic type");
+    detail::matmul_impl<T>(detail::as_const(detail::matrix_batch(a)), detail::as_const(detail::matrix_batch(b)),
+                           detail::matrix_batch(dst), policy);
+}
+
+/* Matrix product a * b, see matmul(a, b, dst) */
+template<class TTensorViewA, class TTensorViewB, size_t N = detail::matmul_dims<TTensorViewA, TTensorViewB>::value>
+Tensor<std::remove_const_t<typename TTensorViewA::ValueType>, N>
+matmul(const TTensorViewA& a, const TTensorViewB& b, const ExecutionPolicy& policy = get_execution_policy()) {
+    size_t shape[N];
+    shape[N - 2] = a.size(TTensorViewA::NumDims - 2);
+    shape[N - 1] = b.size(TTensorViewB::NumDims - 1);
+    if (N == 3) {
+        const size_t batch_a = TTensorViewA::NumDims == 3 ? a.size(0) : 1;
+        shape[0] = batch_a != 1 || TTensorViewB::NumDims == 2 ? batch_a : b.size(0);
+    }
+    Tensor<std::remove_const_t<typename TTensorViewA::ValueType>, N> result(uninitialized, shape);
+    matmul(a, b, result, policy);
+    return result;
+}
+
+} // namespace tensor_view
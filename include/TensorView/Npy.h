@@ -0,0 +1,708 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "TensorView.h"
+#include "Utils.h"
+
+namespace tensor_view {
+
+/* Protection of a mapped file */
+enum class MapMode {
+    read_only,     // shared read-only pages, views are const
+    copy_on_write  // private writable pages, modifications are not written to the file
+};
+
+/* Expected access pattern of a mapped file, passed to madvise() */
+enum class MapAdvice {
+    normal,
+    sequential,
+    random,
+    will_need, // prefetch the pages
+    dont_need
+};
+
+/* NumPy type descriptor of a type: kind ('f', 'i', 'u', 'b') and size in bytes */
+template<class T, class = void>
+struct npy_dtype {
+};
+
+template<class T>
+struct npy_dtype<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+    static constexpr char kind = 'f';
+};
+
+template<class T>
+struct npy_dtype<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>> {
+    static constexpr char kind = std::is_signed<T>::value ? 'i' : 'u';
+};
+
+template<>
+struct npy_dtype<bool> {
+    static constexpr char kind = 'b';
+};
+
+/* '<f2'. bfloat16 has no NumPy type */
+template<>
+struct npy_dtype<float16> {
+    static constexpr char kind = 'f';
+};
+
+/* Header of a .npy file */
+struct NpyHeader {
+    char kind = 0;
+    size_t item_size = 0;
+    bool fortran_order = false;
+    std::vector<size_t> shape;
+    size_t data_offset = 0; // offset of the data from the beginning of the file
+
+    size_t num_elements() const {
+        size_t result = 1;
+        for (size_t dim : shape) {
+            result *= dim;
+        }
+        return result;
+    }
+
+    template<class T>
+    bool holds() const {
+        return kind == npy_dtype<T>::kind && item_size == sizeof(T);
+    }
+};
+
+namespace detail {
+
+/* Value of a key of the header dictionary, e.g. "'<f4'" for "'descr': '<f4', " */
+inline std::string npy_header_value(const std::string& header, const std::string& key) {
+    const size_t key_pos = header.find("'" + key + "'");
+    TV_ASSERT(key_pos != std::string::npos, "No " + key + " in .npy header")
+    size_t begin = header.find(':', key_pos);
+    TV_ASSERT(begin != std::string::npos, "Incorrect .npy header")
+    begin = header.find_first_not_of(' ', begin + 1);
+    TV_ASSERT(begin != std::string::npos, "Incorrect .npy header")
+    const char close = header[begin] == '(' ? ')' : header[begin] == '\'' ? '\'' : ',';
+    const size_t end = header.find(close, begin + 1);
+    TV_ASSERT(end != std::string::npos, "Incorrect .npy header")
+    return header.substr(begin, end - begin + (close == ',' ? 0 : 1));
+}
+
+inline bool little_endian() {
+    const uint16_t value = 1;
+    char byte;
+    std::memcpy(&byte, &value, 1);
+    return byte == 1;
+}
+
+} // detail
+
+/* Parses the magic string, the version and the header dictionary of a .npy file of the given size */
+inline NpyHeader parse_npy_header(const char* data, size_t size) {
+    TV_ASSERT(size >= 10 && std::memcmp(data, "\x93NUMPY", 6) == 0, "Not a .npy file")
+    const unsigned char major = static_cast<unsigned char>(data[6]);
+    TV_ASSERT(major >= 1 && major <= 3, "Unsupported .npy version")
+    const size_t prefix = major == 1 ? 10 : 12;
+    TV_ASSERT(size >= prefix, "Truncated .npy file")
+    const auto byte = [&](size_t i) { return static_cast<size_t>(static_cast<unsigned char>(data[i])); };
+    const size_t header_size = major == 1 ? byte(8) | byte(9) << 8
+                                          : byte(8) | byte(9) << 8 | byte(10) << 16 | byte(11) << 24;
+    TV_ASSERT(size >= prefix + header_size, "Truncated .npy file")
+    const std::string header(data + prefix, header_size);
+
+    NpyHeader result;
+    result.data_offset = prefix + header_size;
+
+    const std::string descr = detail::npy_header_value(header, "descr");
+    TV_ASSERT(descr.size() >= 5 && descr.front() == '\'' && descr.back() == '\'',
+              "Unsupported dtype " + descr + " in .npy file")
+    const char order = descr[1];
+    result.kind = descr[2];
+    result.item_size = std::stoul(descr.substr(3, descr.size() - 4));
+    TV_ASSERT(order == '|' || order == '=' || result.item_size == 1 || (order == '<') == detail::little_endian(),
+              "Byte order of .npy file differs from the machine")
+
+    const std::string fortran_order = detail::npy_header_value(header, "fortran_order");
+    TV_ASSERT(fortran_order == "True" || fortran_order == "False", "Incorrect fortran_order in .npy header")
+    result.fortran_order = fortran_order == "True";
+
+    const std::string shape = detail::npy_header_value(header, "shape");
+    for (size_t pos = 1; pos < shape.size();) {
+        const size_t begin = shape.find_first_of("0123456789", pos);
+        if (begin == std::string::npos) {
+            break;
+        }
+        size_t length;
+        result.shape.push_back(std::stoul(shape.substr(begin), &length));
+        pos = begin + length;
+    }
+
+    TV_ASSERT(size - result.data_offset >= result.num_elements() * result.item_size, "Truncated .npy file")
+    return result;
+}
+
+/* Header of a .npy file with data of the given type and shape, padded to a multiple of 64 bytes */
+inline std::string make_npy_header(char kind, size_t item_size, const size_t* shape, size_t ndim, bool fortran_order) {
+    std::string dict = "{'descr': '";
+    dict += item_size == 1 ? '|' : detail::little_endian() ? '<' : '>';
+    dict += kind + std::to_string(item_size) + "', 'fortran_order': " + (fortran_order ? "True" : "False") +
+            ", 'shape': (";
+    for (size_t i = 0; i < ndim; ++i) {
+        dict += (i > 0 ? ", " : "") + std::to_string(shape[i]);
+    }
+    dict += ndim == 1 ? ",), }" : "), }";
+
+    /* version 1.0 stores the size of the header in 2 bytes, 2.0 - in 4 bytes */
+    const size_t prefix = dict.size() + 64 <= 0xffff ? 10 : 12;
+    const size_t header_size = (prefix + dict.size() + 1 + 63) / 64 * 64 - prefix;
+    dict.append(header_size - dict.size() - 1, ' ');
+    dict += '\n';
+    std::string result = "\x93NUMPY";
+    result += static_cast<char>(prefix == 10 ? 1 : 2);
+    result += '\0';
+    for (size_t i = 0; i < prefix - 8; ++i) {
+        result += static_cast<char>(header_size >> (8 * i) & 0xff);
+    }
+    return result + dict;
+}
+
+/* .npy file mapped into memory. Views returned by view() point to the mapped pages and are valid while the mapping
+ * exists, nothing is read until the elements are accessed:
+ *
+ *     NpyMapping table("table.npy", MapMode::read_only, MapAdvice::random);
+ *     TensorView<const float, 2> view = table.view<float, 2>();
+ */
+class NpyMapping {
+public:
+    NpyMapping() = default;
+
+    explicit NpyMapping(const std::string& path, MapMode mode = MapMode::read_only,
+                        MapAdvice advice = MapAdvice::normal) :
+            mode_(mode) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        TV_ASSERT(fd >= 0, "Cannot open " + path + ": " + std::strerror(errno))
+        struct stat info;
+        const bool has_info = ::fstat(fd, &info) == 0;
+        const int stat_error = errno;
+        if (!has_info || info.st_size == 0) {
+            ::close(fd);
+            TV_ASSERT(false, "Cannot map " + path + ": " + (has_info ? "empty file" : std::strerror(stat_error)))
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        void* data = ::mmap(nullptr, size_, mode == MapMode::read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+                            mode == MapMode::read_only ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        const int error = errno;
+        ::close(fd);
+        TV_ASSERT(data != MAP_FAILED, "Cannot map " + path + ": " + std::strerror(error))
+        data_ = static_cast<char*>(data);
+        try {
+            header_ = parse_npy_header(data_, size_);
+        } catch (...) {
+            unmap();
+            throw;
+        }
+        advise(advice);
+    }
+
+    NpyMapping(NpyMapping&& other) noexcept {
+        swap(other);
+    }
+
+    NpyMapping& operator=(NpyMapping&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~NpyMapping() {
+        unmap();
+    }
+
+    void swap(NpyMapping& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(mode_, other.mode_);
+        std::swap(header_, other.header_);
+    }
+
+    const NpyHeader& header() const {
+        return header_;
+    }
+
+    MapMode mode() const {
+        return mode_;
+    }
+
+    /* Hint about the access pattern of the data */
+    void advise(MapAdvice advice) const {
+        static const int advices[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED, MADV_DONTNEED};
+        if (data_ && advice != MapAdvice::normal) {
+            /* madvise is a hint, errors are not fatal */
+            ::madvise(data_, size_, advices[static_cast<int>(advice)]);
+        }
+    }
+
+    /* Read-only view of the data. Arrays in Fortran order are viewed with reversed strides. */
+    template<class T, size_t ndim>
+    TensorView<const T, ndim> view() const {
+        return make_mapped_view<const T, ndim>();
+    }
+
+    /* Writable view of a copy-on-write mapping */
+    template<class T, size_t ndim>
+    TensorView<T, ndim> mutable_view() {
+        TV_ASSERT(mode_ == MapMode::copy_on_write, "Read-only mapping cannot be modified")
+        return make_mapped_view<T, ndim>();
+    }
+
+private:
+    char* data_ = nullptr;
+    size_t size_ = 0;
+    MapMode mode_ = MapMode::read_only;
+    NpyHeader header_;
+
+    template<class T, size_t ndim>
+    TensorView<T, ndim> make_mapped_view() const {
+        TV_ASSERT(data_, "No file is mapped")
+        TV_ASSERT(header_.holds<std::remove_const_t<T>>(),
+                  std::string("Type of .npy data is ") + header_.kind + std::to_string(header_.item_size))
+        TV_ASSERT(header_.shape.size() == ndim,
+                  "Number of dims of .npy data is " + std::to_string(header_.shape.size()))
+        size_t stride[ndim];
+        size_t step = 1;
+        for (size_t i = 0; i < ndim; ++i) {
+            const size_t dim = header_.fortran_order ? i : ndim - 1 - i;
+            stride[dim] = step;
+            step *= header_.shape[dim];
+        }
+        return TensorView<T, ndim>(reinterpret_cast<T*>(data_ + header_.data_offset), header_.shape.data(), stride);
+    }
+
+    void unmap() {
+        if (data_) {
+            ::munmap(data_, size_);
+            data_ = nullptr;
+        }
+    }
+};
+
+namespace detail {
+
+struct Crc32Table {
+    uint32_t data[8][256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = crc & 1 ? crc >> 1 ^ 0xedb88320u : crc >> 1;
+            }
+            data[0][i] = crc;
+        }
+        for (size_t k = 1; k < 8; ++k) {
+            for (size_t i = 0; i < 256; ++i) {
+                data[k][i] = data[k - 1][i] >> 8 ^ data[0][data[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+/* CRC-32 (as in zip) of data following data with the given crc, 8 bytes per step */
+inline uint32_t crc32(uint32_t crc, const void* data, size_t size) {
+    static const Crc32Table table;
+    const auto& t = table.data;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        const uint32_t lo = (p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24) ^ crc;
+        crc = t[7][lo & 0xff] ^ t[6][lo >> 8 & 0xff] ^ t[5][lo >> 16 & 0xff] ^ t[4][lo >> 24] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; size > 0; --size, ++p) {
+        crc = t[0][(crc ^ *p) & 0xff] ^ crc >> 8;
+    }
+    return ~crc;
+}
+
+/* Buffered writer of a file with writev(): large contiguous runs are written from the memory of the caller, small
+ * runs and strided rows are gathered into a chunk. Optionally computes CRC-32 of the written data. */
+class FileWriter {
+public:
+    static constexpr size_t chunk_size = 1 << 20;
+    static constexpr size_t min_direct_size = 1 << 14;
+
+    explicit FileWriter(const std::string& path) :
+            path_(path),
+            buffer_(chunk_size) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        TV_ASSERT(fd_ >= 0, "Cannot open " + path + ": " + std::strerror(errno))
+    }
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    ~FileWriter() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    /* Writes data, which must stay valid until the next flush() */
+    void write(const void* data, size_t size) {
+        if (size < min_direct_size) {
+            copy(data, size);
+            return;
+        }
+        reserve_iov();
+        add(data, size);
+    }
+
+    /* Writes a copy of data */
+    void copy(const void* data, size_t size) {
+        const char* src = static_cast<const char*>(data);
+        while (size > 0) {
+            reserve_iov();
+            const size_t n = std::min(size, chunk_size - used_);
+            if (n == 0) {
+                flush();
+                continue;
+            }
+            std::memcpy(buffer_.data() + used_, src, n);
+            add(buffer_.data() + used_, n);
+            used_ += n;
+            src += n;
+            size -= n;
+        }
+    }
+
+    /* Writes n elements with the given stride, which must stay valid until the next flush() */
+    template<class T>
+    void write_strided(const T* data, ptrdiff_t stride, size_t n) {
+        if (stride == 1) {
+            write(data, n * sizeof(T));
+            return;
+        }
+        while (n > 0) {
+            reserve_iov();
+            used_ = (used_ + alignof(T) - 1) / alignof(T) * alignof(T);
+            const size_t count = std::min(n, used_ < chunk_size ? (chunk_size - used_) / sizeof(T) : 0);
+            if (count == 0) {
+                flush();
+                continue;
+            }
+            T* dst = reinterpret_cast<T*>(buffer_.data() + used_);
+            copy_strided(data, dst, count, stride, 1);
+            add(dst, count * sizeof(T));
+            used_ += count * sizeof(T);
+            data += static_cast<ptrdiff_t>(count) * stride;
+            n -= count;
+        }
+    }
+
+    void flush() {
+        if (crc_enabled_) {
+            for (const iovec& v : iov_) {
+                crc_ = crc32(crc_, v.iov_base, v.iov_len);
+            }
+        }
+        size_t first = 0;
+        while (first < iov_.size()) {
+            const ssize_t written = ::writev(fd_, iov_.data() + first,
+                                             static_cast<int>(std::min<size_t>(iov_.size() - first, IOV_MAX)));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            TV_ASSERT(written >= 0, "Cannot write " + path_ + ": " + std::strerror(errno))
+            size_t remaining = static_cast<size_t>(written);
+            while (first < iov_.size() && remaining >= iov_[first].iov_len) {
+                remaining -= iov_[first].iov_len;
+                ++first;
+            }
+            if (remaining > 0) {
+                iov_[first].iov_base = static_cast<char*>(iov_[first].iov_base) + remaining;
+                iov_[first].iov_len -= remaining;
+            }
+        }
+        iov_.clear();
+        used_ = 0;
+    }
+
+    /* Flushes and closes the file, reporting errors of writing */
+    void close() {
+        flush();
+        const int result = ::close(fd_);
+        fd_ = -1;
+        TV_ASSERT(result == 0, "Cannot write " + path_ + ": " + std::strerror(errno))
+    }
+
+    /* Number of bytes written so far */
+    uint64_t offset() const {
+        return offset_;
+    }
+
+    /* Starts CRC-32 of the data written after the call */
+    void begin_crc() {
+        flush();
+        crc_ = 0;
+        crc_enabled_ = true;
+    }
+
+    uint32_t end_crc() {
+        flush();
+        crc_enabled_ = false;
+        return crc_;
+    }
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    std::vector<char> buffer_;
+    size_t used_ = 0;
+    std::vector<iovec> iov_;
+    uint64_t offset_ = 0;
+    uint32_t crc_ = 0;
+    bool crc_enabled_ = false;
+
+    void reserve_iov() {
+        if (iov_.size() >= IOV_MAX) {
+            flush();
+        }
+    }
+
+    void add(const void* data, size_t size) {
+        offset_ += size;
+        if (!iov_.empty() && static_cast<char*>(iov_.back().iov_base) + iov_.back().iov_len == data) {
+            iov_.back().iov_len += size;
+            return;
+        }
+        iov_.push_back({const_cast<void*>(data), size});
+    }
+};
+
+/* Whether a view with more than one dim is contiguous in column-major, but not in row-major order */
+template<class TTensorView>
+bool fortran_contiguous(const TTensorView& view) {
+    if (TTensorView::NumDims < 2 || view.is_contiguous()) {
+        return false;
+    }
+    size_t step = 1;
+    for (size_t i = 0; i < TTensorView::NumDims; ++i) {
+        if (view.size(i) != 1 && view.stride()[i] != step) {
+            return false;
+        }
+        step *= view.size(i);
+    }
+    return true;
+}
+
+template<class TTensorView>
+std::string npy_view_header(const TTensorView& view, bool fortran_order) {
+    using T = std::remove_const_t<typename TTensorView::ValueType>;
+    return make_npy_header(npy_dtype<T>::kind, sizeof(T), view.shape(), TTensorView::NumDims, fortran_order);
+}
+
+/* Writes the elements of a view, in row-major order or as laid out in memory for column-major views */
+template<class TTensorView>
+void write_view_data(FileWriter& writer, const TTensorView& view, bool fortran_order) {
+    const size_t N = TTensorView::NumDims;
+    if (fortran_order) {
+        writer.write(view.data(), view.num_elements() * sizeof(typename TTensorView::ValueType));
+        return;
+    }
+    ptrdiff_t strides[1][N];
+    broadcast_strides<N>(view, view.shape(), strides[0]);
+    const auto layout = make_layout(view.shape(), strides);
+    if (layout.num_elements() == 0) {
+        return;
+    }
+    for_each_row(layout, execution::seq, [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+        writer.write_strided(view.data() + offset[0], stride[0], n);
+    });
+}
+
+inline void put_bytes(std::string& record, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        record += static_cast<char>(value >> (8 * i) & 0xff);
+    }
+}
+
+} // detail
+
+/* Writes a view to a .npy file. Strided and permuted views are gathered in chunks, contiguous data is written
+ * directly from the view. Views contiguous in column-major order are saved with fortran_order. */
+template<class TTensorView, enable_if_t<is_tensor_view_v<TTensorView>, int> = 0>
+void save_npy(const std::string& path, const TTensorView& view) {
+    const bool fortran_order = detail::fortran_contiguous(view);
+    const std::string header = detail::npy_view_header(view, fortran_order);
+    detail::FileWriter writer(path);
+    writer.copy(header.data(), header.size());
+    detail::write_view_data(writer, view, fortran_order);
+    writer.close();
+}
+
+/* Incremental writer of an uncompressed .npz archive, as written by numpy.savez(). Every view is streamed
+ * to the file as it is added, the archive is complete after close():
+ *
+ *     NpzWriter archive("activations.npz");
+ *     archive.add("conv1", conv1);
+ *     archive.add("conv2", conv2);
+ *     archive.close();
+ */
+class NpzWriter {
+public:
+    explicit NpzWriter(const std::string& path) :
+            writer_(path) {
+    }
+
+    ~NpzWriter() {
+        if (!closed_) {
+            try {
+                close();
+            } catch (...) {
+            }
+        }
+    }
+
+    /* Adds view as the array `name` (entry name.npy) */
+    template<class TTensorView, enable_if_t<is_tensor_view_v<TTensorView>, int> = 0>
+    void add(const std::string& name, const TTensorView& view) {
+        TV_ASSERT(!closed_, "Archive is closed")
+        const bool fortran_order = detail::fortran_contiguous(view);
+        const std::string header = detail::npy_view_header(view, fortran_order);
+        Entry entry{name + ".npy", 0, header.size() + view.num_elements() * sizeof(typename TTensorView::ValueType),
+                    writer_.offset()};
+        const bool zip64 = entry.size >= 0xffffffff;
+
+        /* sizes and CRC follow the data (flag 0x08) */
+        std::string record;
+        detail::put_bytes(record, 0x04034b50, 4);
+        detail::put_bytes(record, zip64 ? 45 : 20, 2);
+        detail::put_bytes(record, 0x08, 2);
+        detail::put_bytes(record, 0, 4); // stored, modification time
+        detail::put_bytes(record, dos_date, 2);
+        detail::put_bytes(record, 0, 4);
+        detail::put_bytes(record, zip64 ? 0xffffffff : 0, 4);
+        detail::put_bytes(record, zip64 ? 0xffffffff : 0, 4);
+        detail::put_bytes(record, entry.name.size(), 2);
+        detail::put_bytes(record, zip64 ? 20 : 0, 2);
+        record += entry.name;
+        if (zip64) {
+            detail::put_bytes(record, 0x0001, 2);
+            detail::put_bytes(record, 16, 2);
+            detail::put_bytes(record, 0, 8);
+            detail::put_bytes(record, 0, 8);
+        }
+        writer_.copy(record.data(), record.size());
+
+        writer_.begin_crc();
+        writer_.copy(header.data(), header.size());
+        detail::write_view_data(writer_, view, fortran_order);
+        entry.crc = writer_.end_crc();
+
+        record.clear();
+        detail::put_bytes(record, 0x08074b50, 4);
+        detail::put_bytes(record, entry.crc, 4);
+        detail::put_bytes(record, entry.size, zip64 ? 8 : 4);
+        detail::put_bytes(record, entry.size, zip64 ? 8 : 4);
+        writer_.copy(record.data(), record.size());
+        entries_.push_back(entry);
+    }
+
+    /* Writes the central directory and closes the file */
+    void close() {
+        TV_ASSERT(!closed_, "Archive is closed")
+        closed_ = true;
+        const uint64_t directory_offset = writer_.offset();
+        for (const Entry& entry : entries_) {
+            const bool size64 = entry.size >= 0xffffffff;
+            const bool offset64 = entry.offset >= 0xffffffff;
+            std::string extra;
+            if (size64) {
+                detail::put_bytes(extra, entry.size, 8);
+                detail::put_bytes(extra, entry.size, 8);
+            }
+            if (offset64) {
+                detail::put_bytes(extra, entry.offset, 8);
+            }
+            std::string record;
+            detail::put_bytes(record, 0x02014b50, 4);
+            detail::put_bytes(record, size64 || offset64 ? 45 : 20, 2);
+            detail::put_bytes(record, size64 || offset64 ? 45 : 20, 2);
+            detail::put_bytes(record, 0x08, 2);
+            detail::put_bytes(record, 0, 4);
+            detail::put_bytes(record, dos_date, 2);
+            detail::put_bytes(record, entry.crc, 4);
+            detail::put_bytes(record, size64 ? 0xffffffff : entry.size, 4);
+            detail::put_bytes(record, size64 ? 0xffffffff : entry.size, 4);
+            detail::put_bytes(record, entry.name.size(), 2);
+            detail::put_bytes(record, extra.empty() ? 0 : extra.size() + 4, 2);
+            detail::put_bytes(record, 0, 6); // comment, disk, attributes
+            detail::put_bytes(record, 0, 4);
+            detail::put_bytes(record, offset64 ? 0xffffffff : entry.offset, 4);
+            record += entry.name;
+            if (!extra.empty()) {
+                detail::put_bytes(record, 0x0001, 2);
+                detail::put_bytes(record, extra.size(), 2);
+                record += extra;
+            }
+            writer_.copy(record.data(), record.size());
+        }
+
+        const uint64_t directory_size = writer_.offset() - directory_offset;
+        const uint64_t count = entries_.size();
+        std::string record;
+        if (count >= 0xffff || directory_offset >= 0xffffffff || directory_size >= 0xffffffff) {
+            /* zip64 end of central directory and its locator */
+            const uint64_t offset = writer_.offset();
+            detail::put_bytes(record, 0x06064b50, 4);
+            detail::put_bytes(record, 44, 8);
+            detail::put_bytes(record, 45, 2);
+            detail::put_bytes(record, 45, 2);
+            detail::put_bytes(record, 0, 8);
+            detail::put_bytes(record, count, 8);
+            detail::put_bytes(record, count, 8);
+            detail::put_bytes(record, directory_size, 8);
+            detail::put_bytes(record, directory_offset, 8);
+            detail::put_bytes(record, 0x07064b50, 4);
+            detail::put_bytes(record, 0, 4);
+            detail::put_bytes(record, offset, 8);
+            detail::put_bytes(record, 1, 4);
+        }
+        detail::put_bytes(record, 0x06054b50, 4);
+        detail::put_bytes(record, 0, 4);
+        detail::put_bytes(record, std::min<uint64_t>(count, 0xffff), 2);
+        detail::put_bytes(record, std::min<uint64_t>(count, 0xffff), 2);
+        detail::put_bytes(record, std::min<uint64_t>(directory_size, 0xffffffff), 4);
+        detail::put_bytes(record, std::min<uint64_t>(directory_offset, 0xffffffff), 4);
+        detail::put_bytes(record, 0, 2);
+        writer_.copy(record.data(), record.size());
+        writer_.close();
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        uint32_t crc;
+        uint64_t size;
+        uint64_t offset;
+    };
+
+    /* 1980-01-01 in MS-DOS format */
+    static constexpr uint16_t dos_date = 0x21;
+
+    detail::FileWriter writer_;
+    std::vector<Entry> entries_;
+    bool closed_ = false;
+};
+
+} // namespace tensor_view
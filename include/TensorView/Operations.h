@@ -6,6 +6,10 @@
 #include "TensorViewFwd.h"
 #include "Traits.h"
 #include "Utils.h"
+#include "Kernels.h"
+#include "Parallel.h"
+#include "Reductions.h"
+#include "Trace.h"
 
 namespace tensor_view {
 
@@ -36,78 +40,139 @@ public:
     }
 };
 
-template<size_t N>
-class ElementWiseOpImpl {
-public:
-    template<class F, class TensorViewLhs, class TensorViewRhs, class TensorViewDst>
-    static void impl(F f, TensorViewLhs first, TensorViewRhs second, TensorViewDst dst, size_t trivial_dim) {
-        if (N == trivial_dim) {
-            std::transform(first.data(), first.data() + first.num_elements(), second.data(), dst.data(), f);
-            return;
-        }
-        for (int i = 0; i < dst.size(0); ++i) {
-            auto sub_view_first = first.at(first.size(0) == 1 ? 0 : i);
-            auto sub_view_second = second.at(second.size(0) == 1 ? 0 : i);
-            auto sub_view_dst = dst.at(i);
-            ElementWiseOpImpl<N - 1>::impl(f, sub_view_first, sub_view_second, sub_view_dst, trivial_dim);
-        }
+namespace detail {
+
+/* Strides of the view broadcasted to the N-dimensional shape: 0 for added and extended dimensions */
+template<size_t N, class TTensorView>
+void broadcast_strides(const TTensorView& view, const size_t* shape, ptrdiff_t* strides) {
+    const size_t offset = N - TTensorView::NumDims;
+    for (size_t i = 0; i < N; ++i) {
+        bool broadcasted = i < offset || (view.size(i - offset) == 1 && shape[i] != 1);
+        strides[i] = broadcasted ? 0 : static_cast<ptrdiff_t>(view.stride()[i - offset]);
     }
-};
+}
 
+/* Calls row(offset, stride, n) for every row of the innermost dimension of the layout, where offset[k] and stride[k]
+ * are the offset of the first element and the stride of operand k. Rows are split between threads; a single row
+ * is split into ranges. */
+template<size_t N, size_t K, class FRow>
+void for_each_row(const StridedLayout<N, K>& layout, const ExecutionPolicy& policy, FRow&& row) {
+    if (layout.num_elements() == 0) {
+        return;
+    }
+    ptrdiff_t stride[K];
+    if (layout.ndim == 0) {
+        ptrdiff_t offset[K] = {};
+        std::fill(stride, stride + K, 1);
+        row(static_cast<const ptrdiff_t*>(offset), static_cast<const ptrdiff_t*>(stride), size_t(1));
+        return;
+    }
+    const size_t inner = std::min<size_t>(layout.ndim, N) - 1;
+    const size_t num_rows = layout.num_elements(inner);
+    const size_t row_length = layout.shape[inner];
+    for (size_t k = 0; k < K; ++k) {
+        stride[k] = layout.stride[k][inner];
+    }
 
-template<>
-class ElementWiseOpImpl<1> {
-public:
-    template<class F, class TensorViewLhs, class TensorViewRhs, class TensorViewDst>
-    static void impl(F&& f, TensorViewLhs first, TensorViewRhs second, TensorViewDst dst, size_t trivial_dim) {
-        if (trivial_dim == 1) {
-            std::transform(first.data(), first.data() + first.num_elements(), second.data(), dst.data(), f);
-            return;
-        }
-        for (int i = 0; i < dst.size(0); ++i) {
-            const typename TensorViewLhs::ValueType& elem_first = first.at(first.size(0) == 1 ? 0 : i);
-            const typename TensorViewRhs::ValueType& elem_second = second.at(second.size(0) == 1 ? 0 : i);
-            typename TensorViewDst::ValueType& elem_dst = dst.at(i);
-            elem_dst = f(elem_first, elem_second);
-        }
+    if (num_rows == 1) {
+        parallel_for(policy, row_length, 1, [&](size_t begin, size_t end) {
+            ptrdiff_t offset[K];
+            for (size_t k = 0; k < K; ++k) {
+                offset[k] = static_cast<ptrdiff_t>(begin) * stride[k];
+            }
+            row(static_cast<const ptrdiff_t*>(offset), static_cast<const ptrdiff_t*>(stride), end - begin);
+        });
+        return;
     }
-};
+    parallel_for(policy, num_rows, row_length, [&](size_t begin, size_t end) {
+        StridedCursor<N, K> cursor(layout, inner, begin);
+        ptrdiff_t offset[K];
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t k = 0; k < K; ++k) {
+                offset[k] = cursor.offset(k);
+            }
+            row(static_cast<const ptrdiff_t*>(offset), static_cast<const ptrdiff_t*>(stride), row_length);
+            cursor.next();
+        }
+    });
+}
 
-template<size_t N>
-class UnaryOpImpl {
-public:
-    template<class F, class TensorViewSrc, class TensorViewDst>
-    static void impl(F f, TensorViewSrc src, TensorViewDst dst, size_t trivial_dim) {
-        if (trivial_dim == N) {
-            std::transform(src.data(), src.data() + src.num_elements(), dst.data(), f);
-            return;
+/* Copies src to dst, operands 1 and 0 of the layout. If dst is contiguous along dimension a and src along another
+ * dimension b (a transposition, e.g. NCHW <-> NHWC), the two dimensions are copied in tiles small enough to stay in
+ * cache and transposed in registers. Otherwise rows of the innermost dimension are copied as is. */
+template<size_t N, class TSrc, class TDst>
+void copy_layout(const TSrc* src, TDst* dst, const StridedLayout<N, 2>& layout, const ExecutionPolicy& policy) {
+    if (layout.num_elements() == 0) {
+        return;
+    }
+    const size_t tile = 32;
+    const size_t ndim = layout.ndim;
+    size_t a = ndim;
+    size_t b = ndim;
+    for (size_t i = 0; i < ndim; ++i) {
+        if (layout.stride[0][i] == 1 && layout.stride[1][i] != 1) {
+            a = i;
         }
-        for (int i = 0; i < dst.size(0); ++i) {
-            auto sub_view_src = src.at(src.size(0) == 1 ? 0 : i);
-            auto sub_view_dst = dst.at(i);
-            UnaryOpImpl<N - 1>::impl(f, sub_view_src, sub_view_dst, trivial_dim);
+        if (layout.stride[1][i] == 1 && layout.stride[0][i] != 1) {
+            b = i;
         }
     }
-};
-
+    if (a == ndim || b == ndim) {
+        for_each_row(layout, policy, [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+            copy_strided(src + offset[1], dst + offset[0], n, stride[1], stride[0]);
+        });
+        return;
+    }
 
-template<>
-class UnaryOpImpl<1> {
-public:
-    template<class F, class TensorViewSrc, class TensorViewDst>
-    static void impl(F f, TensorViewSrc src, TensorViewDst dst, size_t trivial_dim) {
-        if (trivial_dim == 1) {
-            std::transform(src.data(), src.data() + src.num_elements(), dst.data(), f);
-            return;
-        }
-        for (int i = 0; i < dst.size(0); ++i) {
-            const typename TensorViewSrc::ValueType& elem_src = src.at(src.size(0) == 1 ? 0 : i);
-            typename TensorViewDst::ValueType& elem_dst = dst.at(i);
-            elem_dst = f(elem_src);
+    StridedLayout<N, 2> outer;
+    for (size_t i = 0; i < ndim; ++i) {
+        if (i != a && i != b) {
+            ptrdiff_t strides[] = {layout.stride[0][i], layout.stride[1][i]};
+            outer.append(layout.shape[i], strides);
         }
     }
-};
+    /* tile element (r, c): r along b, c along a */
+    const size_t rows = layout.shape[b];
+    const size_t cols = layout.shape[a];
+    const ptrdiff_t src_stride = layout.stride[1][a];
+    const ptrdiff_t dst_stride = layout.stride[0][b];
+    const size_t row_tiles = (rows + tile - 1) / tile;
+
+    parallel_for(policy, outer.num_elements() * row_tiles, std::min(rows, tile) * cols,
+                 [&](size_t begin, size_t end) {
+        StridedCursor<N, 2> cursor(outer, outer.ndim, begin / row_tiles);
+        size_t row_tile = begin % row_tiles;
+        for (size_t item = begin; item < end; ++item) {
+            const size_t r = row_tile * tile;
+            const TSrc* tile_src = src + cursor.offset(1) + r;
+            TDst* tile_dst = dst + cursor.offset(0) + static_cast<ptrdiff_t>(r) * dst_stride;
+            for (size_t c = 0; c < cols; c += tile) {
+                transpose(tile_src + static_cast<ptrdiff_t>(c) * src_stride, tile_dst + c,
+                          std::min(tile, rows - r), std::min(tile, cols - c), src_stride, dst_stride);
+            }
+            if (++row_tile == row_tiles) {
+                row_tile = 0;
+                cursor.next();
+            }
+        }
+    });
+}
+
+/* dst = src, src is broadcasted to the shape of dst */
+template<class TensorViewSrc, class TensorViewDst>
+void copy_view(const TensorViewSrc& src, TensorViewDst dst, const ExecutionPolicy& policy) {
+    const size_t N = TensorViewDst::NumDims;
+    static_assert(N >= TensorViewSrc::NumDims, "Destination ndim must be greater or equal than source one");
+    TV_ASSERT(check_shapes(dst, src), "Shapes of input tensors are not compatible")
+    TV_TRACE_SCOPE("assign_", dst, 2 * sizeof(typename TensorViewDst::ValueType))
+    ptrdiff_t strides[2][N];
+    broadcast_strides<N>(dst, dst.shape(), strides[0]);
+    broadcast_strides<N>(src, dst.shape(), strides[1]);
+    TV_TRACE_STRIDES(dst.shape(), strides)
+    copy_layout(src.data(), dst.data(), make_layout(dst.shape(), strides), policy);
+}
 
+} // detail
 
 template<class TensorViewLhs, class TensorViewRhs>
 class ElementWiseInplaceOp {
@@ -116,13 +181,26 @@ public:
     using RhsType = TensorViewChecked<TensorViewRhs>;
 
 
+    /* Adjacent dimensions, which are contiguous for both operands, are merged before the traversal */
     template<class F>
-    static void impl(F&& f, TensorViewLhs first, TensorViewRhs second) {
+    static void impl(F&& f, TensorViewLhs first, TensorViewRhs second,
+                     const ExecutionPolicy& policy = get_execution_policy()) {
         static_assert(LhsType::NumDims >= RhsType::NumDims, "Lhs tensor ndim must be greater or equal than rhs' one");
         TV_ASSERT(check_shapes(first, second), "Shapes of input tensors are not compatible")
-        auto second_broadcasted = BroadcastTensors<TensorViewLhs, TensorViewRhs>::impl(first, second);
-        size_t trivial_dim = find_first_trivial_dim(first, second_broadcasted);
-        ElementWiseOpImpl<LhsType::NumDims>::impl(std::forward<F>(f), first, second_broadcasted, first, trivial_dim);
+        const size_t N = LhsType::NumDims;
+        TV_TRACE_SCOPE("map_", first, 3 * sizeof(typename LhsType::ValueType))
+        ptrdiff_t strides[2][N];
+        detail::broadcast_strides<N>(first, first.shape(), strides[0]);
+        detail::broadcast_strides<N>(second, first.shape(), strides[1]);
+        TV_TRACE_STRIDES(first.shape(), strides)
+        auto layout = detail::make_layout(first.shape(), strides);
+
+        auto first_data = first.data();
+        auto second_data = second.data();
+        detail::for_each_row(layout, policy, [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+            detail::transform_strided(f, first_data + offset[0], second_data + offset[1], first_data + offset[0], n,
+                                      stride[0], stride[1], stride[0]);
+        });
     }
 };
 
@@ -130,79 +208,550 @@ template<class TTensorView>
 class UnaryInplaceOp {
 public:
     template<class F>
-    static void impl(F f, TTensorView first) {
-        size_t trivial_dim = find_first_trivial_dim(first, first);
-        UnaryOpImpl<TTensorView::NumDims>::impl(f, first, first, trivial_dim);
+    static void impl(F f, TTensorView first, const ExecutionPolicy& policy = get_execution_policy()) {
+        const size_t N = TTensorView::NumDims;
+        TV_TRACE_SCOPE("map_", first, 2 * sizeof(typename TTensorView::ValueType))
+        ptrdiff_t strides[1][N];
+        detail::broadcast_strides<N>(first, first.shape(), strides[0]);
+        TV_TRACE_STRIDES(first.shape(), strides)
+        auto layout = detail::make_layout(first.shape(), strides);
+
+        auto data = first.data();
+        detail::for_each_row(layout, policy, [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+            detail::transform_strided(f, data + offset[0], data + offset[0], n, stride[0], stride[0]);
+        });
     }
 };
 
 
-template<class TensorViewLhs, class TensorViewRhs, class TFunc>
-class ElementWiseOperation {
+template<class T>
+class Scalar {
 public:
-    using LhsType = TensorViewChecked<TensorViewLhs>;
-    using RhsType = TensorViewChecked<TensorViewRhs>;
+    using ValueType = T;
+    using BroadcastPolicyTag = implicit_broadcast;
+    static constexpr size_t NumDims = 0;
+
+    T value_;
+
+    explicit Scalar(T value) : value_(value) {}
+
+    size_t size(size_t dim) const {
+        return 1;
+    }
+};
+
+namespace detail {
+
+template<class T, class TValue, std::enable_if_t<std::is_arithmetic<T>::value, int> = 0>
+Scalar<TValue> make_operand(const T& value) {
+    return Scalar<TValue>(static_cast<TValue>(value));
+}
+
+template<class T, class TValue, std::enable_if_t<is_tensor_view_v<T>, int> = 0>
+view_t<T> make_operand(const T& view) {
+    /* Owning tensors are stored in expressions as views */
+    return view;
+}
+
+template<class T, class TValue, std::enable_if_t<is_expression_v<T>, int> = 0>
+const T& make_operand(const T& expr) {
+    return expr;
+}
+
+template<class T, class TValue>
+using operand_t = std::decay_t<decltype(make_operand<T, TValue>(std::declval<const T&>()))>;
+
+template<class T, class = void>
+struct operand_value_type {
+    using type = T;
+};
+
+template<class T>
+struct operand_value_type<T, std::enable_if_t<!std::is_arithmetic<T>::value>> {
+    using type = typename T::ValueType;
+};
+
+/* Value type of a binary arithmetic expression: scalars take the type of the tensor operand */
+template<class TLhs, class TRhs>
+using arithmetic_value_t = std::conditional_t<
+        std::is_arithmetic<TLhs>::value,
+        typename operand_value_type<TRhs>::type,
+        std::conditional_t<
+                std::is_arithmetic<TRhs>::value,
+                typename operand_value_type<TLhs>::type,
+                std::common_type_t<typename operand_value_type<TLhs>::type,
+                                   typename operand_value_type<TRhs>::type>>>;
+
+template<class T>
+const T& operand_value(const T& value) {
+    return value;
+}
+
+template<class T>
+T operand_value(const Scalar<T>& scalar) {
+    return scalar.value_;
+}
+
+/* Sub-operand of an N-dimensional expression for index i of its leading dimension.
+ * Operands with less dimensions (and scalars) are broadcasted over leading dimensions as is. */
+template<size_t N, class TOperand, std::enable_if_t<(TOperand::NumDims < N), int> = 0>
+const TOperand& broadcast_at(const TOperand& operand, size_t i) {
+    return operand;
+}
+
+template<size_t N, class TOperand, std::enable_if_t<TOperand::NumDims == N, int> = 0>
+auto broadcast_at(const TOperand& operand, size_t i) {
+    return operand.at(operand.size(0) == 1 ? 0 : i);
+}
+
+/* Merges shape of the operand into the N-dimensional broadcasted shape */
+template<size_t N, class TOperand>
+bool broadcast_shape(const TOperand& operand, size_t* shape) {
+    const size_t offset = N - TOperand::NumDims;
+    for (size_t i = 0; i < TOperand::NumDims; ++i) {
+        size_t size = operand.size(i);
+        size_t& result = shape[offset + i];
+        if (result == 1) {
+            result = size;
+        } else if (size != result && size != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class TLhs, class TRhs, std::enable_if_t<is_scalar_operand<TLhs>::value || is_scalar_operand<TRhs>::value, int> = 0>
+bool check_operand_shapes(const TLhs& lhs, const TRhs& rhs) {
+    return true;
+}
+
+template<class TLhs, class TRhs, std::enable_if_t<!is_scalar_operand<TLhs>::value && !is_scalar_operand<TRhs>::value, int> = 0>
+bool check_operand_shapes(const TLhs& lhs, const TRhs& rhs) {
+    typename TRhs::BroadcastPolicyTag broadcast_tag;
+    return check_shapes(lhs, rhs, broadcast_tag);
+}
+
+} // detail
+
+
+namespace detail {
+
+/* Number of tensor views among leaves of an expression operand */
+template<class T>
+struct num_views : std::integral_constant<size_t, is_tensor_view_v<T> ? 1 : 0> {
+};
+
+template<class TLhs, class TRhs, class TFunc>
+struct num_views<ElementWiseOperation<TLhs, TRhs, TFunc>>
+        : std::integral_constant<size_t, num_views<TLhs>::value + num_views<TRhs>::value> {
+};
+
+template<class TSrc, class TFunc>
+struct num_views<UnaryOperation<TSrc, TFunc>> : num_views<TSrc> {
+};
+
+template<size_t N, size_t K, class TLhs, class TRhs, class TFunc>
+void collect_strides(const ElementWiseOperation<TLhs, TRhs, TFunc>& expr, const size_t* shape,
+                     ptrdiff_t (&strides)[K][N], size_t& k);
+
+template<size_t N, size_t K, class TSrc, class TFunc>
+void collect_strides(const UnaryOperation<TSrc, TFunc>& expr, const size_t* shape,
+                     ptrdiff_t (&strides)[K][N], size_t& k);
+
+template<bool Contiguous, class TLhs, class TRhs, class TFunc>
+auto row_operand(const ElementWiseOperation<TLhs, TRhs, TFunc>& expr, const ptrdiff_t* offset,
+                 const ptrdiff_t* stride, size_t& k);
+
+template<bool Contiguous, class TSrc, class TFunc>
+auto row_operand(const UnaryOperation<TSrc, TFunc>& expr, const ptrdiff_t* offset, const ptrdiff_t* stride,
+                 size_t& k);
+
+template<class TLhs, class TRhs, class TFunc, class F>
+void with_broadcast_row(const ElementWiseOperation<TLhs, TRhs, TFunc>& expr, const ptrdiff_t* offset,
+                        const ptrdiff_t* stride, size_t& k, F&& f);
+
+template<class TSrc, class TFunc, class F>
+void with_broadcast_row(const UnaryOperation<TSrc, TFunc>& expr, const ptrdiff_t* offset, const ptrdiff_t* stride,
+                        size_t& k, F&& f);
+
+/* Appends broadcasted strides of the views of an expression, in the order of leaves */
+template<size_t N, size_t K, class T>
+void collect_strides(const Scalar<T>& scalar, const size_t* shape, ptrdiff_t (&strides)[K][N], size_t& k) {
+}
+
+template<size_t N, size_t K, class TTensorView, std::enable_if_t<is_tensor_view_v<TTensorView>, int> = 0>
+void collect_strides(const TTensorView& view, const size_t* shape, ptrdiff_t (&strides)[K][N], size_t& k) {
+    broadcast_strides<N>(view, shape, strides[k++]);
+}
+
+template<size_t N, size_t K, class TLhs, class TRhs, class TFunc>
+void collect_strides(const ElementWiseOperation<TLhs, TRhs, TFunc>& expr, const size_t* shape,
+                     ptrdiff_t (&strides)[K][N], size_t& k) {
+    collect_strides(expr.lhs_, shape, strides, k);
+    collect_strides(expr.rhs_, shape, strides, k);
+}
+
+template<size_t N, size_t K, class TSrc, class TFunc>
+void collect_strides(const UnaryOperation<TSrc, TFunc>& expr, const size_t* shape,
+                     ptrdiff_t (&strides)[K][N], size_t& k) {
+    collect_strides(expr.src_, shape, strides, k);
+}
+
+/* Elements of an expression along a row of the traversal. Leaves are reduced to pointers and strides,
+ * so that element i of the row is computed without any offset arithmetic besides i * stride. */
+template<class T>
+struct RowScalar {
+    T value;
+
+    T operator()(size_t i) const {
+        return value;
+    }
+};
+
+template<class T, bool Contiguous>
+struct RowView {
+    const T* data;
+    ptrdiff_t stride;
+
+    const T& operator()(size_t i) const {
+        return Contiguous ? data[i] : data[static_cast<ptrdiff_t>(i) * stride];
+    }
+};
+
+template<class TLhs, class TRhs, class TFunc>
+struct RowBinary {
+    TLhs lhs;
+    TRhs rhs;
+    const TFunc& func;
+
+    auto operator()(size_t i) const {
+        return func(lhs(i), rhs(i));
+    }
+};
+
+template<class TSrc, class TFunc>
+struct RowUnary {
+    TSrc src;
+    const TFunc& func;
+
+    auto operator()(size_t i) const {
+        return func(src(i));
+    }
+};
+
+/* Row of an expression operand starting at the given offsets of its views (k is the index of its first view) */
+template<bool Contiguous, class T>
+RowScalar<T> row_operand(const Scalar<T>& scalar, const ptrdiff_t* offset, const ptrdiff_t* stride, size_t& k) {
+    return {scalar.value_};
+}
+
+template<bool Contiguous, class TTensorView, std::enable_if_t<is_tensor_view_v<TTensorView>, int> = 0>
+RowView<typename TTensorView::ValueType, Contiguous>
+row_operand(const TTensorView& view, const ptrdiff_t* offset, const ptrdiff_t* stride, size_t& k) {
+    RowView<typename TTensorView::ValueType, Contiguous> row{view.data() + offset[k], stride[k]};
+    ++k;
+    return row;
+}
+
+template<bool Contiguous, class TLhs, class TRhs, class TFunc>
+auto row_operand(const ElementWiseOperation<TLhs, TRhs, TFunc>& expr, const ptrdiff_t* offset,
+                 const ptrdiff_t* stride, size_t& k) {
+    auto lhs = row_operand<Contiguous>(expr.lhs_, offset, stride, k);
+    auto rhs = row_operand<Contiguous>(expr.rhs_, offset, stride, k);
+    return RowBinary<decltype(lhs), decltype(rhs), TFunc>{lhs, rhs, expr.func_};
+}
+
+template<bool Contiguous, class TSrc, class TFunc>
+auto row_operand(const UnaryOperation<TSrc, TFunc>& expr, const ptrdiff_t* offset, const ptrdiff_t* stride,
+                 size_t& k) {
+    auto src = row_operand<Contiguous>(expr.src_, offset, stride, k);
+    return RowUnary<decltype(src), TFunc>{src, expr.func_};
+}
 
-    TensorViewLhs lhs_;
-    TensorViewRhs rhs_;
+/* Passes the row of an expression, whose views have strides 0 or 1 along the row, to f. Views with stride 0
+ * become RowScalar, so the loop over the row is contiguous with broadcasted values splatted
+ * (e.g. per-channel scaling, a row vector over the last dim or an outer product). */
+template<class T, class F>
+void with_broadcast_row(const Scalar<T>& scalar, const ptrdiff_t* offset, const ptrdiff_t* stride, size_t& k,
+                        F&& f) {
+    f(RowScalar<T>{scalar.value_});
+}
+
+template<class TTensorView, class F, std::enable_if_t<is_tensor_view_v<TTensorView>, int> = 0>
+void with_broadcast_row(const TTensorView& view, const ptrdiff_t* offset, const ptrdiff_t* stride, size_t& k,
+                        F&& f) {
+    using T = std::remove_const_t<typename TTensorView::ValueType>;
+    const T* data = view.data() + offset[k];
+    if (stride[k++] == 0) {
+        f(RowScalar<T>{*data});
+    } else {
+        f(RowView<T, true>{data, 1});
+    }
+}
+
+template<class TLhs, class TRhs, class TFunc, class F>
+void with_broadcast_row(const ElementWiseOperation<TLhs, TRhs, TFunc>& expr, const ptrdiff_t* offset,
+                        const ptrdiff_t* stride, size_t& k, F&& f) {
+    with_broadcast_row(expr.lhs_, offset, stride, k, [&](auto lhs) {
+        with_broadcast_row(expr.rhs_, offset, stride, k, [&](auto rhs) {
+            f(RowBinary<decltype(lhs), decltype(rhs), TFunc>{lhs, rhs, expr.func_});
+        });
+    });
+}
+
+template<class TSrc, class TFunc, class F>
+void with_broadcast_row(const UnaryOperation<TSrc, TFunc>& expr, const ptrdiff_t* offset, const ptrdiff_t* stride,
+                        size_t& k, F&& f) {
+    with_broadcast_row(expr.src_, offset, stride, k, [&](auto src) {
+        f(RowUnary<decltype(src), TFunc>{src, expr.func_});
+    });
+}
+
+/* Each view of an expression doubles the number of row kernels, so expressions with more views are evaluated
+ * by the strided kernel */
+const size_t max_broadcast_row_views = 4;
+
+template<class TExpression, class T>
+bool evaluate_broadcast_row(const TExpression& expr, T* out, const ptrdiff_t* offset, const ptrdiff_t* stride,
+                            size_t n, std::false_type) {
+    return false;
+}
+
+template<class TExpression, class T>
+bool evaluate_broadcast_row(const TExpression& expr, T* out, const ptrdiff_t* offset, const ptrdiff_t* stride,
+                            size_t n, std::true_type) {
+    const size_t K = 1 + num_views<TExpression>::value;
+    if (stride[0] != 1 || !std::all_of(stride + 1, stride + K, [](ptrdiff_t s) { return s == 0 || s == 1; })) {
+        return false;
+    }
+    size_t k = 1;
+    with_broadcast_row(expr, offset, stride, k, [&](const auto& row) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = row(i);
+        }
+    });
+    return true;
+}
+
+/* Evaluates expression into dst laid out as operand 0 of the layout, views of the expression being the rest */
+template<class TExpression, class T, size_t N, size_t K>
+void evaluate(const TExpression& expr, T* dst, const StridedLayout<N, K>& layout, const ExecutionPolicy& policy) {
+    static_assert(K == 1 + num_views<TExpression>::value, "Layout does not match the expression");
+    for_each_row(layout, policy, [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+        T* out = dst + offset[0];
+        size_t k = 1;
+        if (std::all_of(stride, stride + K, [](ptrdiff_t s) { return s == 1; })) {
+            auto row = row_operand<true>(expr, offset, stride, k);
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = row(i);
+            }
+            return;
+        }
+        using is_broadcast_row_enabled = std::integral_constant<bool,
+                num_views<TExpression>::value <= max_broadcast_row_views>;
+        if (evaluate_broadcast_row(expr, out, offset, stride, n, is_broadcast_row_enabled{})) {
+            return;
+        }
+        auto row = row_operand<false>(expr, offset, stride, k);
+        for (size_t i = 0; i < n; ++i) {
+            out[static_cast<ptrdiff_t>(i) * stride[0]] = row(i);
+        }
+    });
+}
+
+/* Evaluates expression into the destination view in a single pass over the coalesced layout of the destination
+ * and all views of the expression */
+template<class TExpression, class TensorViewDst>
+void evaluate(const TExpression& expr, TensorViewDst& dst, const ExecutionPolicy& policy) {
+    const size_t N = TensorViewDst::NumDims;
+    const size_t K = 1 + num_views<TExpression>::value;
+    ptrdiff_t strides[K][N];
+    broadcast_strides<N>(dst, dst.shape(), strides[0]);
+    size_t k = 1;
+    collect_strides(expr, dst.shape(), strides, k);
+    TV_TRACE_STRIDES(dst.shape(), strides)
+    evaluate(expr, dst.data(), make_layout(dst.shape(), strides), policy);
+}
+
+} // detail
+
+
+template<class TLhs, class TRhs, class TFunc>
+class ElementWiseOperation {
+public:
+    using ValueType = std::decay_t<decltype(std::declval<TFunc>()(
+            detail::operand_value(std::declval<typename TLhs::ValueType>()),
+            detail::operand_value(std::declval<typename TRhs::ValueType>())))>;
+    using ShapeType = const size_t*;
+    using BroadcastPolicyTag = implicit_broadcast;
+    static constexpr size_t NumDims = std::max(TLhs::NumDims, TRhs::NumDims);
+
+    TLhs lhs_;
+    TRhs rhs_;
     TFunc func_;
 
-    template<class TensorViewDst>
-    void apply(TensorViewDst& dst) const {
-        static_assert(TensorViewDst::NumDims == TensorViewLhs::NumDims, "Incorrect number of dims of dst tensor");
-        TV_ASSERT(check_shapes(dst, lhs_), "Incorrect shape of destination tensor")
-        TV_ASSERT(check_shapes(dst, rhs_), "Incorrect shape of destination tensor")
-        size_t trivial_dim = std::min(find_first_trivial_dim(lhs_, rhs_), find_first_trivial_dim(lhs_, dst));
-        ElementWiseOpImpl<TensorViewDst::NumDims>::impl(func_, lhs_, rhs_, dst, trivial_dim);
+    ElementWiseOperation(const TLhs& lhs, const TRhs& rhs, TFunc f) :
+            lhs_(lhs),
+            rhs_(rhs),
+            func_(f) {
+        TV_ASSERT(detail::check_operand_shapes(lhs_, rhs_), "Shapes of input tensors are not compatible")
+        std::fill(shape_, shape_ + NumDims, 1);
+        detail::broadcast_shape<NumDims>(lhs_, shape_);
+        detail::broadcast_shape<NumDims>(rhs_, shape_);
     }
 
-    ElementWiseOperation(const TensorViewLhs& lhs, const TensorViewRhs& rhs, TFunc f) :
+    ElementWiseOperation(const TLhs& lhs, const TRhs& rhs, TFunc f, const size_t* shape) :
             lhs_(lhs),
             rhs_(rhs),
-            func_(f) {}
+            func_(f) {
+        /* Sub-expression with already known shape */
+        std::copy(shape, shape + NumDims, shape_);
+    }
+
+    template<class TensorViewDst>
+    void apply(TensorViewDst& dst, const ExecutionPolicy& policy = get_execution_policy()) const {
+        static_assert(TensorViewDst::NumDims == NumDims, "Incorrect number of dims of dst tensor");
+        TV_ASSERT(detail::check_shapes(dst, *this, implicit_broadcast{}), "Incorrect shape of destination tensor")
+        TV_TRACE_SCOPE("element_wise", dst,
+                       (1 + detail::num_views<ElementWiseOperation>::value) * sizeof(typename TensorViewDst::ValueType))
+        detail::evaluate(*this, dst, policy);
+    }
+
+    template<size_t D = NumDims, std::enable_if_t<(D > 1), int> = 0>
+    auto at(size_t i) const {
+        auto lhs = detail::broadcast_at<NumDims>(lhs_, i);
+        auto rhs = detail::broadcast_at<NumDims>(rhs_, i);
+        return ElementWiseOperation<decltype(lhs), decltype(rhs), TFunc>(lhs, rhs, func_, shape_ + 1);
+    }
+
+    template<size_t D = NumDims, std::enable_if_t<D == 1, int> = 0>
+    ValueType at(size_t i) const {
+        return func_(detail::operand_value(detail::broadcast_at<1>(lhs_, i)),
+                     detail::operand_value(detail::broadcast_at<1>(rhs_, i)));
+    }
+
+    template<class Func>
+    auto map(Func&& f) const {
+        return make_unary_op(std::forward<Func>(f), *this);
+    }
+
+    ShapeType shape() const {
+        return shape_;
+    }
+
+    size_t size(size_t dim) const {
+        return shape_[dim];
+    }
+
+    size_t num_elements() const {
+        return std::accumulate(shape_, shape_ + NumDims, size_t(1), std::multiplies<>());
+    }
+
+private:
+    size_t shape_[NumDims];
+};
+
+template<class F, class TLhs, class TRhs, class TValue = detail::arithmetic_value_t<TLhs, TRhs>>
+ElementWiseOperation<detail::operand_t<TLhs, TValue>, detail::operand_t<TRhs, TValue>, std::decay_t<F>>
+make_element_wise_op(F&& f, const TLhs& first, const TRhs& second) {
+    return {detail::make_operand<TLhs, TValue>(first),
+            detail::make_operand<TRhs, TValue>(second),
+            std::forward<F>(f)};
+}
+
+namespace detail {
+template<class TLhs, class TRhs>
+struct is_arithmetic_expression_args {
+    static constexpr bool const value = is_expression_operand_v<TLhs> &&
+                                        is_expression_operand_v<TRhs> &&
+                                        (is_tensor_view_v<TLhs> || is_expression_v<TLhs> ||
+                                         is_tensor_view_v<TRhs> || is_expression_v<TRhs>);
 };
+}
+
+template<class TLhs, class TRhs, std::enable_if_t<detail::is_arithmetic_expression_args<TLhs, TRhs>::value, int> = 0>
+auto operator+(const TLhs& lhs, const TRhs& rhs) {
+    return make_element_wise_op(std::plus<detail::arithmetic_value_t<TLhs, TRhs>>(), lhs, rhs);
+}
+
+template<class TLhs, class TRhs, std::enable_if_t<detail::is_arithmetic_expression_args<TLhs, TRhs>::value, int> = 0>
+auto operator-(const TLhs& lhs, const TRhs& rhs) {
+    return make_element_wise_op(std::minus<detail::arithmetic_value_t<TLhs, TRhs>>(), lhs, rhs);
+}
+
+template<class TLhs, class TRhs, std::enable_if_t<detail::is_arithmetic_expression_args<TLhs, TRhs>::value, int> = 0>
+auto operator*(const TLhs& lhs, const TRhs& rhs) {
+    return make_element_wise_op(std::multiplies<detail::arithmetic_value_t<TLhs, TRhs>>(), lhs, rhs);
+}
 
-template<class F, class TensorViewLhs, class TensorViewRhs>
-ElementWiseOperation<
-        typename BroadcastTensors<TensorViewLhs, TensorViewRhs>::ResultType,
-        typename BroadcastTensors<TensorViewRhs, TensorViewLhs>::ResultType,
-        F>
-make_reduce_operation(const F& f, const TensorViewLhs& first, const TensorViewRhs& second) {
-    TV_ASSERT(check_shapes(first, second), "Shapes of input tensors are not compatible")
-    auto first_broadcasted = BroadcastTensors<TensorViewLhs, TensorViewRhs>::impl(first, second);
-    auto second_broadcasted = BroadcastTensors<TensorViewRhs, TensorViewLhs>::impl(second, first);
+template<class TLhs, class TRhs, std::enable_if_t<detail::is_arithmetic_expression_args<TLhs, TRhs>::value, int> = 0>
+auto operator/(const TLhs& lhs, const TRhs& rhs) {
+    return make_element_wise_op(std::divides<detail::arithmetic_value_t<TLhs, TRhs>>(), lhs, rhs);
+}
 
-    static_assert(decltype(first_broadcasted)::NumDims == decltype(second_broadcasted)::NumDims,
-                  "Incorrect number of dims after broadcast");
-    return {first_broadcasted, second_broadcasted, f};
+template<class TSrc, std::enable_if_t<is_tensor_view_v<TSrc> || is_expression_v<TSrc>, int> = 0>
+auto operator-(const TSrc& src) {
+    return make_unary_op(std::negate<typename TSrc::ValueType>(), src);
 }
 
-template<class TensorViewSrc, class TFunc>
+template<class TSrc, class TFunc>
 class UnaryOperation {
 public:
-    using SrcType = TensorViewChecked<TensorViewSrc>;
+    using ValueType = std::decay_t<decltype(std::declval<TFunc>()(std::declval<typename TSrc::ValueType>()))>;
+    using ShapeType = const size_t*;
+    using BroadcastPolicyTag = implicit_broadcast;
+    static constexpr size_t NumDims = TSrc::NumDims;
 
-    TensorViewSrc src_;
+    TSrc src_;
     TFunc func_;
 
     template<class TensorViewDst>
-    void apply(TensorViewDst& dst) const {
-        static_assert(TensorViewDst::NumDims == TensorViewSrc::NumDims, "Incorrect number of dims of dst tensor");
-        TV_ASSERT(check_shapes(dst, src_), "Incorrect shape of destination tensor")
-        size_t trivial_dim = find_first_trivial_dim(src_, dst);
-        UnaryOpImpl<TensorViewDst::NumDims>::impl(func_, src_, dst, trivial_dim);
+    void apply(TensorViewDst& dst, const ExecutionPolicy& policy = get_execution_policy()) const {
+        static_assert(TensorViewDst::NumDims == NumDims, "Incorrect number of dims of dst tensor");
+        TV_ASSERT(detail::check_shapes(dst, src_, implicit_broadcast{}), "Incorrect shape of destination tensor")
+        TV_TRACE_SCOPE("unary", dst,
+                       (1 + detail::num_views<UnaryOperation>::value) * sizeof(typename TensorViewDst::ValueType))
+        detail::evaluate(*this, dst, policy);
     }
 
-    UnaryOperation(const TensorViewSrc& src, TFunc f) :
+    UnaryOperation(const TSrc& src, TFunc f) :
             src_(src),
             func_(f) {}
+
+    template<size_t D = NumDims, std::enable_if_t<(D > 1), int> = 0>
+    auto at(size_t i) const {
+        auto src = src_.at(i);
+        return UnaryOperation<decltype(src), TFunc>(src, func_);
+    }
+
+    template<size_t D = NumDims, std::enable_if_t<D == 1, int> = 0>
+    ValueType at(size_t i) const {
+        return func_(src_.at(i));
+    }
+
+    template<class Func>
+    auto map(Func&& f) const {
+        return make_unary_op(std::forward<Func>(f), *this);
+    }
+
+    ShapeType shape() const {
+        return src_.shape();
+    }
+
+    size_t size(size_t dim) const {
+        return src_.size(dim);
+    }
+
+    size_t num_elements() const {
+        return src_.num_elements();
+    }
 };
 
 
-template<class F, class TensorViewSrc>
-UnaryOperation<TensorViewSrc, F>
-make_unary_op(F&& f, const TensorViewSrc& first) {
-    return {first, std::forward<F>(f)};
+template<class F, class TSrc>
+UnaryOperation<detail::operand_t<TSrc, void>, std::decay_t<F>>
+make_unary_op(F&& f, const TSrc& first) {
+    return {detail::make_operand<TSrc, void>(first), std::forward<F>(f)};
 }
 
 template<class TensorViewLhs, class TInitial, class TFunc>
@@ -216,10 +765,10 @@ public:
     TInitial initial_;
 
     template<class TensorViewDst>
-    void apply(TensorViewDst& dst) const {
+    void apply(TensorViewDst& dst, const ExecutionPolicy& policy = get_execution_policy()) const {
         static_assert(TensorViewDst::NumDims + 1 == TensorViewLhs::NumDims, "Incorrect number of dims of dst tensor");
         auto initial = static_cast<typename TensorViewDst::ValueType>(initial_);
-        src_.reduce(func_, dst, axis_, initial);
+        src_.reduce(func_, dst, axis_, initial, policy);
     }
 
     ReduceOperation(const TensorViewLhs& lhs, size_t axis, TFunc f, TInitial initial) :
@@ -236,111 +785,4 @@ make_reduce_operation(F&& f, const TensorViewSrc& src, size_t axis, TInitial ini
 }
 
 
-template<size_t N>
-class AllReduceImpl {
-public:
-    template<class F, class TTensorViewType, class T>
-    static void impl(F&& f, TTensorViewType&& view, T& t, size_t trivial_dim, T initial_value) {
-        if (trivial_dim == N) {
-            t = std::accumulate(view.data(), view.data() + view.num_elements(), initial_value, f);
-            return;
-        }
-        for (int i = 0; i < view.size(0); ++i) {
-            auto sub_view = view.at(i);
-            AllReduceImpl<N - 1>::impl(std::forward<F>(f), sub_view, t, trivial_dim, initial_value);
-        }
-    }
-};
-
-template<>
-class AllReduceImpl<1> {
-public:
-    template<class F, class TTensorView, class T>
-    static void impl(F&& f, TTensorView view, T& t, size_t trivial_dim, T initial_value) {
-        if (trivial_dim == 1) {
-            t = std::accumulate(view.data(), view.data() + view.num_elements(), initial_value, f);
-            return;
-        }
-        for (int i = 0; i < view.size(0); ++i) {
-            typename TTensorView::ValueType at = view.at(i);
-            t = f(t, at);
-        }
-    }
-};
-
-template<size_t N, size_t M>
-class ReduceDim {
-public:
-    template<class F, class TTensorViewSrc, class TTensorViewDst>
-    static void impl(F&& f, const TTensorViewSrc& src, TTensorViewDst dst, size_t reduce_dim) {
-        for (int i = 0; i < src.size(0); ++i) {
-            if (reduce_dim == N) {
-                ReduceDim<N - 1, M>::impl(f, src.at(i), dst, reduce_dim);
-            } else {
-                ReduceDim<N - 1, M - 1>::impl(f, src.at(i), dst.at(i), reduce_dim);
-            }
-        }
-    }
-};
-
-template<size_t N>
-class ReduceDim<N, N> {
-public:
-    template<class F, class TTensorViewSrc, class TTensorViewDst>
-    static void impl(F&& f, const TTensorViewSrc& src, TTensorViewDst dst, size_t reduce_dim) {
-        for (int i = 0; i < src.size(0); ++i) {
-            ReduceDim<N - 1, N - 1>::impl(f, src.at(i), dst.at(i), reduce_dim);
-        }
-    }
-};
-
-template<>
-class ReduceDim<1, 0> {
-public:
-    template<class F, class TTensorViewSrc, class TResult>
-    static void impl(F&& f, const TTensorViewSrc& src, TResult& dst, size_t reduce_dim) {
-        for (int i = 0; i < src.size(0); ++i) {
-            dst = f(dst, src.at(i));
-        }
-    }
-};
-
-template<>
-class ReduceDim<1, 1> {
-public:
-    template<class F, class TTensorViewSrc, class TTensorViewDst>
-    static void impl(F&& f, const TTensorViewSrc& src, TTensorViewDst dst, size_t reduce_dim) {
-        for (int i = 0; i < src.size(0); ++i) {
-            dst.at(i) = f(dst.at(i), src.at(i));
-        }
-    }
-};
-
-
-namespace detail {
-template<class T>
-struct is_operation : std::false_type {
-};
-
-template<class T1, class T2, class T3>
-struct is_operation<ElementWiseOperation<T1, T2, T3>> : std::true_type {
-};
-
-template<class T1, class T2, class T3>
-struct is_operation<ReduceOperation<T1, T2, T3>> : std::true_type {
-};
-
-template<class T1, class T2>
-struct is_operation<UnaryOperation<T1, T2>> : std::true_type {
-};
-}
-
-template<class T>
-struct is_operation {
-    static constexpr bool const value = detail::is_operation<std::decay_t<T>>::value;
-};
-
-template<class T>
-constexpr bool is_operation_v = is_operation<T>::value;
-
 } // namespace
\ No newline at end of file
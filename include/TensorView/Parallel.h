@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tensor_view {
+
+/* Controls how many threads may be used by an operation.
+ * Operations on tensors with less than 2 * min_elements_per_thread elements are always single-threaded. */
+struct ExecutionPolicy {
+    size_t max_threads = 1; // 0 - use all threads of the pool
+    size_t min_elements_per_thread = 1 << 15;
+};
+
+namespace execution {
+const ExecutionPolicy seq{1};
+const ExecutionPolicy par{0};
+}
+
+namespace detail {
+inline std::atomic<size_t>& policy_max_threads() {
+    static std::atomic<size_t> max_threads{execution::seq.max_threads};
+    return max_threads;
+}
+
+inline std::atomic<size_t>& policy_min_elements_per_thread() {
+    static std::atomic<size_t> min_elements{execution::seq.min_elements_per_thread};
+    return min_elements;
+}
+
+inline bool& in_parallel_region() {
+    static thread_local bool in_region = false;
+    return in_region;
+}
+
+class ParallelRegionGuard {
+public:
+    ParallelRegionGuard() : previous_(in_parallel_region()) {
+        in_parallel_region() = true;
+    }
+
+    ~ParallelRegionGuard() {
+        in_parallel_region() = previous_;
+    }
+
+private:
+    bool previous_;
+};
+}
+
+/* Policy used by operators and by methods called without explicit policy */
+inline void set_execution_policy(const ExecutionPolicy& policy) {
+    detail::policy_max_threads().store(policy.max_threads);
+    detail::policy_min_elements_per_thread().store(policy.min_elements_per_thread);
+}
+
+inline ExecutionPolicy get_execution_policy() {
+    ExecutionPolicy policy;
+    policy.max_threads = detail::policy_max_threads().load();
+    policy.min_elements_per_thread = detail::policy_min_elements_per_thread().load();
+    return policy;
+}
+
+
+/* Fixed-size pool of worker threads. The calling thread takes part in the execution of its tasks. */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t num_threads) {
+        for (size_t i = 1; i < num_threads; ++i) {
+            workers_.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /* Number of threads including the calling one */
+    size_t size() const {
+        return workers_.size() + 1;
+    }
+
+    /* Calls f(i) for i in [0, num_tasks) and waits for completion.
+     * If the pool is busy with tasks of another thread, tasks are executed serially by the caller. */
+    template<class F>
+    void run(size_t num_tasks, F&& f) {
+        std::unique_lock<std::mutex> job_lock(job_mutex_, std::try_to_lock);
+        if (!job_lock.owns_lock() || num_tasks < 2 || workers_.empty()) {
+            detail::ParallelRegionGuard guard;
+            for (size_t i = 0; i < num_tasks; ++i) {
+                f(i);
+            }
+            return;
+        }
+
+        std::function<void(size_t)> task(std::ref(f));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            num_tasks_ = num_tasks;
+            next_task_.store(0);
+            pending_ = num_tasks;
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        finish_tasks(execute_tasks(task, num_tasks), false);
+
+        /* workers may still hold the task, even if all of its items are done */
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0 && active_workers_ == 0; });
+        task_ = nullptr;
+    }
+
+    static ThreadPool& instance() {
+        static ThreadPool pool(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+        return pool;
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::mutex job_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+
+    std::function<void(size_t)>* task_ = nullptr;
+    size_t num_tasks_ = 0;
+    std::atomic<size_t> next_task_{0};
+    size_t pending_ = 0;
+    size_t active_workers_ = 0;
+    size_t generation_ = 0;
+    bool stop_ = false;
+
+    size_t execute_tasks(const std::function<void(size_t)>& task, size_t num_tasks) {
+        detail::ParallelRegionGuard guard;
+        size_t completed = 0;
+        for (size_t i = next_task_++; i < num_tasks; i = next_task_++) {
+            task(i);
+            ++completed;
+        }
+        return completed;
+    }
+
+    void finish_tasks(size_t completed, bool worker) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ -= completed;
+        active_workers_ -= worker;
+        if (pending_ == 0 && active_workers_ == 0) {
+            done_.notify_all();
+        }
+    }
+
+    void worker_loop() {
+        size_t seen_generation = 0;
+        while (true) {
+            std::function<void(size_t)>* task;
+            size_t num_tasks;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || (generation_ != seen_generation && task_); });
+                if (stop_) {
+                    return;
+                }
+                seen_generation = generation_;
+                task = task_;
+                num_tasks = num_tasks_;
+                ++active_workers_;
+            }
+            finish_tasks(execute_tasks(*task, num_tasks), true);
+        }
+    }
+};
+
+namespace detail {
+
+/* Number of threads to process num_elements elements under the given policy */
+inline size_t num_threads_for(const ExecutionPolicy& policy, size_t num_elements) {
+    if (policy.max_threads == 1 || in_parallel_region()) {
+        return 1;
+    }
+    size_t min_elements = std::max<size_t>(policy.min_elements_per_thread, 1);
+    size_t threads = num_elements / min_elements;
+    if (threads < 2) {
+        return 1;
+    }
+    /* work is split into max_threads chunks even if the pool is smaller, chunks are balanced between threads */
+    size_t max_threads = policy.max_threads == 0 ? ThreadPool::instance().size() : policy.max_threads;
+    return std::min(threads, max_threads);
+}
+
+/* Splits [0, num_items) into contiguous chunks and calls f(begin, end) for each chunk, possibly in parallel.
+ * Every item costs item_elements elements of work. */
+template<class F>
+void parallel_for(const ExecutionPolicy& policy, size_t num_items, size_t item_elements, F&& f) {
+    size_t threads = std::min(num_threads_for(policy, num_items * item_elements), num_items);
+    if (threads < 2) {
+        f(size_t(0), num_items);
+        return;
+    }
+    ThreadPool::instance().run(threads, [&](size_t i) {
+        f(num_items * i / threads, num_items * (i + 1) / threads);
+    });
+}
+
+} // detail
+
+} // namespace
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+
+#include "TensorView.h"
+
+namespace tensor_view {
+
+namespace detail {
+
+/* Broadcasted strides of views, in the order of arguments */
+template<size_t N, size_t K, class ...TTensorViews>
+void collect_view_strides(const size_t* shape, ptrdiff_t (&strides)[K][N], const TTensorViews& ... views) {
+    size_t k = 0;
+    int expand[] = {(collect_strides(views, shape, strides, k), 0)...};
+    (void) expand;
+}
+
+} // detail
+
+/* Result of the shape, broadcasting and layout analysis of an element-wise operation over K operands with fixed
+ * shapes and strides, operand 0 being the destination. A plan is built once with make_plan() and then executed
+ * any number of times on data with the same layout, without repeating the analysis:
+ *
+ *     auto plan = make_plan(dst, a, b);
+ *     for (...) plan.execute(std::plus<float>(), dst_data, a_data, b_data);
+ */
+template<size_t N, size_t K>
+class ElementWisePlan {
+public:
+    ElementWisePlan(const size_t* shape, const ptrdiff_t (&strides)[K][N]) :
+            layout_(detail::make_layout(shape, strides)) {
+        std::copy(shape, shape + N, shape_);
+        for (size_t k = 0; k < K; ++k) {
+            std::copy(strides[k], strides[k] + N, strides_[k]);
+        }
+    }
+
+    /* Whether operands with the given shape and broadcasted strides have the layout of the plan */
+    bool matches(const size_t* shape, const ptrdiff_t (&strides)[K][N]) const {
+        for (size_t i = 0; i < N; ++i) {
+            if (shape[i] != shape_[i]) {
+                return false;
+            }
+            for (size_t k = 0; k < K; ++k) {
+                if (strides[k][i] != strides_[k][i]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template<class TensorViewDst, class ...TensorViewsSrc>
+    bool matches(const TensorViewDst& dst, const TensorViewsSrc& ... src) const {
+        static_assert(sizeof...(TensorViewsSrc) + 1 == K, "Plan is built for a different number of operands");
+        ptrdiff_t strides[K][N];
+        detail::collect_view_strides(dst.shape(), strides, dst, src...);
+        return matches(dst.shape(), strides);
+    }
+
+    /* dst = f(src) on data laid out as the plan operands */
+    template<class F, class TSrc, class TDst>
+    void execute(F&& f, TDst* dst, const TSrc* src, const ExecutionPolicy& policy = get_execution_policy()) const {
+        static_assert(K == 2, "Plan is built for a different number of operands");
+        detail::for_each_row(layout_, policy, [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+            detail::transform_strided(f, src + offset[1], dst + offset[0], n, stride[1], stride[0]);
+        });
+    }
+
+    /* dst = f(lhs, rhs) on data laid out as the plan operands */
+    template<class F, class TLhs, class TRhs, class TDst>
+    void execute(F&& f, TDst* dst, const TLhs* lhs, const TRhs* rhs,
+                 const ExecutionPolicy& policy = get_execution_policy()) const {
+        static_assert(K == 3, "Plan is built for a different number of operands");
+        detail::for_each_row(layout_, policy, [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+            detail::transform_strided(f, lhs + offset[1], rhs + offset[2], dst + offset[0], n,
+                                      stride[1], stride[2], stride[0]);
+        });
+    }
+
+    template<class F, class TensorViewDst, class TensorViewSrc, enable_if_t<is_tensor_view_v<TensorViewSrc>, int> = 0>
+    void execute(F&& f, TensorViewDst& dst, const TensorViewSrc& src,
+                 const ExecutionPolicy& policy = get_execution_policy()) const {
+        TV_ASSERT_DEBUG(matches(dst, src), "Layout of operands differs from the plan")
+        execute(std::forward<F>(f), dst.data(), src.data(), policy);
+    }
+
+    template<class F, class TensorViewDst, class TensorViewLhs, class TensorViewRhs,
+             enable_if_t<is_tensor_view_v<TensorViewLhs> && is_tensor_view_v<TensorViewRhs>, int> = 0>
+    void execute(F&& f, TensorViewDst& dst, const TensorViewLhs& lhs, const TensorViewRhs& rhs,
+                 const ExecutionPolicy& policy = get_execution_policy()) const {
+        TV_ASSERT_DEBUG(matches(dst, lhs, rhs), "Layout of operands differs from the plan")
+        execute(std::forward<F>(f), dst.data(), lhs.data(), rhs.data(), policy);
+    }
+
+    /* dst = expr for an expression with views laid out as the plan operands */
+    template<class TExpression, class TensorViewDst, enable_if_t<is_expression_v<TExpression>, int> = 0>
+    void evaluate(const TExpression& expr, TensorViewDst& dst,
+                  const ExecutionPolicy& policy = get_execution_policy()) const {
+        static_assert(K == 1 + detail::num_views<TExpression>::value, "Plan is built for a different expression");
+        TV_ASSERT_DEBUG(std::equal(shape_, shape_ + N, dst.shape()), "Incorrect shape of destination tensor")
+        detail::evaluate(expr, dst.data(), layout_, policy);
+    }
+
+    /* Number of dimensions left after coalescing */
+    size_t num_dims() const {
+        return layout_.ndim;
+    }
+
+    size_t num_elements() const {
+        return layout_.num_elements();
+    }
+
+private:
+    detail::StridedLayout<N, K> layout_;
+    size_t shape_[N];
+    ptrdiff_t strides_[K][N];
+};
+
+/* Plan of dst = f(src...) for views with the shapes and strides of the arguments. Sources are broadcasted to the
+ * shape of the destination. Pass the destination also as a source for in-place operations (map_, +=). */
+template<class TensorViewDst, class ...TensorViewsSrc,
+         enable_if_t<is_tensor_view_v<TensorViewDst> && detail::all_tensor_views<TensorViewsSrc...>::value, int> = 0>
+ElementWisePlan<TensorViewDst::NumDims, 1 + sizeof...(TensorViewsSrc)>
+make_plan(const TensorViewDst& dst, const TensorViewsSrc& ... src) {
+    const size_t N = TensorViewDst::NumDims;
+    const size_t K = 1 + sizeof...(TensorViewsSrc);
+    bool compatible[] = {true, (TensorViewsSrc::NumDims <= N && check_shapes(dst, src))...};
+    TV_ASSERT(std::all_of(compatible, compatible + K, [](bool b) { return b; }),
+              "Shapes of input tensors are not compatible")
+    ptrdiff_t strides[K][N];
+    detail::collect_view_strides(dst.shape(), strides, dst, src...);
+    return {dst.shape(), strides};
+}
+
+/* Plan of dst = expr, executed with ElementWisePlan::evaluate() for expressions of the same structure and layout */
+template<class TensorViewDst, class TExpression,
+         enable_if_t<is_tensor_view_v<TensorViewDst> && is_expression_v<TExpression>, int> = 0>
+ElementWisePlan<TensorViewDst::NumDims, 1 + detail::num_views<TExpression>::value>
+make_plan(const TensorViewDst& dst, const TExpression& expr) {
+    const size_t N = TensorViewDst::NumDims;
+    const size_t K = 1 + detail::num_views<TExpression>::value;
+    static_assert(TExpression::NumDims == N, "Incorrect number of dims of dst tensor");
+    TV_ASSERT(detail::check_shapes(dst, expr, implicit_broadcast{}), "Incorrect shape of destination tensor")
+    ptrdiff_t strides[K][N];
+    detail::broadcast_strides<N>(dst, dst.shape(), strides[0]);
+    size_t k = 1;
+    detail::collect_strides(expr, dst.shape(), strides, k);
+    return {dst.shape(), strides};
+}
+
+} // namespace tensor_view
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#include "Kernels.h"
+#include "MatMul.h"
+#include "Tensor.h"
+#include "TensorView.h"
+#include "Workspace.h"
+
+/* Affine quantization of tensors: real = scale * (q - zero_point), q is int8_t or uint8_t.
+ *
+ * A QuantizedView is a strided view of quantized values together with their scale and zero point, which are the same
+ * for the whole tensor or are given for every index along one axis (e.g. output channels of weights). Element-wise
+ * operations broadcast their operands as views do; they work in chunks small enough to stay in L1, so quantized data
+ * is never inflated to a float tensor. Matrix products of quantized operands accumulate in int32. */
+
+namespace tensor_view {
+
+/* Parameters of affine quantization. Per-axis scales and zero points are arrays (not owned) of the size of the view
+ * along the axis; zero_points may be null, then all zero points are zero_point. */
+struct QuantizationParams {
+    float scale = 1.f;
+    int32_t zero_point = 0;
+    int axis = -1; // -1 - per-tensor parameters
+    const float* scales = nullptr;
+    const int32_t* zero_points = nullptr;
+
+    bool per_axis() const {
+        return axis >= 0;
+    }
+
+    const float* scale_data() const {
+        return per_axis() ? scales : &scale;
+    }
+
+    const int32_t* zero_point_data() const {
+        return per_axis() && zero_points ? zero_points : &zero_point;
+    }
+};
+
+template<class T>
+struct is_quantized_type : std::integral_constant<bool, std::is_same<std::remove_const_t<T>, int8_t>::value ||
+                                                        std::is_same<std::remove_const_t<T>, uint8_t>::value> {
+};
+
+/* View of quantized values with quantization parameters */
+template<class T, size_t ndim>
+class QuantizedView {
+public:
+    using ValueType = T;
+    using ShapeType = const size_t*;
+    static constexpr size_t NumDims = ndim;
+
+    QuantizedView(const TensorView<T, ndim>& view, float scale, int32_t zero_point) : view_(view) {
+        params_.scale = scale;
+        params_.zero_point = zero_point;
+        check_zero_point(zero_point);
+    }
+
+    /* Per-axis parameters: scales[i] and zero_points[i] (zero if null) are used for view elements with index i
+     * along the axis */
+    QuantizedView(const TensorView<T, ndim>& view, const float* scales, const int32_t* zero_points, size_t axis) :
+            view_(view) {
+        TV_ASSERT(axis < ndim, "Quantization axis is out of range")
+        TV_ASSERT(scales != nullptr, "Per-axis quantization needs scales")
+        params_.axis = static_cast<int>(axis);
+        params_.scales = scales;
+        params_.zero_points = zero_points;
+        if (zero_points) {
+            for (size_t i = 0; i < view.size(axis); ++i) {
+                check_zero_point(zero_points[i]);
+            }
+        }
+    }
+
+    TensorView<T, ndim> view() const {
+        return view_;
+    }
+
+    T* data() const {
+        return view().data();
+    }
+
+    ShapeType shape() const {
+        return view_.shape();
+    }
+
+    ShapeType stride() const {
+        return view_.stride();
+    }
+
+    size_t size(size_t dim) const {
+        return view_.size(dim);
+    }
+
+    size_t num_elements() const {
+        return view_.num_elements();
+    }
+
+    const QuantizationParams& params() const {
+        return params_;
+    }
+
+    /* Scale of the element with index i along the quantization axis (any i for per-tensor parameters) */
+    float scale(size_t i = 0) const {
+        return params_.scale_data()[params_.per_axis() ? i : 0];
+    }
+
+    int32_t zero_point(size_t i = 0) const {
+        return params_.zero_point_data()[params_.per_axis() && params_.zero_points ? i : 0];
+    }
+
+    /* Zero point common to all elements, per-axis zero points have to be equal */
+    int32_t uniform_zero_point() const {
+        if (params_.per_axis() && params_.zero_points) {
+            for (size_t i = 1; i < view_.size(static_cast<size_t>(params_.axis)); ++i) {
+                TV_ASSERT(params_.zero_points[i] == params_.zero_points[0], "Zero points differ along the axis")
+            }
+        }
+        return zero_point();
+    }
+
+private:
+    void check_zero_point(int32_t zero_point) const {
+        using TValue = std::remove_const_t<T>;
+        TV_ASSERT(zero_point >= std::numeric_limits<TValue>::min() && zero_point <= std::numeric_limits<TValue>::max(),
+                  "Zero point is out of range of quantized type")
+    }
+
+    TensorView<T, ndim> view_;
+    QuantizationParams params_;
+};
+
+template<class T, size_t ndim>
+QuantizedView<T, ndim> make_quantized(const TensorView<T, ndim>& view, float scale, int32_t zero_point) {
+    return {view, scale, zero_point};
+}
+
+template<class T, size_t ndim>
+QuantizedView<T, ndim> make_quantized(const TensorView<T, ndim>& view, const float* scales,
+                                      const int32_t* zero_points, size_t axis) {
+    return {view, scales, zero_points, axis};
+}
+
+namespace detail {
+
+/* Elements of a row processed at once, buffers of the chunk stay in L1 */
+const size_t quantized_chunk = 1024;
+
+/* Strides of a quantized view broadcasted to the N-dimensional shape: data of operand k, its scales (k + 1) and zero
+ * points (k + 2). Per-axis parameters have stride 1 along the axis, all other parameter strides are 0. */
+template<size_t N, size_t K, class T, size_t ndim>
+void quantized_strides(const QuantizedView<T, ndim>& view, const size_t* shape, ptrdiff_t (&strides)[K][N], size_t k) {
+    broadcast_strides<N>(view.view(), shape, strides[k]);
+    const QuantizationParams& params = view.params();
+    const size_t offset = N - ndim;
+    for (size_t i = 0; i < N; ++i) {
+        const bool along_axis = params.per_axis() && i == offset + static_cast<size_t>(params.axis) &&
+                                view.size(static_cast<size_t>(params.axis)) != 1;
+        strides[k + 1][i] = along_axis ? 1 : 0;
+        strides[k + 2][i] = along_axis && params.zero_points ? 1 : 0;
+    }
+}
+
+/* Row of a quantized operand with its parameters, parameter strides are 0 or 1 */
+template<class T>
+struct QuantizedRow {
+    T* data;
+    ptrdiff_t stride;
+    const float* scale;
+    ptrdiff_t scale_stride;
+    const int32_t* zero_point;
+    ptrdiff_t zero_point_stride;
+
+    QuantizedRow advance(size_t i) const {
+        const ptrdiff_t j = static_cast<ptrdiff_t>(i);
+        return {data + j * stride, stride, scale + j * scale_stride, scale_stride,
+                zero_point + j * zero_point_stride, zero_point_stride};
+    }
+};
+
+/* Row of operand k (see quantized_strides) starting at the given offsets */
+template<class T, size_t ndim>
+QuantizedRow<T> quantized_row(const QuantizedView<T, ndim>& view, const ptrdiff_t* offset, const ptrdiff_t* stride,
+                              size_t k) {
+    const QuantizationParams& params = view.params();
+    return {view.data() + offset[k], stride[k], params.scale_data() + offset[k + 1], stride[k + 1],
+            params.zero_point_data() + offset[k + 2], stride[k + 2]};
+}
+
+/* x[i] = dequantized row[i], n <= quantized_chunk */
+template<class T>
+void dequantize_chunk(const QuantizedRow<T>& row, float* x, size_t n) {
+    using TValue = std::remove_const_t<T>;
+    TValue buffer[quantized_chunk];
+    const TValue* q = row.data;
+    if (row.stride != 1) {
+        copy_strided(row.data, buffer, n, row.stride, 1);
+        q = buffer;
+    }
+    simd::QuantizeKernel<TValue>::dequantize(q, row.scale, row.scale_stride != 0, row.zero_point,
+                                             row.zero_point_stride != 0, x, n);
+}
+
+/* row[i] = quantized x[i], n <= quantized_chunk */
+template<class T>
+void quantize_chunk(const float* x, const QuantizedRow<T>& row, size_t n) {
+    T buffer[quantized_chunk];
+    T* q = row.stride == 1 ? row.data : buffer;
+    /* kernels multiply by the inverse scale, which is much faster than division */
+    float inverse_scale[quantized_chunk];
+    const size_t scales = row.scale_stride != 0 ? n : 1;
+    for (size_t i = 0; i < scales; ++i) {
+        inverse_scale[i] = 1.f / row.scale[i];
+    }
+    simd::QuantizeKernel<T>::quantize(x, inverse_scale, row.scale_stride != 0, row.zero_point,
+                                      row.zero_point_stride != 0, q, n);
+    if (row.stride != 1) {
+        copy_strided(buffer, row.data, n, 1, row.stride);
+    }
+}
+
+/* Calls f(begin, length) for chunks of a row of n elements */
+template<class F>
+void for_each_chunk(size_t n, F&& f) {
+    for (size_t i = 0; i < n; i += quantized_chunk) {
+        f(i, std::min(quantized_chunk, n - i));
+    }
+}
+
+/* dst = quantize(f(dequantize(a), dequantize(b))), f is applied to float chunks */
+template<class F, class TA, size_t NA, class TB, size_t NB, class TDst, size_t N>
+void quantized_binary(const F& f, const QuantizedView<TA, NA>& a, const QuantizedView<TB, NB>& b,
+                      const QuantizedView<TDst, N>& dst, const ExecutionPolicy& policy) {
+    static_assert(N >= NA && N >= NB, "Destination ndim must be greater or equal than source one");
+    static_assert(is_quantized_type<TA>::value && is_quantized_type<TB>::value &&
+                  is_quantized_type<TDst>::value, "Operands have to be int8 or uint8");
+    TV_ASSERT(check_shapes(dst.view(), a.view()) && check_shapes(dst.view(), b.view()),
+              "Shapes of input tensors are not compatible")
+    ptrdiff_t strides[9][N];
+    quantized_strides(dst, dst.shape(), strides, 0);
+    quantized_strides(a, dst.shape(), strides, 3);
+    quantized_strides(b, dst.shape(), strides, 6);
+    for_each_row(make_layout(dst.shape(), strides), policy,
+                 [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+        const QuantizedRow<TDst> dst_row = quantized_row(dst, offset, stride, 0);
+        const QuantizedRow<TA> a_row = quantized_row(a, offset, stride, 3);
+        const QuantizedRow<TB> b_row = quantized_row(b, offset, stride, 6);
+        for_each_chunk(n, [&](size_t begin, size_t length) {
+            float x[quantized_chunk];
+            float y[quantized_chunk];
+            dequantize_chunk(a_row.advance(begin), x, length);
+            dequantize_chunk(b_row.advance(begin), y, length);
+            transform(f, x, y, x, length);
+            quantize_chunk(x, dst_row.advance(begin), length);
+        });
+    });
+}
+
+} // detail
+
+/* dst = round(src * (1 / scale)) + zero_point, clamped to the range of the quantized type; NaN becomes the minimum.
+ * src is a float view broadcasted to the shape of dst. */
+template<class TTensorViewSrc, class T, size_t N>
+void quantize(const TTensorViewSrc& src, const QuantizedView<T, N>& dst,
+              const ExecutionPolicy& policy = get_execution_policy()) {
+    static_assert(std::is_same<std::remove_const_t<typename TTensorViewSrc::ValueType>, float>::value,
+                  "Quantized values are computed from float tensors");
+    static_assert(is_quantized_type<T>::value, "Quantized type has to be int8 or uint8");
+    static_assert(N >= TTensorViewSrc::NumDims, "Destination ndim must be greater or equal than source one");
+    TV_ASSERT(check_shapes(dst.view(), src), "Shapes of input tensors are not compatible")
+    TV_TRACE_SCOPE("quantize", dst, sizeof(float) + sizeof(T))
+    ptrdiff_t strides[4][N];
+    detail::quantized_strides(dst, dst.shape(), strides, 0);
+    detail::broadcast_strides<N>(src, dst.shape(), strides[3]);
+    const float* src_data = src.data();
+    detail::for_each_row(detail::make_layout(dst.shape(), strides), policy,
+                         [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+        const detail::QuantizedRow<T> row = detail::quantized_row(dst, offset, stride, 0);
+        const float* x = src_data + offset[3];
+        detail::for_each_chunk(n, [&](size_t begin, size_t length) {
+            float buffer[detail::quantized_chunk];
+            const float* chunk = x + static_cast<ptrdiff_t>(begin) * stride[3];
+            if (stride[3] != 1) {
+                detail::copy_strided(chunk, buffer, length, stride[3], 1);
+                chunk = buffer;
+            }
+            detail::quantize_chunk(chunk, row.advance(begin), length);
+        });
+    });
+}
+
+/* dst = (src - zero_point) * scale, src is broadcasted to the shape of dst. src may also be a view of int32 values,
+ * e.g. matrix product accumulators. */
+template<class T, size_t NSrc, class TTensorViewDst, std::enable_if_t<is_tensor_view_v<TTensorViewDst>, int> = 0>
+void dequantize(const QuantizedView<T, NSrc>& src, TTensorViewDst& dst,
+                const ExecutionPolicy& policy = get_execution_policy()) {
+    const size_t N = TTensorViewDst::NumDims;
+    static_assert(std::is_same<typename TTensorViewDst::ValueType, float>::value,
+                  "Quantized values are converted to float tensors");
+    static_assert(N >= NSrc, "Destination ndim must be greater or equal than source one");
+    TV_ASSERT(check_shapes(dst, src.view()), "Shapes of input tensors are not compatible")
+    TV_TRACE_SCOPE("dequantize", dst, sizeof(float) + sizeof(T))
+    ptrdiff_t strides[4][N];
+    detail::broadcast_strides<N>(dst, dst.shape(), strides[0]);
+    detail::quantized_strides(src, dst.shape(), strides, 1);
+    float* dst_data = dst.data();
+    detail::for_each_row(detail::make_layout(dst.shape(), strides), policy,
+                         [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+        const detail::QuantizedRow<T> row = detail::quantized_row(src, offset, stride, 1);
+        float* x = dst_data + offset[0];
+        detail::for_each_chunk(n, [&](size_t begin, size_t length) {
+            float* chunk = x + static_cast<ptrdiff_t>(begin) * stride[0];
+            if (stride[0] == 1) {
+                detail::dequantize_chunk(row.advance(begin), chunk, length);
+                return;
+            }
+            float buffer[detail::quantized_chunk];
+            detail::dequantize_chunk(row.advance(begin), buffer, length);
+            detail::copy_strided(buffer, chunk, length, 1, stride[0]);
+        });
+    });
+}
+
+/* Dequantized copy of src, see dequantize(src, dst) */
+template<class T, size_t N>
+Tensor<float, N> dequantize(const QuantizedView<T, N>& src, const ExecutionPolicy& policy = get_execution_policy()) {
+    Tensor<float, N> result(uninitialized, src.shape());
+    dequantize(src, result, policy);
+    return result;
+}
+
+/* dst = src converted to the quantization parameters of dst, src is broadcasted to the shape of dst. src may be a view
+ * of int32 values (matrix product accumulators). */
+template<class TSrc, size_t NSrc, class TDst, size_t N>
+void requantize(const QuantizedView<TSrc, NSrc>& src, const QuantizedView<TDst, N>& dst,
+                const ExecutionPolicy& policy = get_execution_policy()) {
+    static_assert(N >= NSrc, "Destination ndim must be greater or equal than source one");
+    static_assert(is_quantized_type<TDst>::value, "Quantized type has to be int8 or uint8");
+    TV_ASSERT(check_shapes(dst.view(), src.view()), "Shapes of input tensors are not compatible")
+    TV_TRACE_SCOPE("requantize", dst, sizeof(TSrc) + sizeof(TDst))
+    ptrdiff_t strides[6][N];
+    detail::quantized_strides(dst, dst.shape(), strides, 0);
+    detail::quantized_strides(src, dst.shape(), strides, 3);
+    detail::for_each_row(detail::make_layout(dst.shape(), strides), policy,
+                         [&](const ptrdiff_t* offset, const ptrdiff_t* stride, size_t n) {
+        const detail::QuantizedRow<TDst> dst_row = detail::quantized_row(dst, offset, stride, 0);
+        const detail::QuantizedRow<TSrc> src_row = detail::quantized_row(src, offset, stride, 3);
+        detail::for_each_chunk(n, [&](size_t begin, size_t length) {
+            float x[detail::quantized_chunk];
+            detail::dequantize_chunk(src_row.advance(begin), x, length);
+            detail::quantize_chunk(x, dst_row.advance(begin), length);
+        });
+    });
+}
+
+/* dst = a + b of quantized views with broadcasting, the sum is rounded to the parameters of dst */
+template<class TA, size_t NA, class TB, size_t NB, class TDst, size_t N>
+void add(const QuantizedView<TA, NA>& a, const QuantizedView<TB, NB>& b, const QuantizedView<TDst, N>& dst,
+         const ExecutionPolicy& policy = get_execution_policy()) {
+    TV_TRACE_SCOPE("quantized_add", dst, sizeof(TA) + sizeof(TB) + sizeof(TDst))
+    detail::quantized_binary(std::plus<float>(), a, b, dst, policy);
+}
+
+/* dst = a * b of quantized views with broadcasting, the product is rounded to the parameters of dst */
+template<class TA, size_t NA, class TB, size_t NB, class TDst, size_t N>
+void mul(const QuantizedView<TA, NA>& a, const QuantizedView<TB, NB>& b, const QuantizedView<TDst, N>& dst,
+         const ExecutionPolicy& policy = get_execution_policy()) {
+    TV_TRACE_SCOPE("quantized_mul", dst, sizeof(TA) + sizeof(TB) + sizeof(TDst))
+    detail::quantized_binary(std::multiplies<float>(), a, b, dst, policy);
+}
+
+/* Dot product sum (a[i] - a_zero) * (b[i] - b_zero) of 1-D quantized views with per-tensor zero points, the result
+ * is scaled by a.scale() * b.scale(). The sum is exact while it fits in int32, longer sums wrap modulo 2^32: a term
+ * is at most 128 * 128 for int8 with zero points 0, so fewer than 2^17 elements never overflow, and up to
+ * 255 * 255 for uint8 (or offset zero points), so the bound is 33025 (about 2^15) elements. */
+template<class TA, class TB>
+int32_t dot(const QuantizedView<TA, 1>& a, const QuantizedView<TB, 1>& b) {
+    using TValueA = std::remove_const_t<TA>;
+    using TValueB = std::remove_const_t<TB>;
+    static_assert(is_quantized_type<TA>::value && is_quantized_type<TB>::value, "Operands have to be int8 or uint8");
+    TV_ASSERT(a.size(0) == b.size(0), "Dot product needs views of the same size")
+    const int32_t a_zero = a.uniform_zero_point();
+    const int32_t b_zero = b.uniform_zero_point();
+    const ptrdiff_t a_stride = static_cast<ptrdiff_t>(a.stride()[0]);
+    const ptrdiff_t b_stride = static_cast<ptrdiff_t>(b.stride()[0]);
+    const size_t n = a.size(0);
+    uint32_t result = 0;
+    detail::for_each_chunk(n, [&](size_t begin, size_t length) {
+        TValueA a_buffer[detail::quantized_chunk];
+        TValueB b_buffer[detail::quantized_chunk];
+        const TValueA* x = a.data() + static_cast<ptrdiff_t>(begin) * a_stride;
+        const TValueB* y = b.data() + static_cast<ptrdiff_t>(begin) * b_stride;
+        if (a_stride != 1) {
+            detail::copy_strided(x, a_buffer, length, a_stride, 1);
+            x = a_buffer;
+        }
+        if (b_stride != 1) {
+            detail::copy_strided(y, b_buffer, length, b_stride, 1);
+            y = b_buffer;
+        }
+        result += static_cast<uint32_t>(simd::DotKernel<TValueA, TValueB>::run(x, y, a_zero, b_zero, length));
+    });
+    return static_cast<int32_t>(result);
+}
+
+/* Matrix product of quantized 2-D views or batches, see matmul(a, b, dst) for floating point views. dst receives
+ * int32 accumulators sum (a - a_zero) * (b - b_zero), which have scale a.scale() * b.scale() and zero point 0.
+ * Zero points of an operand have to be the same for all its elements. */
+template<class TA, size_t NA, class TB, size_t NB, class TTensorViewDst,
+         std::enable_if_t<is_tensor_view_v<TTensorViewDst>, int> = 0>
+void matmul(const QuantizedView<TA, NA>& a, const QuantizedView<TB, NB>& b, TTensorViewDst& dst,
+            const ExecutionPolicy& policy = get_execution_policy()) {
+    static_assert(is_quantized_type<TA>::value && is_quantized_type<TB>::value, "Operands have to be int8 or uint8");
+    static_assert(std::is_same<typename TTensorViewDst::ValueType, int32_t>::value,
+                  "Product of quantized matrices is accumulated in int32");
+    static_assert(TTensorViewDst::NumDims == (NA == 3 || NB == 3 ? 3 : 2),
+                  "Incorrect number of dims of destination tensor");
+    TensorView<TA, NA> a_view = a.view();
+    TensorView<TB, NB> b_view = b.view();
+    detail::matmul_impl<int32_t>(detail::as_const(detail::matrix_batch(a_view)),
+                                 detail::as_const(detail::matrix_batch(b_view)), detail::matrix_batch(dst), policy,
+                                 a.uniform_zero_point(), b.uniform_zero_point());
+}
+
+/* Matrix product of quantized views rounded to the parameters of dst. a has per-tensor scale, b may have per-axis
+ * scales along its last dimension (columns, e.g. output channels of weights). */
+template<class TA, size_t NA, class TB, size_t NB, class TDst, size_t N>
+void matmul(const QuantizedView<TA, NA>& a, const QuantizedView<TB, NB>& b, const QuantizedView<TDst, N>& dst,
+            const ExecutionPolicy& policy = get_execution_policy()) {
+    TV_ASSERT(!a.params().per_axis(), "Product needs per-tensor parameters of the left operand")
+    TV_ASSERT(!b.params().per_axis() || b.params().axis == static_cast<int>(NB - 1),
+              "Product needs per-tensor parameters or per-column scales of the right operand")
+    Workspace& workspace = Workspace::local();
+    WorkspaceScope scope(workspace);
+    WorkspaceTensor<int32_t, N> accumulators(uninitialized, dst.shape());
+    matmul(a, b, accumulators, policy);
+
+    if (!b.params().per_axis()) {
+        requantize(make_quantized(accumulators, a.scale() * b.scale(), 0), dst, policy);
+        return;
+    }
+    const size_t n = b.size(NB - 1);
+    float* scales = static_cast<float*>(workspace.allocate(n * sizeof(float)));
+    for (size_t j = 0; j < n; ++j) {
+        scales[j] = a.scale() * b.scale(j);
+    }
+    requantize(make_quantized(accumulators, scales, nullptr, N - 1), dst, policy);
+}
+
+} // namespace tensor_view
@@ -0,0 +1,467 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+#include "Kernels.h"
+#include "Layout.h"
+#include "Parallel.h"
+
+namespace tensor_view {
+
+/* Functors for which reduce() may regroup operations, i.e. evaluate f(f(a, b), f(c, d)) instead of
+ * f(f(f(a, b), c), d). Such reductions are vectorized, run in parallel and use pairwise combination.
+ * Specialize for user functors to enable the same for them. */
+template<class F, class T>
+struct is_associative : std::false_type {
+};
+
+template<class T>
+struct is_associative<std::plus<T>, T> : std::true_type {
+};
+
+template<class T>
+struct is_associative<std::multiplies<T>, T> : std::true_type {
+};
+
+template<class T>
+struct is_associative<minimum<T>, T> : std::true_type {
+};
+
+template<class T>
+struct is_associative<maximum<T>, T> : std::true_type {
+};
+
+namespace detail {
+
+/* Functor combining accumulated values. Built-in functors of half-precision types are rebound to the accumulator
+ * type (std::plus<float16> becomes std::plus<float>), other functors are called with accumulated values as is. */
+template<class F, class TAcc, bool Rebind>
+struct accumulator_op_impl {
+    using type = F;
+
+    static const F& make(const F& f) {
+        return f;
+    }
+};
+
+template<template<class> class Op, class T, class TAcc>
+struct accumulator_op_impl<Op<T>, TAcc, true> {
+    using type = Op<TAcc>;
+
+    static type make(const Op<T>&) {
+        return {};
+    }
+};
+
+template<class F, class T>
+using accumulator_op = accumulator_op_impl<F, accumulator_t<T>, !std::is_same<T, accumulator_t<T>>::value &&
+                                                                simd::op_code<F, T>::value != simd::OpCode::none>;
+
+/* Tensor view as a sequence of rows of equal length: dimensions are coalesced, the last one (contiguous or
+ * strided) becomes the row, the rest enumerate rows. Logical element i is located in row i / row_length. */
+template<class T, size_t N>
+class Rows {
+public:
+    template<class TTensorView>
+    explicit Rows(const TTensorView& view) :
+            data_(view.data()) {
+        ptrdiff_t strides[1][N];
+        for (size_t i = 0; i < N; ++i) {
+            strides[0][i] = static_cast<ptrdiff_t>(view.stride()[i]);
+        }
+        layout_ = make_layout(view.shape(), strides);
+
+        row_length_ = 1;
+        row_stride_ = 1;
+        if (layout_.ndim > 0) {
+            --layout_.ndim;
+            row_length_ = layout_.shape[layout_.ndim];
+            row_stride_ = layout_.stride[0][layout_.ndim];
+        }
+        num_rows_ = layout_.num_elements();
+    }
+
+    const T* row(size_t r) const {
+        ptrdiff_t offset = 0;
+        for (size_t i = layout_.ndim; i-- > 0;) {
+            offset += static_cast<ptrdiff_t>(r % layout_.shape[i]) * layout_.stride[0][i];
+            r /= layout_.shape[i];
+        }
+        return data_ + offset;
+    }
+
+    size_t num_rows() const {
+        return num_rows_;
+    }
+
+    size_t row_length() const {
+        return row_length_;
+    }
+
+    ptrdiff_t row_stride() const {
+        return row_stride_;
+    }
+
+    size_t num_elements() const {
+        return num_rows_ * row_length_;
+    }
+
+private:
+    const T* data_;
+    /* dimensions enumerating rows */
+    StridedLayout<N, 1> layout_;
+    size_t num_rows_;
+    size_t row_length_;
+    ptrdiff_t row_stride_;
+};
+
+/* Reduction of n > 0 elements starting at data with the given stride, f is applied to accumulated values */
+template<class F, class T>
+accumulator_t<T> reduce_segment(const F& f, const T* data, size_t n, ptrdiff_t stride, std::false_type is_simd) {
+    accumulator_t<T> result = data[0];
+    for (size_t i = 1; i < n; ++i) {
+        result = f(result, data[static_cast<ptrdiff_t>(i) * stride]);
+    }
+    return result;
+}
+
+template<class F, class T>
+T reduce_contiguous(const F& f, const T* data, size_t n) {
+    return simd::ReduceKernel<simd::op_code<F, T>::value, T>::run(data, n);
+}
+
+/* Half-precision values are converted to float in chunks, which are reduced by the float kernel */
+template<class F, class T>
+float reduce_half_contiguous(const F& f, const T* data, size_t n) {
+    const size_t chunk_length = 1024;
+    float chunk[chunk_length];
+    float result = 0;
+    for (size_t offset = 0; offset < n; offset += chunk_length) {
+        size_t count = std::min(chunk_length, n - offset);
+        convert(data + offset, chunk, count);
+        float chunk_result = simd::ReduceKernel<simd::op_code<F, float>::value, float>::run(chunk, count);
+        result = offset == 0 ? chunk_result : f(result, chunk_result);
+    }
+    return result;
+}
+
+template<class F>
+float reduce_contiguous(const F& f, const float16* data, size_t n) {
+    return reduce_half_contiguous(f, data, n);
+}
+
+template<class F>
+float reduce_contiguous(const F& f, const bfloat16* data, size_t n) {
+    return reduce_half_contiguous(f, data, n);
+}
+
+template<class F, class T>
+accumulator_t<T> reduce_segment(const F& f, const T* data, size_t n, ptrdiff_t stride, std::true_type is_simd) {
+    if (stride == 1) {
+        return reduce_contiguous(f, data, n);
+    }
+    return reduce_segment(f, data, n, stride, std::false_type{});
+}
+
+/* Pairwise (tree) reduction of associative functor over logical elements of a view, f is applied to values
+ * accumulated in accumulator_t<T>. The tree shape depends only on the number of elements, so results are
+ * reproducible for any number of threads. */
+template<class F, class T, size_t N>
+class TreeReduce {
+public:
+    using Acc = accumulator_t<T>;
+
+    /* ranges not larger than this are reduced sequentially with vectorized kernel */
+    static constexpr size_t LeafElements = 4096;
+    /* number of elements of top-level subtrees, which are reduced in parallel */
+    static constexpr size_t MinTaskElements = 1 << 14;
+    static constexpr size_t MaxTasksLog2 = 8;
+
+    TreeReduce(const F& f, const Rows<T, N>& rows) : f_(f), rows_(rows) {}
+
+    /* n > 0 */
+    Acc run(const ExecutionPolicy& policy) const {
+        size_t n = rows_.num_elements();
+        size_t depth = 0;
+        while (depth < MaxTasksLog2 && (n >> (depth + 1)) >= MinTaskElements) {
+            ++depth;
+        }
+        size_t num_tasks = size_t(1) << depth;
+        if (num_tasks == 1) {
+            return reduce(0, n);
+        }
+
+        std::vector<size_t> bounds;
+        bounds.reserve(num_tasks + 1);
+        collect_bounds(0, n, depth, bounds);
+        bounds.push_back(n);
+
+        std::vector<Acc> partial(num_tasks);
+        parallel_for(policy, num_tasks, n / num_tasks, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                partial[i] = reduce(bounds[i], bounds[i + 1]);
+            }
+        });
+
+        for (size_t step = 1; step < num_tasks; step *= 2) {
+            for (size_t i = 0; i + step < num_tasks; i += 2 * step) {
+                partial[i] = f_(partial[i], partial[i + step]);
+            }
+        }
+        return partial[0];
+    }
+
+private:
+    const F& f_;
+    const Rows<T, N>& rows_;
+
+    using is_simd = std::integral_constant<bool, simd::is_simd_reduce_op<F, Acc>::value>;
+
+    static size_t split(size_t begin, size_t end) {
+        size_t half = (end - begin) / 2;
+        /* keep vectorized loops aligned to the full vector width */
+        return begin + (half > 64 ? half / 64 * 64 : half);
+    }
+
+    void collect_bounds(size_t begin, size_t end, size_t depth, std::vector<size_t>& bounds) const {
+        if (depth == 0) {
+            bounds.push_back(begin);
+            return;
+        }
+        size_t mid = split(begin, end);
+        collect_bounds(begin, mid, depth - 1, bounds);
+        collect_bounds(mid, end, depth - 1, bounds);
+    }
+
+    Acc reduce(size_t begin, size_t end) const {
+        if (end - begin <= LeafElements) {
+            return reduce_leaf(begin, end);
+        }
+        size_t mid = split(begin, end);
+        return f_(reduce(begin, mid), reduce(mid, end));
+    }
+
+    Acc reduce_leaf(size_t begin, size_t end) const {
+        size_t row_length = rows_.row_length();
+        ptrdiff_t stride = rows_.row_stride();
+        size_t r = begin / row_length;
+        size_t offset = begin - r * row_length;
+        size_t count = std::min(end - begin, row_length - offset);
+
+        Acc result = reduce_segment(f_, rows_.row(r) + static_cast<ptrdiff_t>(offset) * stride, count, stride, is_simd{});
+        begin += count;
+        while (begin < end) {
+            ++r;
+            count = std::min(end - begin, row_length);
+            result = f_(result, reduce_segment(f_, rows_.row(r), count, stride, is_simd{}));
+            begin += count;
+        }
+        return result;
+    }
+};
+
+/* Left fold in the logical order of elements, for functors which are not known to be associative */
+template<class F, class T, size_t N, class TResult>
+TResult fold(const F& f, const Rows<T, N>& rows, TResult initial_value) {
+    TResult result = initial_value;
+    size_t row_length = rows.row_length();
+    ptrdiff_t stride = rows.row_stride();
+    for (size_t r = 0; r < rows.num_rows(); ++r) {
+        const T* row = rows.row(r);
+        if (stride == 1) {
+            result = std::accumulate(row, row + row_length, result, f);
+        } else {
+            for (size_t i = 0; i < row_length; ++i) {
+                result = f(result, row[static_cast<ptrdiff_t>(i) * stride]);
+            }
+        }
+    }
+    return result;
+}
+
+template<class F, class TTensorView, class TResult>
+TResult all_reduce(const F& f, const TTensorView& view, TResult initial_value, const ExecutionPolicy& policy,
+                   std::true_type is_associative) {
+    using T = std::remove_const_t<typename TTensorView::ValueType>;
+    using Op = accumulator_op<std::decay_t<F>, T>;
+    Rows<T, TTensorView::NumDims> rows(view);
+    if (rows.num_elements() == 0) {
+        return initial_value;
+    }
+    const auto& op = Op::make(f);
+    return static_cast<TResult>(op(initial_value,
+                                   TreeReduce<typename Op::type, T, TTensorView::NumDims>(op, rows).run(policy)));
+}
+
+template<class F, class TTensorView, class TResult>
+TResult all_reduce(const F& f, const TTensorView& view, TResult initial_value, const ExecutionPolicy& policy,
+                   std::false_type is_associative) {
+    using T = std::remove_const_t<typename TTensorView::ValueType>;
+    Rows<T, TTensorView::NumDims> rows(view);
+    return fold(f, rows, initial_value);
+}
+
+} // detail
+
+/* Reduces all elements of the view into a single value */
+template<class F, class TTensorView, class TResult>
+TResult all_reduce(const F& f, const TTensorView& view, TResult initial_value,
+                   const ExecutionPolicy& policy = get_execution_policy()) {
+    using T = std::remove_const_t<typename TTensorView::ValueType>;
+    using tree = std::integral_constant<bool, std::is_same<T, TResult>::value &&
+                                              is_associative<std::decay_t<F>, T>::value>;
+    return detail::all_reduce(f, view, initial_value, policy, tree{});
+}
+
+namespace detail {
+
+/* Pairwise reduction of n > 0 strided elements */
+template<class F, class T, class TIsSimd>
+accumulator_t<T> reduce_segment_pairwise(const F& f, const T* data, size_t n, ptrdiff_t stride, TIsSimd is_simd) {
+    const size_t leaf_elements = 4096;
+    if (n <= leaf_elements) {
+        return reduce_segment(f, data, n, stride, is_simd);
+    }
+    size_t half = n / 2 / 64 * 64;
+    return f(reduce_segment_pairwise(f, data, half, stride, is_simd),
+             reduce_segment_pairwise(f, data + static_cast<ptrdiff_t>(half) * stride, n - half, stride, is_simd));
+}
+
+template<class F, class TSrc, class TDst>
+TDst reduce_axis(const F& f, const TSrc* data, size_t n, ptrdiff_t stride, TDst initial_value,
+                 std::true_type is_associative) {
+    if (n == 0) {
+        return initial_value;
+    }
+    using Op = accumulator_op<F, TSrc>;
+    using is_simd = std::integral_constant<bool, simd::is_simd_reduce_op<typename Op::type, accumulator_t<TSrc>>::value>;
+    const auto& op = Op::make(f);
+    return static_cast<TDst>(op(initial_value, reduce_segment_pairwise(op, data, n, stride, is_simd{})));
+}
+
+template<class F, class TSrc, class TDst>
+TDst reduce_axis(const F& f, const TSrc* data, size_t n, ptrdiff_t stride, TDst initial_value,
+                 std::false_type is_associative) {
+    TDst result = initial_value;
+    for (size_t i = 0; i < n; ++i) {
+        result = f(result, data[static_cast<ptrdiff_t>(i) * stride]);
+    }
+    return result;
+}
+
+/* out[i] = f(...f(f(initial_value, in[i]), in[stride + i])..., in[(length - 1) * stride + i]), i < count */
+template<class F, class TSrc, class TDst>
+void reduce_rows(const F& f, const TSrc* in, TDst* out, size_t count, size_t length, ptrdiff_t stride,
+                 TDst initial_value, std::false_type accumulate_separately) {
+    std::fill(out, out + count, initial_value);
+    for (size_t r = 0; r < length; ++r) {
+        transform(f, out, in + static_cast<ptrdiff_t>(r) * stride, out, count);
+    }
+}
+
+/* Half-precision destination: rows are converted to the accumulator type and accumulated in a separate buffer */
+template<class F, class TSrc, class TDst>
+void reduce_rows(const F& f, const TSrc* in, TDst* out, size_t count, size_t length, ptrdiff_t stride,
+                 TDst initial_value, std::true_type accumulate_separately) {
+    using Op = accumulator_op<F, TDst>;
+    using Acc = accumulator_t<TDst>;
+    const size_t chunk_length = 512;
+    Acc acc[chunk_length];
+    Acc row[chunk_length];
+    const auto& op = Op::make(f);
+    for (size_t offset = 0; offset < count; offset += chunk_length) {
+        size_t n = std::min(chunk_length, count - offset);
+        std::fill(acc, acc + n, static_cast<Acc>(initial_value));
+        for (size_t r = 0; r < length; ++r) {
+            convert(in + static_cast<ptrdiff_t>(r) * stride + offset, row, n);
+            transform(op, acc, row, acc, n);
+        }
+        convert(acc, out + offset, n);
+    }
+}
+
+/* Reduction over a single axis.
+ *
+ * Destination elements are independent and processed in parallel. When the destination and the source
+ * have common contiguous inner rows (reduction over one of the outer axes), source rows are accumulated
+ * into blocks of destination row with vectorized element-wise kernel. Otherwise every destination element
+ * is reduced along the axis, with vectorized horizontal reduction if the axis is contiguous. */
+template<class F, class TTensorViewSrc, class TTensorViewDst>
+void axis_reduce(const F& f, const TTensorViewSrc& src, TTensorViewDst dst, size_t axis,
+                 typename TTensorViewDst::ValueType initial_value, const ExecutionPolicy& policy) {
+    using TSrc = std::remove_const_t<typename TTensorViewSrc::ValueType>;
+    using TDst = typename TTensorViewDst::ValueType;
+    const size_t N = TTensorViewSrc::NumDims - 1;
+    /* operand 0 - destination, operand 1 - source */
+    using Layout = StridedLayout<N, 2>;
+    /* number of destination row elements, which stay in cache while source rows are accumulated */
+    const size_t block_length = 2048;
+    const size_t min_row_length = 16;
+
+    TV_ASSERT(axis < TTensorViewSrc::NumDims, "Reduction axis is out of range")
+    Layout layout;
+    for (size_t i = 0, j = 0; i < TTensorViewSrc::NumDims; ++i) {
+        if (i == axis) {
+            continue;
+        }
+        TV_ASSERT(dst.size(j) == src.size(i), "Incorrect shape of destination tensor")
+        ptrdiff_t strides[] = {static_cast<ptrdiff_t>(dst.stride()[j]), static_cast<ptrdiff_t>(src.stride()[i])};
+        layout.append(src.size(i), strides);
+        ++j;
+    }
+    layout.coalesce();
+    if (layout.num_elements() == 0) {
+        return;
+    }
+
+    const size_t length = src.size(axis);
+    const ptrdiff_t axis_stride = src.stride()[axis];
+    const size_t ndim = layout.ndim;
+    TDst* dst_data = dst.data();
+    const TSrc* src_data = src.data();
+    using accumulate_separately = std::integral_constant<bool, !std::is_same<TDst, accumulator_t<TDst>>::value>;
+
+    if (ndim > 0 && layout.stride[0][ndim - 1] == 1 && layout.stride[1][ndim - 1] == 1 &&
+        axis_stride != 1 && layout.shape[ndim - 1] >= min_row_length) {
+        const size_t row_length = layout.shape[ndim - 1];
+        const size_t num_blocks = (row_length + block_length - 1) / block_length;
+        const size_t num_rows = layout.num_elements(ndim - 1);
+
+        parallel_for(policy, num_rows * num_blocks, std::min(row_length, block_length) * length,
+                     [&](size_t begin, size_t end) {
+            StridedCursor<N, 2> cursor(layout, ndim - 1, begin / num_blocks);
+            size_t block = begin % num_blocks;
+            for (size_t item = begin; item < end; ++item) {
+                size_t offset = block * block_length;
+                size_t count = std::min(block_length, row_length - offset);
+                reduce_rows(f, src_data + cursor.offset(1) + offset, dst_data + cursor.offset(0) + offset, count,
+                            length, axis_stride, initial_value, accumulate_separately{});
+                if (++block == num_blocks) {
+                    block = 0;
+                    cursor.next();
+                }
+            }
+        });
+        return;
+    }
+
+    using is_tree = std::integral_constant<bool, std::is_same<TSrc, TDst>::value &&
+                                                 is_associative<std::decay_t<F>, TSrc>::value>;
+    parallel_for(policy, layout.num_elements(), length, [&](size_t begin, size_t end) {
+        StridedCursor<N, 2> cursor(layout, ndim, begin);
+        for (size_t i = begin; i < end; ++i) {
+            dst_data[cursor.offset(0)] = reduce_axis(f, src_data + cursor.offset(1), length, axis_stride,
+                                                     initial_value, is_tree{});
+            cursor.next();
+        }
+    });
+}
+
+} // detail
+
+} // namespace
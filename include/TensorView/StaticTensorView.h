@@ -0,0 +1,187 @@
+#pragma once
+
+#include <iostream>
+#include <type_traits>
+
+#include "Dims.h"
+#include "TensorView.h"
+
+namespace tensor_view {
+
+/* View of a contiguous row-major tensor whose shape is known at compile time, e.g.
+ *
+ *     StaticTensorView<float, Extents<80, 4>> boxes(data);
+ *     float width = boxes(i, 2) - boxes(i, 0);
+ *
+ * The view stores only the data pointer: shape and strides are constants of the type, so that element offsets are
+ * constant expressions and loops over the extents can be unrolled and vectorized by the compiler. The view converts
+ * to a TensorView of the same shape and is accepted by all operations on views. */
+template<class T, size_t... Dims>
+class StaticTensorView<T, Extents<Dims...>> {
+public:
+    using Type = StaticTensorView<T, Extents<Dims...>>;
+    using ExtentsType = Extents<Dims...>;
+    using ValueType = T;
+    using ShapeType = const size_t*;
+    using BroadcastPolicyTag = implicit_broadcast;
+    using DynamicType = TensorView<T, sizeof...(Dims)>;
+    static constexpr size_t NumDims = sizeof...(Dims);
+
+    constexpr StaticTensorView() : data_ptr_(nullptr) {}
+
+    constexpr explicit StaticTensorView(T* data_ptr) : data_ptr_(data_ptr) {}
+
+    template<class TDeferredOperation, enable_if_t<is_operation_v<TDeferredOperation>, int> = 0>
+    Type& operator=(const TDeferredOperation& op) {
+        DynamicType dst = view();
+        op.apply(dst);
+        return *this;
+    }
+
+    /* View of the data of a contiguous dynamic view with the same shape */
+    template<class BroadcastPolicy>
+    explicit StaticTensorView(TensorView<T, NumDims, BroadcastPolicy> view) : data_ptr_(view.data()) {
+        TV_ASSERT((shapes_equal<NumDims, NumDims>(view.shape(), ExtentsType::shape)),
+                  "Shape of the view differs from static extents")
+        TV_ASSERT(view.is_contiguous(), "Static view needs a contiguous view")
+    }
+
+    template<typename... TInds, std::enable_if_t<sizeof...(TInds) == NumDims, int> = 0>
+    T& at(TInds... inds) {
+        return data_ptr_[ExtentsType::offset(inds...)];
+    }
+
+    template<typename... TInds, std::enable_if_t<sizeof...(TInds) == NumDims, int> = 0>
+    const T& at(TInds... inds) const {
+        return data_ptr_[ExtentsType::offset(inds...)];
+    }
+
+    /* Sub-view with the first coordinates set to inds, also static */
+    template<typename... TInds, std::enable_if_t<(sizeof...(TInds) < NumDims), int> = 0>
+    StaticTensorView<T, typename detail::drop_extents<sizeof...(TInds), ExtentsType>::type>
+    at(TInds... inds) const {
+        return StaticTensorView<T, typename detail::drop_extents<sizeof...(TInds), ExtentsType>::type>(
+                data_ptr_ + ExtentsType::offset(inds...));
+    }
+
+    template<typename... TInds, std::enable_if_t<sizeof...(TInds) == NumDims, int> = 0>
+    T& operator()(TInds... inds) {
+        return at(inds...);
+    }
+
+    template<typename... TInds, std::enable_if_t<sizeof...(TInds) == NumDims, int> = 0>
+    const T& operator()(TInds... inds) const {
+        return at(inds...);
+    }
+
+    template<typename... TInds, std::enable_if_t<(sizeof...(TInds) < NumDims), int> = 0>
+    auto operator()(TInds... inds) const {
+        return at(inds...);
+    }
+
+    static constexpr ShapeType shape() {
+        return ExtentsType::shape;
+    }
+
+    static constexpr ShapeType stride() {
+        return ExtentsType::strides();
+    }
+
+    static constexpr size_t size(size_t dim) {
+        return ExtentsType::size(dim);
+    }
+
+    static constexpr size_t num_elements() {
+        return ExtentsType::num_elements();
+    }
+
+    static constexpr bool is_contiguous() {
+        return true;
+    }
+
+    T* data() {
+        return data_ptr_;
+    }
+
+    const T* data() const {
+        return data_ptr_;
+    }
+
+    bool empty() const {
+        return data_ptr_ == nullptr;
+    }
+
+    /* Dynamic view of the same data, for operations which are not members of the static view */
+    DynamicType view() const {
+        return DynamicType(data_ptr_, ExtentsType::shape, ExtentsType::strides());
+    }
+
+    operator DynamicType() const {
+        return view();
+    }
+
+    template<class TRhs>
+    Type& assign_(const TRhs& rhs, const ExecutionPolicy& policy = get_execution_policy()) {
+        view().assign_(rhs, policy);
+        return *this;
+    }
+
+    template<class Func, class... TArgs>
+    Type& map_(Func&& f, TArgs&&... args) {
+        view().map_(std::forward<Func>(f), std::forward<TArgs>(args)...);
+        return *this;
+    }
+
+    template<class Func, class... TArgs>
+    auto map(Func&& f, TArgs&&... args) const {
+        return view().map(std::forward<Func>(f), std::forward<TArgs>(args)...);
+    }
+
+    template<class... TArgs>
+    auto sum(TArgs&&... args) const {
+        return view().sum(std::forward<TArgs>(args)...);
+    }
+
+    template<class... TArgs>
+    auto max(TArgs&&... args) const {
+        return view().max(std::forward<TArgs>(args)...);
+    }
+
+    template<class Func, class... TArgs>
+    auto reduce(Func&& f, TArgs&&... args) const {
+        return view().reduce(std::forward<Func>(f), std::forward<TArgs>(args)...);
+    }
+
+    template<class TRhs>
+    Type& operator+=(const TRhs& rhs) {
+        view() += rhs;
+        return *this;
+    }
+
+    template<class TRhs>
+    Type& operator-=(const TRhs& rhs) {
+        view() -= rhs;
+        return *this;
+    }
+
+    Type& operator*=(ValueType c) {
+        view() *= c;
+        return *this;
+    }
+
+    template<class TRhs>
+    Type& operator/=(const TRhs& rhs) {
+        view() /= rhs;
+        return *this;
+    }
+
+private:
+    T* data_ptr_;
+};
+
+template<class T, size_t... Dims>
+std::ostream& operator<<(std::ostream& stream, const StaticTensorView<T, Extents<Dims...>>& view) {
+    return stream << view.view();
+}
+
+} // namespace tensor_view
@@ -1,8 +1,12 @@
 #pragma once
 
-#include <vector>
 #include <array>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <TensorView/Allocator.h>
 #include <TensorView/TensorView.h>
+#include <TensorView/Workspace.h>
 
 
 namespace tensor_view {
@@ -18,34 +22,167 @@ size_t product(T t, Ts ...ts) {
     return res;
 }
 
-size_t product(const size_t* dims, size_t nd) {
+inline size_t product(const size_t* dims, size_t nd) {
     size_t res = 1;
-    for (int i = 0; i < nd; ++i) {
+    for (size_t i = 0; i < nd; ++i) {
         res *= dims[i];
     }
     return res;
 }
 
-template<class T, size_t ndim, class BroadcastPolicy>
+/* Owning tensor. Storage is obtained from Allocator (64-byte aligned by default).
+ * Elements are value-initialized unless the tensor is constructed with the `uninitialized` tag,
+ * in which case elements of trivially constructible types are left as is. */
+template<class T, size_t ndim, class BroadcastPolicy, class Allocator>
 class Tensor : public TensorView<T, ndim, BroadcastPolicy> {
+    using AllocatorTraits = std::allocator_traits<Allocator>;
+    static_assert(std::is_same<typename AllocatorTraits::value_type, T>::value,
+                  "Allocator value type must be the same as tensor value type");
+
 public:
-    template<typename ...TDims, std::enable_if_t<sizeof...(TDims) == ndim, int> = 0>
-    Tensor(TDims... dims) : data_(product(dims...)) {
-        std::array<size_t, ndim> a_dims{{static_cast<size_t>(dims)...}};
-        std::copy(a_dims.begin(), a_dims.end(), this->shape_);
-        calculate_strides(this->shape_, this->stride_, ndim);
+    using AllocatorType = Allocator;
+
+    template<typename ...TDims, std::enable_if_t<sizeof...(TDims) == ndim &&
+                                                 detail::all_integral<TDims...>::value, int> = 0>
+    Tensor(TDims... dims) :
+            Tensor(std::array<size_t, ndim>{{static_cast<size_t>(dims)...}}.data()) {
+    }
+
+    template<typename ...TDims, std::enable_if_t<sizeof...(TDims) == ndim &&
+                                                 detail::all_integral<TDims...>::value, int> = 0>
+    Tensor(uninitialized_t tag, TDims... dims) :
+            Tensor(tag, std::array<size_t, ndim>{{static_cast<size_t>(dims)...}}.data()) {
+    }
+
+    Tensor(const size_t* dims, const Allocator& allocator = Allocator()) :
+            allocator_(allocator) {
+        allocate(dims);
+        construct(std::false_type{});
+    }
+
+    Tensor(uninitialized_t, const size_t* dims, const Allocator& allocator = Allocator()) :
+            allocator_(allocator) {
+        allocate(dims);
+        construct(std::is_trivially_default_constructible<T>{});
+    }
+
+    Tensor(const Tensor& other) :
+            TensorView<T, ndim, BroadcastPolicy>(other),
+            allocator_(AllocatorTraits::select_on_container_copy_construction(other.allocator_)) {
+        allocate(other.shape_);
+        copy_from(other);
+    }
+
+    Tensor(Tensor&& other) noexcept :
+            TensorView<T, ndim, BroadcastPolicy>(other),
+            allocator_(std::move(other.allocator_)),
+            size_(other.size_) {
+        other.data_ptr_ = nullptr;
+        other.size_ = 0;
+        std::fill(other.shape_, other.shape_ + ndim, 0);
+    }
+
+    Tensor& operator=(const Tensor& other) {
+        if (this != &other) {
+            Tensor tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    Tensor& operator=(Tensor&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~Tensor() {
+        release();
     }
 
-    Tensor(const size_t* dims) :
-            data_(product(dims, ndim)) {
-        this->data_ptr_ = data_.data();
+    const Allocator& get_allocator() const {
+        return allocator_;
+    }
+
+    void swap(Tensor& other) noexcept {
+        using std::swap;
+        swap(this->data_ptr_, other.data_ptr_);
+        swap(this->shape_, other.shape_);
+        swap(this->stride_, other.stride_);
+        swap(allocator_, other.allocator_);
+        swap(size_, other.size_);
+    }
+
+private:
+    Allocator allocator_;
+    size_t size_ = 0;
+
+    void allocate(const size_t* dims) {
         std::copy(dims, dims + ndim, this->shape_);
         calculate_strides(this->shape_, this->stride_, ndim);
+        size_ = product(dims, ndim);
+        this->data_ptr_ = AllocatorTraits::allocate(allocator_, size_);
     }
 
-private:
-    std::vector<T> data_;
+    /* Value-initializes elements */
+    void construct(std::false_type is_trivial) {
+        size_t constructed = 0;
+        try {
+            for (; constructed < size_; ++constructed) {
+                AllocatorTraits::construct(allocator_, this->data_ptr_ + constructed);
+            }
+        } catch (...) {
+            destroy(constructed);
+            AllocatorTraits::deallocate(allocator_, this->data_ptr_, size_);
+            throw;
+        }
+    }
+
+    /* Leaves elements of trivial types uninitialized */
+    void construct(std::true_type is_trivial) {
+    }
+
+    void copy_from(const Tensor& other) {
+        size_t constructed = 0;
+        try {
+            for (; constructed < size_; ++constructed) {
+                AllocatorTraits::construct(allocator_, this->data_ptr_ + constructed, other.data_ptr_[constructed]);
+            }
+        } catch (...) {
+            destroy(constructed);
+            AllocatorTraits::deallocate(allocator_, this->data_ptr_, size_);
+            throw;
+        }
+    }
+
+    void destroy(size_t count) {
+        if (!std::is_trivially_destructible<T>::value) {
+            for (size_t i = 0; i < count; ++i) {
+                AllocatorTraits::destroy(allocator_, this->data_ptr_ + i);
+            }
+        }
+    }
 
+    void release() {
+        if (this->data_ptr_) {
+            destroy(size_);
+            AllocatorTraits::deallocate(allocator_, this->data_ptr_, size_);
+            this->data_ptr_ = nullptr;
+        }
+    }
 };
 
-} // namespace tensor_view
\ No newline at end of file
+/* Tensor for temporaries, allocated from the thread-local workspace */
+template<class T, size_t ndim, class BroadcastPolicy = implicit_broadcast>
+using WorkspaceTensor = Tensor<T, ndim, BroadcastPolicy, WorkspaceAllocator<T>>;
+
+/* Contiguous copy of a view. Permuted views are copied in tiles, see TensorView::assign_ */
+template<class TTensorView, std::enable_if_t<is_tensor_view_v<TTensorView>, int> = 0>
+Tensor<std::remove_const_t<typename TTensorView::ValueType>, TTensorView::NumDims>
+contiguous(const TTensorView& view, const ExecutionPolicy& policy = get_execution_policy()) {
+    Tensor<std::remove_const_t<typename TTensorView::ValueType>, TTensorView::NumDims> result(uninitialized,
+                                                                                              view.shape());
+    result.assign_(view, policy);
+    return result;
+}
+
+} // namespace tensor_view
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "Half.h"
 #include "TensorViewFwd.h"
 #include "Traits.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
-#include <iomanip>
+#include <sstream>
 
 #ifndef TENSORIO_MAX_ELEMENTS_WRAP
 #define TENSORIO_MAX_ELEMENTS_WRAP 15
@@ -30,24 +33,41 @@ struct rank<0> {
 };
 
 
+/* Formats an element into buffer like `stream << std::setprecision(3) << t` for floating point types and
+ * `stream << t` for others, returns the length. Arithmetic types are formatted without allocations. */
 template<class T>
-std::string print_element_impl(const T& t, rank<0>) {
-    std::stringstream ss;
+size_t format_element_impl(const T& t, char (&buffer)[32], rank<0>) {
+    std::ostringstream ss;
     ss << t;
-    return ss.str();
+    const std::string s = ss.str();
+    const size_t size = std::min(s.size(), sizeof(buffer));
+    std::copy(s.data(), s.data() + size, buffer);
+    return size;
 }
 
-template<class T, enable_if_t<std::is_floating_point<T>::value, int> = 0>
-std::string print_element_impl(const T& t, rank<1>) {
-    std::stringstream ss;
-    ss << std::setprecision(3);
-    ss << t;
-    return ss.str();
+template<class T, enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+                              sizeof(T) != 1, int> = 0>
+size_t format_element_impl(const T& t, char (&buffer)[32], rank<1>) {
+    const int size = std::is_signed<T>::value
+                     ? std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(t))
+                     : std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(t));
+    return static_cast<size_t>(size);
+}
+
+template<class T, enable_if_t<std::is_floating_point<T>::value || is_half<T>::value, int> = 0>
+size_t format_element_impl(const T& t, char (&buffer)[32], rank<1>) {
+    return static_cast<size_t>(std::snprintf(buffer, sizeof(buffer), "%.3Lg", static_cast<long double>(t)));
+}
+
+template<class T>
+size_t format_element(const T& t, char (&buffer)[32]) {
+    return format_element_impl(t, buffer, rank<1>{});
 }
 
 template<class T>
 std::string print_element(const T& t) {
-    return print_element_impl(t, rank<1>{});
+    char buffer[32];
+    return std::string(buffer, format_element(t, buffer));
 }
 
 
@@ -62,57 +82,82 @@ inline  void print_line_breaks(std::ostream& stream, int n) {
 }
 
 
-template<size_t N>
+/* Prints a strided array level by level, walking the data pointer instead of creating sub-views.
+ * Only the elements shown are visited: all of them for dims up to ELEMENTS_WRAP, otherwise
+ * WRAPPER_NUM_ELEMENTS from each end, so the cost does not depend on the size of the array. */
 class TensorPrinter {
 public:
-    template<class SubViewType>
-    static void print(std::ostream& stream, SubViewType view, int margin, int maxw) {
-        stream << '[';
-        for (int i = 0; i < view.size(0) - 1; ++i) {
-            if (view.size(0) > ELEMENTS_WRAP && i == WRAPPER_NUM_ELEMENTS) {
-                stream << "...,";
-                print_line_breaks(stream, N - 1);
-                print_margin(stream, margin);
-                break;
+    /* Maximum width of the shown elements */
+    template<class T>
+    static size_t max_width(const T* data, const size_t* shape, const size_t* stride, size_t ndim) {
+        size_t result = 1;
+        for_each_shown(shape[0], [&](size_t i) {
+            const T* item = data + static_cast<ptrdiff_t>(i) * static_cast<ptrdiff_t>(stride[0]);
+            if (ndim == 1) {
+                char buffer[32];
+                result = std::max(result, format_element(*item, buffer));
+            } else {
+                result = std::max(result, max_width(item, shape + 1, stride + 1, ndim - 1));
             }
-            TensorPrinter<N - 1>::print(stream, view.at(i), margin + 1, maxw);
-            stream << ',';
+        });
+        return result;
+    }
 
-            print_line_breaks(stream, N - 1);
+    template<class T>
+    static void print(std::ostream& stream, const T* data, const size_t* shape, const size_t* stride, size_t ndim,
+                      int margin, int maxw) {
+        const size_t size = shape[0];
+        auto print_item = [&](size_t i) {
+            const T* item = data + static_cast<ptrdiff_t>(i) * static_cast<ptrdiff_t>(stride[0]);
+            if (ndim == 1) {
+                char buffer[32];
+                const size_t width = format_element(*item, buffer);
+                print_margin(stream, maxw - static_cast<int>(width));
+                stream.write(buffer, static_cast<std::streamsize>(width));
+            } else {
+                print(stream, item, shape + 1, stride + 1, ndim - 1, margin + 1, maxw);
+            }
+        };
+        auto print_separator = [&] {
+            if (ndim == 1) {
+                stream << ", ";
+                return;
+            }
+            stream << ',';
+            print_line_breaks(stream, ndim - 1);
             print_margin(stream, margin);
+        };
+
+        stream << '[';
+        if (size == 0) {
+            stream << ']';
+            return;
         }
-        if (view.size(0) > ELEMENTS_WRAP) {
-            for (int i = view.size(0) - WRAPPER_NUM_ELEMENTS; i < view.size(0) - 1; ++i) {
-                TensorPrinter<N - 1>::print(stream, view.at(i), margin + 1, maxw);
-                stream << ',';
-                print_line_breaks(stream, N - 1);
-                print_margin(stream, margin);
+        for_each_shown(size, [&](size_t i) {
+            print_item(i);
+            if (i + 1 == size) {
+                return;
             }
-        }
-        TensorPrinter<N - 1>::print(stream, view.at(view.size(0) - 1), margin + 1, maxw);
+            print_separator();
+            if (size > ELEMENTS_WRAP && i + 1 == WRAPPER_NUM_ELEMENTS) {
+                stream << "...";
+                print_separator();
+            }
+        });
         stream << ']';
     }
-};
 
-template<>
-class TensorPrinter<1> {
-public:
-    template<class SubViewType>
-    static void print(std::ostream& stream, SubViewType view, int margin, int maxw) {
-        stream << '[';
-        for (int i = 0; i < view.size(0) - 1; ++i) {
-            if (view.size(0) > ELEMENTS_WRAP && i == WRAPPER_NUM_ELEMENTS) {
-                stream << "..., ";
-                break;
-            }
-            stream << std::setw(maxw) << print_element(view.at(i)) << ", ";
-        }
-        if (view.size(0) > ELEMENTS_WRAP) {
-            for (int i = view.size(0) - WRAPPER_NUM_ELEMENTS; i < view.size(0) - 1; ++i) {
-                stream << std::setw(maxw) << print_element(view.at(i)) << ", ";
+private:
+    /* Calls f(i) for indices of the shown elements of a dim */
+    template<class F>
+    static void for_each_shown(size_t size, F&& f) {
+        const bool wrap = size > ELEMENTS_WRAP;
+        for (size_t i = 0; i < size; ++i) {
+            if (wrap && i == WRAPPER_NUM_ELEMENTS) {
+                i = size - WRAPPER_NUM_ELEMENTS;
             }
+            f(i);
         }
-        stream << std::setw(maxw) << print_element(view.at(view.size(0) - 1)) << ']';
     }
 };
 
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <numeric>
 #include <functional>
+#include <limits>
 
 #include "Dims.h"
 #include "TensorViewFwd.h"
@@ -43,12 +44,13 @@ public:
     template<class TDeferredOperation, enable_if_t<is_operation_v<TDeferredOperation>, int> = 0>
     Type& operator=(const TDeferredOperation& op) {
         op.apply(*this);
+        return *this;
     }
 
     template<typename ...TInds, std::enable_if_t<sizeof...(TInds) == ndim, int> = 0>
     T& at(TInds&& ... inds) {
         /* Returns specific element of a tensor view */
-        size_t offset = CalculateOffsetImpl<sizeof... (TInds) - 1, ndim - 1>::calculate(0, stride_, inds...);
+        ptrdiff_t offset = CalculateOffsetImpl<sizeof... (TInds) - 1, ndim - 1>::calculate(0, stride_, inds...);
         return data_ptr_[offset];
     }
 
@@ -57,14 +59,14 @@ public:
         /* Returns "sub-view" of a tensor, i.e. TensorView with the first coordinates set to inds */
         const size_t NInds = sizeof...(TInds);
         const size_t new_ndims = ndim - NInds;
-        size_t offset = CalculateOffsetImpl<NInds - 1, NInds - 1>::calculate(0, stride_, inds...);
+        ptrdiff_t offset = CalculateOffsetImpl<NInds - 1, NInds - 1>::calculate(0, stride_, inds...);
         return TensorView<T, new_ndims, BroadcastPolicyTag>(data_ptr_ + offset, shape_ + NInds, stride_ + NInds);
     }
 
     template<typename ...TInds, std::enable_if_t<sizeof...(TInds) == ndim, int> = 0>
     const T& at(TInds&& ... inds) const {
         /* Returns specific element of a tensor view */
-        size_t offset = CalculateOffsetImpl<sizeof... (TInds) - 1, ndim - 1>::calculate(0, stride_, inds...);
+        ptrdiff_t offset = CalculateOffsetImpl<sizeof... (TInds) - 1, ndim - 1>::calculate(0, stride_, inds...);
         return data_ptr_[offset];
     }
 
@@ -73,7 +75,7 @@ public:
         /* Returns "sub-view" of a tensor, i.e. TensorView with the first coordinates set to inds */
         const size_t NInds = sizeof...(TInds);
         const size_t new_ndims = ndim - NInds;
-        size_t offset = CalculateOffsetImpl<NInds - 1, NInds - 1>::calculate(0, stride_, inds...);
+        ptrdiff_t offset = CalculateOffsetImpl<NInds - 1, NInds - 1>::calculate(0, stride_, inds...);
         return TensorView<T, new_ndims, BroadcastPolicyTag>(data_ptr_ + offset, shape_ + NInds, stride_ + NInds);
     }
 
@@ -109,14 +111,18 @@ public:
     }
 
     template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs>, int> = 0>
-    void assign_(const TensorViewRhs& rhs) {
-        ElementWiseInplaceOp<Type, TensorViewRhs>::impl([&rhs](auto& a, auto& b) {
-            return b;
-        }, *this, rhs);
+    void assign_(const TensorViewRhs& rhs, const ExecutionPolicy& policy = get_execution_policy()) {
+        /* Transposed views are copied in cache-sized tiles */
+        detail::copy_view(detail::view_t<TensorViewRhs>(rhs), *this, policy);
+    }
+
+    template<class TDeferredOperation, enable_if_t<is_operation_v<TDeferredOperation>, int> = 0>
+    void assign_(const TDeferredOperation& op, const ExecutionPolicy& policy = get_execution_policy()) {
+        op.apply(*this, policy);
     }
 
-    void assign_(ValueType value) {
-        map_([value](const ValueType& val) { return value; });
+    void assign_(ValueType value, const ExecutionPolicy& policy = get_execution_policy()) {
+        map_([value](const ValueType& val) { return value; }, policy);
     }
 
     template<class... Ts>
@@ -135,6 +141,38 @@ public:
         return Type(data_ptr_, shape.data(), strides.data());
     }
 
+    /* View of indices start:stop:step of the dimension (see Range), sharing data with this view */
+    Type slice(size_t dim, ptrdiff_t start, ptrdiff_t stop, ptrdiff_t step = 1) const {
+        return slice_dim(dim, Range(start, stop, step));
+    }
+
+    /* View of ranges of the leading dimensions, one range per dimension; view.slice(Range(), Range(10, 20))
+     * is view[:, 10:20] */
+    template<class... Ranges, std::enable_if_t<(sizeof...(Ranges) <= ndim) && detail::all_ranges<Ranges...>::value,
+                                               int> = 0>
+    Type slice(const Ranges& ... ranges) const {
+        const Range dim_ranges[] = {ranges...};
+        Type result = *this;
+        for (size_t i = 0; i < sizeof...(Ranges); ++i) {
+            result = result.slice_dim(i, dim_ranges[i]);
+        }
+        return result;
+    }
+
+    /* View of `length` indices of the dimension starting from `start` */
+    Type narrow(size_t dim, size_t start, size_t length) const {
+        TV_ASSERT(dim < ndim && start + length <= shape_[dim], "Narrowed range is out of bounds")
+        Type result = *this;
+        result.data_ptr_ += static_cast<ptrdiff_t>(start * stride_[dim]);
+        result.shape_[dim] = length;
+        return result;
+    }
+
+    /* View with reversed order of indices along the dimension */
+    Type flip(size_t dim) const {
+        return slice_dim(dim, Range(Range::none, Range::none, -1));
+    }
+
     template<class... Ts>
     TensorView<ValueType, sizeof...(Ts), BroadcastPolicyTag> reshape(Ts... ts) {
         TV_ASSERT(is_contiguous(), "Tensor for reshape must be contiguous")
@@ -205,30 +243,29 @@ public:
         return std::accumulate(shape_, shape_ + NumDims, 1, std::multiplies<>());
     }
 
-    ValueType max() const {
-        const ValueType& (& max_fn)(const ValueType&, const ValueType&) = std::max<ValueType>;
-        return reduce(max_fn);
+    ValueType max(const ExecutionPolicy& policy = get_execution_policy()) const {
+        return reduce(maximum<ValueType>(), std::numeric_limits<ValueType>::lowest(), policy);
     }
 
     template<class TensorViewDst, enable_if_t<is_tensor_view_v<TensorViewDst>, int> = 0>
-    auto max(TensorViewDst& dst, size_t axis) const {
-        const ValueType& (& max_fn)(const ValueType&, const ValueType&) = std::max<ValueType>;
-        return reduce(max_fn, dst, axis, std::numeric_limits<typename TensorViewDst::ValueType>::min());
+    auto max(TensorViewDst& dst, size_t axis, const ExecutionPolicy& policy = get_execution_policy()) const {
+        using DstValueType = typename TensorViewDst::ValueType;
+        return reduce(maximum<DstValueType>(), dst, axis, std::numeric_limits<DstValueType>::lowest(), policy);
     }
 
-    ValueType sum() const {
-        return reduce(std::plus<ValueType>());
+    ValueType sum(const ExecutionPolicy& policy = get_execution_policy()) const {
+        return reduce(std::plus<ValueType>(), ValueType{}, policy);
     }
 
     template<class TensorViewDst, enable_if_t<is_tensor_view_v<TensorViewDst>, int> = 0>
-    auto sum(TensorViewDst& dst, size_t axis) {
-        return reduce(std::plus<typename TensorViewDst::ValueType>(), dst, axis, 0);
+    auto sum(TensorViewDst& dst, size_t axis, const ExecutionPolicy& policy = get_execution_policy()) const {
+        return reduce(std::plus<typename TensorViewDst::ValueType>(), dst, axis, 0, policy);
     }
 
 
     template<class Func>
-    Type& map_(Func&& f) {
-        UnaryInplaceOp<Type>::impl(std::forward<Func>(f), *this);
+    Type& map_(Func&& f, const ExecutionPolicy& policy = get_execution_policy()) {
+        UnaryInplaceOp<Type>::impl(std::forward<Func>(f), *this, policy);
         return *this;
     }
 
@@ -238,34 +275,44 @@ public:
     }
 
     template<class Func, class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs>, int> = 0>
-    Type& map_(Func&& f, const TensorViewRhs& rhs) {
-        ElementWiseInplaceOp<Type, TensorViewRhs>::impl(std::forward<Func>(f), *this, rhs);
+    Type& map_(Func&& f, const TensorViewRhs& rhs, const ExecutionPolicy& policy = get_execution_policy()) {
+        ElementWiseInplaceOp<Type, detail::view_t<TensorViewRhs>>::impl(std::forward<Func>(f), *this, rhs, policy);
         return *this;
     }
 
-    template<class Func, class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs>, int> = 0>
-    auto map(Func&& f, const TensorViewRhs& rhs) const {
-        return make_reduce_operation(std::forward<Func>(f), *this, rhs);
+    template<class Func, class TExpression, enable_if_t<is_expression_v<TExpression>, int> = 0>
+    Type& map_(Func&& f, const TExpression& rhs, const ExecutionPolicy& policy = get_execution_policy()) {
+        /* Whole expression is fused with the in-place operation */
+        make_element_wise_op(std::forward<Func>(f), *this, rhs).apply(*this, policy);
+        return *this;
+    }
+
+    template<class Func, class TRhs, enable_if_t<is_expression_operand_v<TRhs>, int> = 0>
+    auto map(Func&& f, const TRhs& rhs) const {
+        return make_element_wise_op(std::forward<Func>(f), *this, rhs);
     }
 
 
     template<class Func, class TResult = ValueType>
-    TResult reduce(Func&& f, TResult initial_value = TResult{}) const {
-        size_t trivial_dim = find_first_trivial_dim(*this);
-        TResult result = initial_value;
-        AllReduceImpl<ndim>::impl(std::forward<Func>(f), *this, result, trivial_dim, initial_value);
-        return result;
+    TResult reduce(Func&& f, TResult initial_value = TResult{},
+                   const ExecutionPolicy& policy = get_execution_policy()) const {
+        /* Functors marked with is_associative are reduced in parallel with pairwise summation,
+         * the rest are folded sequentially in the logical order of elements */
+        TV_TRACE_SCOPE("reduce", *this, sizeof(ValueType))
+        TV_TRACE_VIEWS(*this)
+        return all_reduce(f, *this, initial_value, policy);
     }
 
     template<class Func, class TensorViewDst, enable_if_t<is_tensor_view_v<TensorViewDst>, int> = 0>
     void reduce(Func&& f,
-                TensorViewDst dst,
+                const TensorViewDst& dst,
                 size_t axis,
-                typename TensorViewDst::ValueType initial_value = typename TensorViewDst::ValueType{}) const {
+                typename TensorViewDst::ValueType initial_value = typename TensorViewDst::ValueType{},
+                const ExecutionPolicy& policy = get_execution_policy()) const {
         static_assert(NumDims == TensorViewDst::NumDims + 1, "Incorrect number of dims of destination tensor");
-        // todo: check shapes (all but `axis` must be the same)
-        dst.assign_(initial_value);
-        ReduceDim<NumDims, NumDims - 1>::impl(std::forward<Func>(f), *this, dst, NumDims - axis);
+        TV_TRACE_SCOPE("reduce_axis", *this, sizeof(ValueType))
+        TV_TRACE_VIEWS(*this)
+        detail::axis_reduce(f, *this, detail::view_t<TensorViewDst>(dst), axis, initial_value, policy);
     }
 
     template<class Func, class TInitial = ValueType>
@@ -274,42 +321,27 @@ public:
     }
 
 
-    template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs>, int> = 0>
-    auto operator+(const TensorViewRhs& rhs) {
-        return map(std::plus<ValueType>(), rhs);
-    }
-
-    template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs>, int> = 0>
+    template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs> || is_expression_v<TensorViewRhs>, int> = 0>
     Type& operator+=(const TensorViewRhs& rhs) {
         return map_(std::plus<ValueType>(), rhs);
     }
 
-    template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs>, int> = 0>
+    template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs> || is_expression_v<TensorViewRhs>, int> = 0>
     Type& operator/=(const TensorViewRhs& rhs) {
         return map_(std::divides<ValueType>(), rhs);
     }
 
-    template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs>, int> = 0>
+    template<class TensorViewRhs, enable_if_t<is_tensor_view_v<TensorViewRhs> || is_expression_v<TensorViewRhs>, int> = 0>
     Type& operator-=(const TensorViewRhs& rhs) {
         return map_(std::minus<ValueType>(), rhs);
     }
 
     Type& operator*=(ValueType c) {
-        ValueType c_cast = static_cast<ValueType>(c);
-        using namespace std::placeholders;
-        return map_(std::bind(std::multiplies<ValueType>(), c_cast, _1));
+        return map_(detail::bind_rhs(std::multiplies<ValueType>(), c));
     }
 
     Type& operator/=(ValueType c) {
-        ValueType c_cast = static_cast<ValueType>(c);
-        using namespace std::placeholders;
-        return map_(std::bind(std::divides<ValueType>(), c_cast, _1));
-    }
-
-    auto operator*(ValueType c) {
-        ValueType c_cast = static_cast<ValueType>(c);
-        using namespace std::placeholders;
-        return map(std::bind(std::multiplies<ValueType>(), c_cast, _1));
+        return map_(detail::bind_rhs(std::divides<ValueType>(), c));
     }
 
     friend std::ostream& operator<<<Type>(std::ostream&, const Type&);
@@ -319,11 +351,24 @@ protected:
     size_t shape_[ndim];
     size_t stride_[ndim];
 
+    Type slice_dim(size_t dim, const Range& range) const {
+        TV_ASSERT(dim < ndim, "Sliced dimension is out of range")
+        TV_ASSERT(range.step != 0, "Slice step must not be zero")
+        ptrdiff_t start;
+        size_t length;
+        detail::resolve_range(range, shape_[dim], start, length);
+        Type result = *this;
+        if (length > 0) {
+            result.data_ptr_ += start * static_cast<ptrdiff_t>(stride_[dim]);
+        }
+        result.shape_[dim] = length;
+        result.stride_[dim] = static_cast<size_t>(static_cast<ptrdiff_t>(stride_[dim]) * range.step);
+        return result;
+    }
+
+    /* Width of the widest element shown by operator<< */
     int deduce_maxw() const {
-        return reduce([](const size_t& a, const ValueType& b) {
-            auto i = print_element(b);
-            return std::max(a, i.size());
-        }, 1);
+        return static_cast<int>(TensorPrinter::max_width(data_ptr_, shape_, stride_, ndim));
     }
 };
 
@@ -356,8 +401,9 @@ std::ostream& operator<<(std::ostream& stream, const TTensorView& t) {
         stream << t.shape_[i] << (i < ndim - 1 ? ", " : "");
     }
     stream << "], data:\n";
-    TensorPrinter<ndim>::print(stream, t, 1, maxw);
+    TensorPrinter::print(stream, t.data(), t.shape(), t.stride(), ndim, 1, maxw);
     stream << '\n';
+    return stream;
 }
 
 template<class T, size_t ndim, class BroadcastPolicy>
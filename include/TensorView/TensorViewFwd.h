@@ -12,7 +12,28 @@ struct disable_broadcast{};
 template<class T, size_t ndim, class BroadcastPolicy = implicit_broadcast>
 class TensorView;
 
-template<class T, size_t ndim, class BroadcastPolicy = implicit_broadcast>
+template<size_t... Dims>
+struct Extents;
+
+template<class T, class TExtents>
+class StaticTensorView;
+
+template<class T, size_t Alignment = 64>
+class AlignedAllocator;
+
+template<class T, size_t ndim, class BroadcastPolicy = implicit_broadcast, class Allocator = AlignedAllocator<T>>
 class Tensor;
 
+template<class T>
+class Scalar;
+
+template<class TLhs, class TRhs, class TFunc>
+class ElementWiseOperation;
+
+template<class TSrc, class TFunc>
+class UnaryOperation;
+
+template<class TSrc, class TInitial, class TFunc>
+class ReduceOperation;
+
 } // namespace
\ No newline at end of file
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Instrumentation of operations is compiled only with TV_ENABLE_TRACING defined, otherwise the macros below expand
+ * to nothing. The macro changes the definitions of inline functions of the library, so it must be set the same way
+ * in every translation unit of a program (e.g. as a compile definition of the target), mixing them violates the
+ * one definition rule. Recording is started with trace::start():
+ *
+ *     trace::start();
+ *     ...
+ *     trace::stop();
+ *     trace::write_chrome_trace(file); // open in chrome://tracing or ui.perfetto.dev
+ *     trace::write_summary(std::cout);
+ */
+#ifdef TV_ENABLE_TRACING
+#define TV_TRACE_SCOPE(name, shaped, bytes_per_element) \
+    ::tensor_view::trace::Scope tv_trace_scope_(name, shaped, bytes_per_element);
+#define TV_TRACE_STRIDES(shape, strides) ::tensor_view::trace::annotate(shape, strides);
+#define TV_TRACE_VIEWS(...) ::tensor_view::trace::annotate_views(__VA_ARGS__);
+#else
+#define TV_TRACE_SCOPE(name, shaped, bytes_per_element)
+#define TV_TRACE_STRIDES(shape, strides)
+#define TV_TRACE_VIEWS(...)
+#endif
+
+namespace tensor_view {
+namespace trace {
+
+/* How the operands were traversed */
+enum class Path {
+    unknown,
+    contiguous, // all operands are contiguous
+    strided,    // some operand is permuted, sliced or padded
+    broadcast   // some operand is broadcasted
+};
+
+inline const char* path_name(Path path) {
+    static const char* names[] = {"unknown", "contiguous", "strided", "broadcast"};
+    return names[static_cast<int>(path)];
+}
+
+const size_t max_event_dims = 8;
+
+/* Call of an operation. Times are in nanoseconds from the first use of the trace. */
+struct Event {
+    const char* name;
+    Path path;
+    size_t ndim;
+    size_t shape[max_event_dims];
+    uint64_t elements;
+    uint64_t bytes;
+    uint64_t start;
+    uint64_t duration;
+    uint32_t thread;
+};
+
+namespace detail {
+
+/* Events of a single thread. Buffers are owned by the registry, so events outlive their threads. */
+struct Buffer {
+    std::mutex mutex;
+    std::vector<Event> events;
+    uint32_t thread;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    std::atomic<bool> recording{false};
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+inline Registry& registry() {
+    static Registry registry;
+    return registry;
+}
+
+inline Buffer& thread_buffer() {
+    static thread_local std::shared_ptr<Buffer> buffer = [] {
+        auto result = std::make_shared<Buffer>();
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        result->thread = static_cast<uint32_t>(r.buffers.size());
+        r.buffers.push_back(result);
+        return result;
+    }();
+    return *buffer;
+}
+
+inline uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - registry().epoch).count());
+}
+
+/* Path of operands with the given strides over the shape */
+template<size_t K, size_t N>
+Path classify(const size_t* shape, const ptrdiff_t (&strides)[K][N]) {
+    Path path = Path::contiguous;
+    for (size_t k = 0; k < K; ++k) {
+        ptrdiff_t expected = 1;
+        for (size_t i = N; i-- > 0;) {
+            if (shape[i] == 1) {
+                continue;
+            }
+            if (strides[k][i] == 0) {
+                return Path::broadcast;
+            }
+            if (strides[k][i] != expected) {
+                path = Path::strided;
+            }
+            expected *= static_cast<ptrdiff_t>(shape[i]);
+        }
+    }
+    return path;
+}
+
+} // detail
+
+class Scope;
+
+namespace detail {
+inline Scope*& current_scope() {
+    static thread_local Scope* scope = nullptr;
+    return scope;
+}
+}
+
+/* Records the call of an operation from construction to destruction. The innermost scope of the thread
+ * is annotated with the path by the engine, which traverses the operands. */
+class Scope {
+public:
+    template<class TShaped>
+    Scope(const char* name, const TShaped& shaped, size_t bytes_per_element) {
+        if (!detail::registry().recording.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const size_t ndim = TShaped::NumDims;
+        event_.name = name;
+        event_.path = Path::unknown;
+        event_.ndim = std::min(ndim, max_event_dims);
+        event_.elements = 1;
+        for (size_t i = 0; i < ndim; ++i) {
+            if (i < max_event_dims) {
+                event_.shape[i] = shaped.shape()[i];
+            }
+            event_.elements *= shaped.shape()[i];
+        }
+        event_.bytes = event_.elements * bytes_per_element;
+        parent_ = detail::current_scope();
+        detail::current_scope() = this;
+        active_ = true;
+        event_.start = detail::now();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    ~Scope() {
+        if (!active_) {
+            return;
+        }
+        event_.duration = detail::now() - event_.start;
+        detail::current_scope() = parent_;
+        detail::Buffer& buffer = detail::thread_buffer();
+        event_.thread = buffer.thread;
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back(event_);
+    }
+
+    /* The first annotation wins, so that the path of the outer operation is not overwritten by nested ones */
+    void set_path(Path path) {
+        if (event_.path == Path::unknown) {
+            event_.path = path;
+        }
+    }
+
+private:
+    Event event_;
+    Scope* parent_ = nullptr;
+    bool active_ = false;
+};
+
+/* Sets the path of the innermost scope from the shape and the strides of the operands */
+template<size_t K, size_t N>
+void annotate(const size_t* shape, const ptrdiff_t (&strides)[K][N]) {
+    if (Scope* scope = detail::current_scope()) {
+        scope->set_path(detail::classify(shape, strides));
+    }
+}
+
+/* Sets the path of the innermost scope from views of the same shape */
+template<class TTensorView, class ...TTensorViews>
+void annotate_views(const TTensorView& view, const TTensorViews& ... views) {
+    if (!detail::current_scope()) {
+        return;
+    }
+    const size_t N = TTensorView::NumDims;
+    const size_t K = 1 + sizeof...(TTensorViews);
+    ptrdiff_t strides[K][N];
+    size_t k = 0;
+    auto collect = [&](const auto& v) {
+        for (size_t i = 0; i < N; ++i) {
+            strides[k][i] = static_cast<ptrdiff_t>(v.stride()[i]);
+        }
+        ++k;
+    };
+    collect(view);
+    int expand[] = {(collect(views), 0)...};
+    (void) expand;
+    annotate(view.shape(), strides);
+}
+
+inline void start() {
+    detail::registry().recording = true;
+}
+
+inline void stop() {
+    detail::registry().recording = false;
+}
+
+inline bool recording() {
+    return detail::registry().recording;
+}
+
+/* Events of all threads, ordered by start time */
+inline std::vector<Event> events() {
+    std::vector<Event> result;
+    detail::Registry& r = detail::registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto& buffer : r.buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        result.insert(result.end(), buffer->events.begin(), buffer->events.end());
+    }
+    std::sort(result.begin(), result.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+    return result;
+}
+
+inline void clear() {
+    detail::Registry& r = detail::registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto& buffer : r.buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        buffer->events.clear();
+    }
+}
+
+/* Writes events in Chrome trace event format (complete events, times in microseconds) */
+inline void write_chrome_trace(std::ostream& stream) {
+    const std::vector<Event> all = events();
+    stream << "{\"traceEvents\": [";
+    for (size_t i = 0; i < all.size(); ++i) {
+        const Event& e = all[i];
+        stream << (i > 0 ? ",\n" : "\n") << "{\"name\": \"" << e.name << "\", \"cat\": \"tensor_view\", \"ph\": \"X\""
+               << ", \"ts\": " << e.start / 1000 << '.' << std::setw(3) << std::setfill('0') << e.start % 1000
+               << ", \"dur\": " << e.duration / 1000 << '.' << std::setw(3) << e.duration % 1000
+               << std::setfill(' ') << ", \"pid\": 0, \"tid\": " << e.thread << ", \"args\": {\"shape\": \"[";
+        for (size_t j = 0; j < e.ndim; ++j) {
+            stream << (j > 0 ? ", " : "") << e.shape[j];
+        }
+        stream << "]\", \"path\": \"" << path_name(e.path) << "\", \"elements\": " << e.elements
+               << ", \"bytes\": " << e.bytes << "}}";
+    }
+    stream << "\n], \"displayTimeUnit\": \"ns\"}\n";
+}
+
+/* Writes a table of calls, time and throughput aggregated by operation and path, the slowest first */
+inline void write_summary(std::ostream& stream) {
+    struct Total {
+        uint64_t calls = 0;
+        uint64_t duration = 0;
+        uint64_t elements = 0;
+        uint64_t bytes = 0;
+    };
+    std::map<std::pair<std::string, Path>, Total> totals;
+    for (const Event& e : events()) {
+        Total& total = totals[{e.name, e.path}];
+        ++total.calls;
+        total.duration += e.duration;
+        total.elements += e.elements;
+        total.bytes += e.bytes;
+    }
+    std::vector<std::pair<std::pair<std::string, Path>, Total>> rows(totals.begin(), totals.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.duration > b.second.duration;
+    });
+
+    const std::ios::fmtflags flags = stream.flags();
+    const std::streamsize precision = stream.precision();
+    stream << std::left << std::setw(16) << "operation" << std::setw(12) << "path" << std::right
+           << std::setw(10) << "calls" << std::setw(14) << "total, ms" << std::setw(14) << "mean, us"
+           << std::setw(16) << "elements" << std::setw(12) << "GB/s" << '\n';
+    stream << std::fixed << std::setprecision(3);
+    for (const auto& row : rows) {
+        const Total& t = row.second;
+        const double seconds = t.duration * 1e-9;
+        stream << std::left << std::setw(16) << row.first.first << std::setw(12) << path_name(row.first.second)
+               << std::right << std::setw(10) << t.calls << std::setw(14) << seconds * 1e3
+               << std::setw(14) << seconds * 1e6 / t.calls << std::setw(16) << t.elements
+               << std::setw(12) << (t.duration > 0 ? t.bytes / seconds * 1e-9 : 0.) << '\n';
+    }
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+} // trace
+} // namespace tensor_view
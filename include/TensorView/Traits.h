@@ -16,8 +16,12 @@ template<class T, size_t nd, class Tag>
 struct is_tensor_view_impl<TensorView<T, nd, Tag>> : std::true_type {
 };
 
-template<class T, size_t nd, class Tag>
-struct is_tensor_view_impl<Tensor<T, nd, Tag>> : std::true_type {
+template<class T, size_t nd, class Tag, class Allocator>
+struct is_tensor_view_impl<Tensor<T, nd, Tag, Allocator>> : std::true_type {
+};
+
+template<class T, class TExtents>
+struct is_tensor_view_impl<StaticTensorView<T, TExtents>> : std::true_type {
 };
 
 }
@@ -30,6 +34,111 @@ struct is_tensor_view {
 template<class T>
 constexpr bool is_tensor_view_v = is_tensor_view<T>::value;
 
+namespace detail {
+/* Non-owning view of a view or of an owning tensor. Owning tensors are converted to it
+ * before being passed by value, so that their storage is not copied. */
+template<class T>
+using view_t = TensorView<typename std::decay_t<T>::ValueType, std::decay_t<T>::NumDims,
+                          typename std::decay_t<T>::BroadcastPolicyTag>;
+}
+
+
+namespace detail {
+
+template<class T>
+struct is_operation : std::false_type {
+};
+
+template<class T1, class T2, class T3>
+struct is_operation<ElementWiseOperation<T1, T2, T3>> : std::true_type {
+};
+
+template<class T1, class T2, class T3>
+struct is_operation<ReduceOperation<T1, T2, T3>> : std::true_type {
+};
+
+template<class T1, class T2>
+struct is_operation<UnaryOperation<T1, T2>> : std::true_type {
+};
+
+template<class T>
+struct is_expression : std::false_type {
+};
+
+template<class T1, class T2, class T3>
+struct is_expression<ElementWiseOperation<T1, T2, T3>> : std::true_type {
+};
+
+template<class T1, class T2>
+struct is_expression<UnaryOperation<T1, T2>> : std::true_type {
+};
+
+template<class T>
+struct is_scalar_operand : std::false_type {
+};
+
+template<class T>
+struct is_scalar_operand<Scalar<T>> : std::true_type {
+};
+
+template<class ...Ts>
+struct all_integral : std::true_type {
+};
+
+template<class T, class ...Ts>
+struct all_integral<T, Ts...>
+        : std::integral_constant<bool, std::is_integral<T>::value && all_integral<Ts...>::value> {
+};
+
+template<class ...Ts>
+struct all_tensor_views : std::true_type {
+};
+
+template<class T, class ...Ts>
+struct all_tensor_views<T, Ts...>
+        : std::integral_constant<bool, is_tensor_view_v<T> && all_tensor_views<Ts...>::value> {
+};
+
+/* All of Ts are the same type as T */
+template<class T, class ...Ts>
+struct all_same : std::true_type {
+};
+
+template<class T, class U, class ...Ts>
+struct all_same<T, U, Ts...>
+        : std::integral_constant<bool, std::is_same<T, U>::value && all_same<T, Ts...>::value> {
+};
+
+}
+
+template<class T>
+struct is_operation {
+    static constexpr bool const value = detail::is_operation<std::decay_t<T>>::value;
+};
+
+template<class T>
+constexpr bool is_operation_v = is_operation<T>::value;
+
+/* Element-wise deferred operations, which can be nested into each other and evaluated lazily */
+template<class T>
+struct is_expression {
+    static constexpr bool const value = detail::is_expression<std::decay_t<T>>::value;
+};
+
+template<class T>
+constexpr bool is_expression_v = is_expression<T>::value;
+
+/* Anything that can be an argument of element-wise expression: views, expressions and scalars */
+template<class T>
+struct is_expression_operand {
+    static constexpr bool const value = is_tensor_view_v<T> ||
+                                        is_expression_v<T> ||
+                                        std::is_arithmetic<std::decay_t<T>>::value;
+};
+
+template<class T>
+constexpr bool is_expression_operand_v = is_expression_operand<T>::value;
+
 
 template<class TInput>
 struct TensorViewChecked {
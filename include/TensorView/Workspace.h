@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "Allocator.h"
+
+namespace tensor_view {
+
+/* Arena for temporary buffers: memory is handed out by bumping an offset in a list of blocks
+ * and is given back all at once with release_to() / reset() (or by WorkspaceScope).
+ * Blocks are kept between uses, after reset() they are merged into a single block, so that
+ * a steady workload does not allocate memory at all.
+ *
+ * Workspace is not thread-safe. Each thread has its own workspace returned by Workspace::local(). */
+class Workspace {
+public:
+    static constexpr size_t alignment = 64;
+
+    explicit Workspace(size_t initial_capacity = 0) {
+        if (initial_capacity > 0) {
+            add_block(initial_capacity);
+        }
+    }
+
+    ~Workspace() {
+        release_blocks();
+    }
+
+    Workspace(const Workspace&) = delete;
+    Workspace& operator=(const Workspace&) = delete;
+
+    /* Returns `bytes` bytes aligned to `align` (power of two, at most Workspace::alignment) */
+    void* allocate(size_t bytes, size_t align = alignment) {
+        while (current_ < blocks_.size()) {
+            Block& block = blocks_[current_];
+            size_t offset = (top_ + align - 1) & ~(align - 1);
+            if (offset <= block.size && bytes <= block.size - offset) {
+                top_ = offset + bytes;
+                high_water_mark_ = std::max(high_water_mark_, block.start + top_);
+                return block.data + offset;
+            }
+            if (current_ + 1 < blocks_.size() && blocks_[current_ + 1].size >= bytes) {
+                ++current_;
+                top_ = 0;
+                continue;
+            }
+            break;
+        }
+
+        /* blocks after the current one are too small, they are replaced with a larger one */
+        while (blocks_.size() > current_ + 1) {
+            free_block(blocks_.back());
+            blocks_.pop_back();
+        }
+        size_t block_size = blocks_.empty() ? min_block_size : 2 * blocks_.back().size;
+        add_block(block_size > bytes ? block_size : bytes);
+        current_ = blocks_.size() - 1;
+        top_ = 0;
+        return allocate(bytes, align);
+    }
+
+    /* Memory is given back only if it is the last allocation, otherwise it is kept until release_to() */
+    void deallocate(void* ptr, size_t bytes) {
+        if (current_ < blocks_.size() && static_cast<char*>(ptr) + bytes == blocks_[current_].data + top_) {
+            top_ = static_cast<char*>(ptr) - blocks_[current_].data;
+        }
+    }
+
+    /* Position of the next allocation, which can be passed to release_to() */
+    size_t marker() const {
+        return current_ < blocks_.size() ? blocks_[current_].start + top_ : 0;
+    }
+
+    /* Frees everything allocated after the marker was taken */
+    void release_to(size_t marker) {
+        while (current_ > 0 && blocks_[current_].start > marker) {
+            --current_;
+        }
+        top_ = current_ < blocks_.size() ? marker - blocks_[current_].start : 0;
+    }
+
+    /* Frees all allocations and merges blocks into one, large enough for everything used before */
+    void reset() {
+        release_to(0);
+        if (blocks_.size() > 1) {
+            size_t size = capacity();
+            release_blocks();
+            add_block(size);
+        }
+    }
+
+    /* Bytes currently in use, including alignment padding and unused tails of previous blocks */
+    size_t used() const {
+        return marker();
+    }
+
+    size_t capacity() const {
+        return blocks_.empty() ? 0 : blocks_.back().start + blocks_.back().size;
+    }
+
+    /* Maximal number of bytes in use since the construction or the last reset_high_water_mark() */
+    size_t high_water_mark() const {
+        return high_water_mark_;
+    }
+
+    void reset_high_water_mark() {
+        high_water_mark_ = used();
+    }
+
+    size_t num_blocks() const {
+        return blocks_.size();
+    }
+
+    static Workspace& local() {
+        static thread_local Workspace workspace;
+        return workspace;
+    }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+        size_t start; // sum of sizes of previous blocks
+    };
+
+    static constexpr size_t min_block_size = size_t(1) << 16;
+
+    std::vector<Block> blocks_;
+    size_t current_ = 0;
+    size_t top_ = 0;
+    size_t high_water_mark_ = 0;
+
+    void add_block(size_t size) {
+        AlignedAllocator<char, alignment> allocator;
+        blocks_.push_back({allocator.allocate(size), size, capacity()});
+    }
+
+    static void free_block(const Block& block) {
+        AlignedAllocator<char, alignment>().deallocate(block.data, block.size);
+    }
+
+    void release_blocks() {
+        for (auto& block : blocks_) {
+            free_block(block);
+        }
+        blocks_.clear();
+        current_ = 0;
+        top_ = 0;
+    }
+};
+
+
+/* Releases all workspace allocations made during its lifetime */
+class WorkspaceScope {
+public:
+    explicit WorkspaceScope(Workspace& workspace = Workspace::local()) :
+            workspace_(workspace),
+            marker_(workspace.marker()) {
+    }
+
+    ~WorkspaceScope() {
+        workspace_.release_to(marker_);
+    }
+
+    WorkspaceScope(const WorkspaceScope&) = delete;
+    WorkspaceScope& operator=(const WorkspaceScope&) = delete;
+
+private:
+    Workspace& workspace_;
+    size_t marker_;
+};
+
+
+/* Allocator drawing memory from a workspace (the thread-local one by default).
+ * Containers using it must not outlive the enclosing WorkspaceScope and must be destroyed
+ * by the thread owning the workspace. */
+template<class T>
+class WorkspaceAllocator {
+public:
+    using value_type = T;
+
+    template<class U>
+    struct rebind {
+        using other = WorkspaceAllocator<U>;
+    };
+
+    WorkspaceAllocator() : workspace_(&Workspace::local()) {}
+
+    explicit WorkspaceAllocator(Workspace& workspace) : workspace_(&workspace) {}
+
+    template<class U>
+    WorkspaceAllocator(const WorkspaceAllocator<U>& other) : workspace_(&other.workspace()) {}
+
+    T* allocate(size_t n) {
+        /* blocks of the workspace are only aligned to Workspace::alignment */
+        static_assert(alignof(T) <= Workspace::alignment, "Type is over-aligned for the workspace");
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(workspace_->allocate(n * sizeof(T), Workspace::alignment));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        workspace_->deallocate(ptr, n * sizeof(T));
+    }
+
+    Workspace& workspace() const {
+        return *workspace_;
+    }
+
+    template<class U>
+    bool operator==(const WorkspaceAllocator<U>& other) const {
+        return workspace_ == &other.workspace();
+    }
+
+    template<class U>
+    bool operator!=(const WorkspaceAllocator<U>& other) const {
+        return !(*this == other);
+    }
+
+private:
+    Workspace* workspace_;
+};
+
+} // namespace
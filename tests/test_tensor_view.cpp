@@ -1,12 +1,23 @@
+#include <atomic>
+#include <cmath>
+#include <fstream>
 #include <numeric>
 #include <vector>
 
-
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
 #include "TensorView/TensorView.h"
 #include "TensorView/Tensor.h"
+#include "TensorView/Functions.h"
+#include "TensorView/Plan.h"
+#include "TensorView/MatMul.h"
+#include "TensorView/Convolution.h"
+#include "TensorView/Einsum.h"
+#include "TensorView/Npy.h"
+#include "TensorView/Quantized.h"
+#include "TensorView/StaticTensorView.h"
+#include "TensorView/Trace.h"
 
 
 template<class TTensorView>
@@ -28,9 +39,16 @@ namespace {
 using namespace tensor_view;
 using ::testing::ElementsAreArray;
 using ::testing::ElementsAre;
+using ::testing::Each;
 using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Ne;
+using ::testing::FloatNear;
+using ::testing::DoubleNear;
 using ::testing::ElementsAre;
 using ::testing::StrEq;
+using ::testing::HasSubstr;
+using ::testing::StartsWith;
 
 class Creation : public testing::Test {
 protected:
@@ -166,6 +184,44 @@ TEST_F(BasicOperations, stream_output) {
 }
 
 
+TEST_F(BasicOperations, stream_output_permuted) {
+    std::stringstream ss;
+    ss << view.permute(2, 0, 1);
+    std::string expected =
+            R"""(TensorView<f, 3> shape: [2, 3, 2], data:
+[[[ 0,  2],
+  [ 4,  6],
+  [ 8, 10]],
+
+ [[ 1,  3],
+  [ 5,  7],
+  [ 9, 11]]]
+)""";
+
+    EXPECT_THAT(ss.str(), StrEq(expected));
+}
+
+TEST_F(BasicOperations, stream_output_summarized) {
+    /* wide elements, which are not shown, do not affect the width */
+    std::vector<int> data(20);
+    std::iota(data.begin(), data.end(), 0);
+    data[10] = 123456;
+    std::stringstream ss;
+    ss << make_view(data.data(), {20});
+    EXPECT_THAT(ss.str(), StrEq("TensorView<i, 1> shape: [20], data:\n[ 0,  1,  2, ..., 17, 18, 19]\n"));
+
+    std::vector<double> large(16 * 3 * 64 * 64, 0.5);
+    large.back() = -1.25;
+    auto view_large = make_view(large.data(), {16, 3, 64, 64});
+    ss.str("");
+    ss << view_large.permute(0, 1, 3, 2);
+    const std::string printed = ss.str();
+    /* line breaks between shown rows, matrices and blocks, plus the header and the last line */
+    EXPECT_THAT(std::count(printed.begin(), printed.end(), '\n'), Eq(2 + 6 * 3 * 6 + 6 * 2 * 2 + 6 * 3));
+    EXPECT_THAT(printed, HasSubstr("[[[[  0.5,   0.5,   0.5, ...,   0.5,   0.5,   0.5],"));
+    EXPECT_THAT(printed, HasSubstr("0.5,   0.5, -1.25]]]]\n"));
+}
+
 TEST_F(BasicOperations, permute) {
     std::vector<float> v_result(12);
     auto view_result = make_view(v_result.data(), {2, 2, 3});
@@ -181,6 +237,59 @@ TEST_F(BasicOperations, permute) {
     EXPECT_THAT(v_result, ElementsAreArray(expected));
 }
 
+TEST_F(BasicOperations, slice) {
+    /* data_ is 0..11 viewed as [3, 2, 2] */
+    auto sliced = view.slice(Range(1), Range(), Range(Range::none, Range::none, -1));
+    EXPECT_THAT(get_size(sliced), ElementsAre(2, 2, 2));
+    EXPECT_THAT(sliced(0, 0, 0), Eq(5));
+    EXPECT_THAT(sliced(1, 1, 1), Eq(10));
+    EXPECT_THAT(sliced.data(), Eq(view.data() + 5));
+
+    auto strided = view.slice(0, -1, -4, -2);
+    EXPECT_THAT(get_size(strided), ElementsAre(2, 2, 2));
+    EXPECT_THAT(strided(1, 0, 1), Eq(1));
+
+    EXPECT_THAT(view.slice(0, 2, 1).size(0), Eq(0));
+    EXPECT_THAT(view.slice(1, -10, 10).size(1), Eq(2));
+    EXPECT_THAT(view.narrow(0, 1, 1)(0, 1, 0), Eq(6));
+    EXPECT_THROW(view.narrow(0, 2, 2), std::runtime_error);
+    EXPECT_THROW(view.slice(0, 0, 3, 0), std::runtime_error);
+}
+
+TEST_F(BasicOperations, flip_with_operations) {
+    auto flipped = view.flip(0).flip(2);
+    EXPECT_THAT(flipped(0, 0, 0), Eq(9));
+
+    std::vector<float> result(12);
+    auto result_view = make_view(result.data(), {3, 2, 2});
+    result_view = flipped * 2.f + view;
+    EXPECT_THAT(result_view(0, 1, 0), Eq(11 * 2 + 2));
+    EXPECT_THAT(flipped.sum(), Eq(66));
+    EXPECT_THAT(view.flip(0).flip(1).flip(2).reduce([](float acc, float x) { return acc * 2 + x; }, 0.f), Eq(
+            std::accumulate(data_.rbegin(), data_.rend(), 0.f, [](float acc, float x) { return acc * 2 + x; })));
+
+    /* crop of a feature map: [:, 2:5, 1:4] */
+    std::vector<float> map(2 * 6 * 6);
+    std::iota(map.begin(), map.end(), 0.f);
+    auto crop = make_view(map.data(), {2, 6, 6}).slice(Range(), Range(2, 5), Range(1, 4));
+    EXPECT_THAT(crop.max(), Eq(36 + 4 * 6 + 3));
+    softmax(crop, crop, 2);
+    EXPECT_THAT(crop.sum(), FloatNear(2 * 3, 1e-5));
+    EXPECT_THAT(map[0], Eq(0));
+}
+
+TEST_F(BasicOperations, contiguous) {
+    auto copy = contiguous(view.permute(2, 0, 1));
+    EXPECT_THAT(copy.is_contiguous(), Eq(true));
+    EXPECT_THAT(get_size(copy), ElementsAre(2, 3, 2));
+    EXPECT_THAT(copy(1, 2, 0), Eq(view(2, 0, 1)));
+
+    /* broadcasted source and transposed destination */
+    std::vector<float> row{1, 2, 3}, result(6);
+    make_view(result.data(), {3, 2}).permute(1, 0).assign_(make_view(row.data(), {3}));
+    EXPECT_THAT(result, ElementsAre(1, 1, 2, 2, 3, 3));
+}
+
 TEST_F(BasicOperations, reverse_permute) {
     auto view_permuted = view.permute(1, 2, 0);
     auto view_double_permuted = view_permuted.permute(2, 0, 1);
@@ -323,6 +432,364 @@ TEST_F(ModifyingData, mul_by_const_permuted) {
     EXPECT_THAT(data2_, ElementsAreArray(expected));
 }
 
+TEST_F(ModifyingData, chained_expression) {
+    std::vector<float> data_result(12);
+    auto view_result = make_view(data_result.data(), {3, 2, 2});
+
+    view_result = (view + view2) * 2 - view;
+
+    std::vector<float> expected = {20, 23, 26, 29, 32, 35, 38, 41, 44, 47, 50, 53};
+    EXPECT_THAT(data_result, ElementsAreArray(expected));
+}
+
+TEST_F(ModifyingData, chained_expression_scalars) {
+    view = 1 + (view2 - 10) / 2.f;
+
+    std::vector<float> expected = {1, 1.5, 2, 2.5, 3, 3.5, 4, 4.5, 5, 5.5, 6, 6.5};
+    EXPECT_THAT(data_, ElementsAreArray(expected));
+}
+
+TEST_F(ModifyingData, chained_expression_broadcasted_permuted) {
+    std::vector<float> data_result(12);
+    auto view_result = make_view(data_result.data(), {2, 2, 3});
+
+    view_result = (view.permute(1, 2, 0) + view2(0).unsqueeze(2)).map([](float x) { return x * x; }) + 1;
+
+    std::vector<float> expected = {101, 197, 325, 145, 257, 401, 197, 325, 485, 257, 401, 577};
+    EXPECT_THAT(data_result, ElementsAreArray(expected));
+}
+
+TEST_F(ModifyingData, stride_zero_rows) {
+    /* per-channel statistics of a [2, 3, 2, 2] image: every row of the traversal has broadcasted operands */
+    std::vector<float> image(2 * 3 * 2 * 2);
+    std::iota(image.begin(), image.end(), 0.f);
+    std::vector<float> mean = {1, 2, 3}, scale = {1, 10, 100}, result(image.size());
+    const size_t shape[] = {2, 3, 2, 2};
+    const size_t channel_stride[] = {0, 1, 0, 0};
+    TensorView<float, 4> image_view(image.data(), shape), result_view(result.data(), shape);
+    TensorView<float, 4> mean_view(mean.data(), shape, channel_stride), scale_view(scale.data(), shape, channel_stride);
+
+    result_view = (image_view - mean_view) * scale_view + 0.5f;
+    EXPECT_THAT(result_view(0, 0, 0, 0), Eq(-0.5f));
+    EXPECT_THAT(result_view(1, 2, 1, 1), Eq((23 - 3) * 100 + 0.5f));
+    image_view -= mean_view;
+    EXPECT_THAT(image_view(1, 1, 1, 0), Eq(16));
+    result_view.assign_(scale_view);
+    EXPECT_THAT(result_view(1, 2, 0, 1), Eq(100));
+
+    /* outer product of a column and a row */
+    std::vector<float> column = {1, 2, 3}, row = {1, -1, 2, 0}, product(3 * 4);
+    make_view(product.data(), {3, 4}) = make_view(column.data(), {3}).unsqueeze(1) * make_view(row.data(), {4});
+    EXPECT_THAT(product, ElementsAre(1, -1, 2, 0, 2, -2, 4, 0, 3, -3, 6, 0));
+}
+
+TEST_F(ModifyingData, inplace_add_expression) {
+    view += view2 * view2(0, 0, 0) - 100;
+
+    std::vector<float> expected = {0, 11, 22, 33, 44, 55, 66, 77, 88, 99, 110, 121};
+    EXPECT_THAT(data_, ElementsAreArray(expected));
+}
+
+TEST_F(ModifyingData, inplace_div_scalar) {
+    view2 /= 2;
+
+    std::vector<float> expected = {5, 5.5, 6, 6.5, 7, 7.5, 8, 8.5, 9, 9.5, 10, 10.5};
+    EXPECT_THAT(data2_, ElementsAreArray(expected));
+}
+
+TEST_F(ModifyingData, coalesced_crop) {
+    /* channels 1..2 of a [2, 4, 3, 5] buffer: the last two dimensions of the crop are mergeable */
+    std::vector<float> buffer(2 * 4 * 3 * 5, -1.f);
+    size_t shape[] = {2, 2, 3, 5};
+    size_t stride[] = {60, 15, 5, 1};
+    TensorView<float, 4> crop(buffer.data() + 15, shape, stride);
+    std::vector<float> bias = {1, 2, 3, 4, 5};
+    auto bias_view = make_view(bias.data(), {5});
+
+    crop.assign_(2.f);
+    crop += bias_view;
+    crop.map_([](float x) { return x * 10; });
+    EXPECT_THAT(crop(1, 1, 2, 4), Eq(70));
+    EXPECT_THAT(crop.sum(), Eq(2 * 2 * 3 * (30 + 40 + 50 + 60 + 70)));
+
+    std::vector<float> dst_data(2 * 2 * 3 * 5);
+    auto dst = make_view(dst_data.data(), {2, 2, 3, 5});
+    dst = crop - bias_view * 10.f;
+    EXPECT_THAT(dst_data, Each(Eq(20)));
+
+    /* elements outside of the crop are not touched */
+    size_t touched = std::count(buffer.begin(), buffer.end(), -1.f);
+    EXPECT_THAT(touched, Eq(buffer.size() / 2));
+    EXPECT_THAT(buffer[14], Eq(-1));
+    EXPECT_THAT(buffer[15], Eq(30));
+}
+
+TEST_F(ModifyingData, coalesced_padded_rows) {
+    /* rows of length 3 padded to 4: nothing is contiguous, outer dimensions are still merged */
+    std::vector<int> buffer(2 * 3 * 4, 0);
+    size_t shape[] = {2, 3, 3};
+    size_t stride[] = {12, 4, 1};
+    TensorView<int, 3> padded(buffer.data(), shape, stride);
+    std::vector<int> data(2 * 3 * 3);
+    std::iota(data.begin(), data.end(), 0);
+    auto src = make_view(data.data(), {2, 3, 3});
+
+    padded.assign_(src);
+    padded.map_(std::multiplies<int>(), src);
+    EXPECT_THAT(padded(1, 2, 2), Eq(17 * 17));
+    EXPECT_THAT(buffer[3], Eq(0));
+    EXPECT_THAT(padded.reduce([](int acc, int x) { return acc * 2 + x % 3; }, 0), Eq(
+            std::accumulate(data.begin(), data.end(), 0, [](int acc, int x) { return acc * 2 + (x * x) % 3; })));
+}
+
+TEST_F(ModifyingData, strided_rows_expression) {
+    /* the innermost dimension is strided for the source and broadcasted for the column */
+    std::vector<int> data(4 * 5), column(5), result(5 * 4);
+    std::iota(data.begin(), data.end(), 0);
+    std::iota(column.begin(), column.end(), 100);
+    auto transposed = make_view(data.data(), {4, 5}).permute(1, 0);
+    auto column_view = make_view(column.data(), {5, 1});
+    auto dst = make_view(result.data(), {5, 4});
+
+    dst = transposed * 2 - column_view;
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            EXPECT_THAT(dst(i, j), Eq(data[j * 5 + i] * 2 - column[i]));
+        }
+    }
+    dst.map_([](int x) { return -x; });
+    EXPECT_THAT(dst(3, 2), Eq(column[3] - data[2 * 5 + 3] * 2));
+}
+
+TEST_F(ModifyingData, empty_permuted_views) {
+    /* empty views which do not coalesce to a single row have no rows to traverse */
+    Tensor<float, 2> a(3, 0), b(0, 3);
+    TensorView<float, 2> bv = b;
+    auto at = a.permute(1, 0);
+    b.assign_(at);
+    bv = at + at;
+    b.permute(1, 0).map_([](float x) { return x + 1; });
+    Tensor<int8_t, 2> q(0, 3);
+    quantize(at, make_quantized(q, 0.5f, 0));
+    dequantize(make_quantized(q, 0.5f, 0), at);
+    EXPECT_THAT(bv.num_elements(), Eq(0u));
+}
+
+/* Base of fixtures which run kernels with every instruction set, restores the default one after each test */
+class IsaSweep : public testing::Test {
+protected:
+    void TearDown() override {
+        simd::set_max_isa(simd::Isa::avx512);
+    }
+
+    static const std::vector<simd::Isa> isas;
+};
+
+const std::vector<simd::Isa> IsaSweep::isas = {simd::Isa::scalar, simd::Isa::sse2, simd::Isa::avx2, simd::Isa::avx512};
+
+template<class T>
+class Kernels : public IsaSweep {
+};
+
+using KernelTypes = ::testing::Types<float, double, int32_t, uint8_t>;
+TYPED_TEST_SUITE(Kernels, KernelTypes);
+
+TYPED_TEST(Kernels, binary_ops) {
+    const size_t n = 203;
+    std::vector<TypeParam> a(n), b(n);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = static_cast<TypeParam>(i % 50 + 1);
+        b[i] = static_cast<TypeParam>((i * 7) % 13 + 1);
+    }
+    auto view_a = make_view(a.data(), {n});
+    auto view_b = make_view(b.data(), {n});
+
+    for (auto isa : this->isas) {
+        simd::set_max_isa(isa);
+        std::vector<TypeParam> result(n);
+        auto view_result = make_view(result.data(), {n});
+
+        view_result.assign_(view_a);
+        view_result.map_(maximum<TypeParam>(), view_b);
+        view_result += view_b;
+        view_result *= 3;
+        view_result -= view_a;
+        view_result /= view_b;
+        for (size_t i = 0; i < n; ++i) {
+            TypeParam expected = static_cast<TypeParam>((std::max(a[i], b[i]) + b[i]) * 3);
+            expected = static_cast<TypeParam>(static_cast<TypeParam>(expected - a[i]) / b[i]);
+            ASSERT_THAT(result[i], Eq(expected)) << "isa " << static_cast<int>(isa) << " index " << i;
+        }
+
+        view_result.assign_(view_a);
+        view_result.map_(std::less<TypeParam>(), view_b);
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_THAT(result[i], Eq(a[i] < b[i] ? 1 : 0)) << "isa " << static_cast<int>(isa) << " index " << i;
+        }
+    }
+}
+
+TYPED_TEST(Kernels, reduce) {
+    const size_t n = 1001;
+    std::vector<TypeParam> a(n);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = static_cast<TypeParam>(i % 7);
+    }
+    a[517] = 42;
+    auto view = make_view(a.data(), {n});
+    TypeParam expected_sum = std::accumulate(a.begin(), a.end(), TypeParam(0));
+
+    for (auto isa : this->isas) {
+        simd::set_max_isa(isa);
+        EXPECT_THAT(view.sum(), Eq(expected_sum)) << "isa " << static_cast<int>(isa);
+        EXPECT_THAT(view.max(), Eq(42)) << "isa " << static_cast<int>(isa);
+        EXPECT_THAT(view.reduce(minimum<TypeParam>(), TypeParam(100)), Eq(0)) << "isa " << static_cast<int>(isa);
+    }
+}
+
+TYPED_TEST(Kernels, transpose_copy) {
+    /* NCHW <-> NHWC with sizes, which are not multiples of vector width or tile size */
+    const size_t n = 2, c = 37, h = 5, w = 7;
+    std::vector<TypeParam> nchw(n * c * h * w);
+    for (size_t i = 0; i < nchw.size(); ++i) {
+        nchw[i] = static_cast<TypeParam>(i % 101);
+    }
+    auto view_nchw = make_view(nchw.data(), {n, c, h, w});
+
+    for (auto isa : this->isas) {
+        simd::set_max_isa(isa);
+        std::vector<TypeParam> nhwc(nchw.size()), back(nchw.size());
+        auto view_nhwc = make_view(nhwc.data(), {n, h, w, c});
+        view_nhwc.assign_(view_nchw.permute(0, 2, 3, 1));
+        for (size_t i = 0; i < nchw.size(); ++i) {
+            size_t x = i % w, y = i / w % h, ch = i / (w * h) % c, b = i / (w * h * c);
+            ASSERT_THAT(nhwc[((b * h + y) * w + x) * c + ch], Eq(nchw[i])) << "isa " << static_cast<int>(isa);
+        }
+
+        make_view(back.data(), {n, c, h, w}).permute(0, 2, 3, 1).assign_(view_nhwc);
+        ASSERT_THAT(back, ElementsAreArray(nchw)) << "isa " << static_cast<int>(isa);
+    }
+}
+
+TYPED_TEST(Kernels, matmul) {
+    /* depth exceeds the block size, a is transposed, dst is column-major */
+    const size_t m = 13, n = 37, k = 300;
+    std::vector<TypeParam> a_transposed(k * m), b(k * n), expected(m * n);
+    for (size_t i = 0; i < a_transposed.size(); ++i) {
+        a_transposed[i] = static_cast<TypeParam>(i % 5);
+    }
+    for (size_t i = 0; i < b.size(); ++i) {
+        b[i] = static_cast<TypeParam>(i % 3);
+    }
+    auto view_a = make_view(a_transposed.data(), {k, m}).permute(1, 0);
+    auto view_b = make_view(b.data(), {k, n});
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            TypeParam sum = 0;
+            for (size_t p = 0; p < k; ++p) {
+                sum = static_cast<TypeParam>(sum + view_a(i, p) * view_b(p, j));
+            }
+            expected[i * n + j] = sum;
+        }
+    }
+
+    for (auto isa : this->isas) {
+        simd::set_max_isa(isa);
+        auto result = matmul(view_a, view_b);
+        ASSERT_THAT(std::vector<TypeParam>(result.data(), result.data() + m * n), ElementsAreArray(expected))
+                << "isa " << static_cast<int>(isa);
+
+        std::vector<TypeParam> column_major(m * n);
+        auto view_result = make_view(column_major.data(), {n, m}).permute(1, 0);
+        matmul(view_a, view_b, view_result);
+        for (size_t i = 0; i < m * n; ++i) {
+            ASSERT_THAT(view_result(i / n, i % n), Eq(expected[i])) << "isa " << static_cast<int>(isa);
+        }
+    }
+}
+
+class Parallel : public testing::Test {
+protected:
+    void SetUp() override {
+        policy.max_threads = 4;
+        policy.min_elements_per_thread = 1;
+
+        data_ = std::vector<float>(4 * 5 * 6);
+        std::iota(data_.begin(), data_.end(), 0);
+        view = make_view(data_.data(), {4, 5, 6});
+    }
+
+    ExecutionPolicy policy;
+    std::vector<float> data_;
+    TensorView<float, 3> view;
+};
+
+TEST_F(Parallel, thread_pool_runs_all_tasks) {
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> counters(100);
+
+    for (int k = 0; k < 10; ++k) {
+        pool.run(counters.size(), [&](size_t i) { ++counters[i]; });
+    }
+
+    EXPECT_THAT(pool.size(), Eq(4));
+    for (auto& counter : counters) {
+        EXPECT_THAT(counter.load(), Eq(10));
+    }
+}
+
+TEST_F(Parallel, thread_pool_nested_run) {
+    ThreadPool pool(3);
+    std::atomic<int> counter{0};
+
+    pool.run(4, [&](size_t i) {
+        pool.run(5, [&](size_t j) { ++counter; });
+    });
+
+    EXPECT_THAT(counter.load(), Eq(20));
+}
+
+TEST_F(Parallel, map_contiguous) {
+    view.map_([](float x) { return x * 2; }, policy);
+
+    for (size_t i = 0; i < data_.size(); ++i) {
+        ASSERT_THAT(data_[i], Eq(2 * i));
+    }
+}
+
+TEST_F(Parallel, assign_permuted) {
+    std::vector<float> result(data_.size());
+    auto view_result = make_view(result.data(), {6, 5, 4});
+
+    view_result.assign_(view.permute(2, 1, 0), policy);
+
+    for (size_t i = 0; i < 4; ++i) {
+        for (size_t j = 0; j < 5; ++j) {
+            for (size_t k = 0; k < 6; ++k) {
+                ASSERT_THAT(view_result(k, j, i), Eq(view(i, j, k)));
+            }
+        }
+    }
+}
+
+TEST_F(Parallel, expression_with_global_policy) {
+    std::vector<float> result(data_.size());
+    auto view_result = make_view(result.data(), {4, 5, 6});
+
+    set_execution_policy(policy);
+    view_result = view * 2 + view(1, 2);
+    view_result.permute(1, 0, 2) -= view.permute(1, 0, 2);
+    set_execution_policy(execution::seq);
+
+    for (size_t i = 0; i < 4; ++i) {
+        for (size_t j = 0; j < 5; ++j) {
+            for (size_t k = 0; k < 6; ++k) {
+                ASSERT_THAT(view_result(i, j, k), Eq(view(i, j, k) + view(1, 2, k)));
+            }
+        }
+    }
+}
+
 class ReduceOperation : public BasicOperations {
 };
 
@@ -344,6 +811,18 @@ TEST_F(ReduceOperation, all_reduce_sum_transposed) {
     EXPECT_THAT(sum, Eq(66));
 }
 
+TEST_F(ReduceOperation, all_reduce_sum_partially_contiguous) {
+    auto sum = view.permute(1, 0, 2).sum();
+
+    EXPECT_THAT(sum, Eq(66));
+}
+
+TEST_F(ReduceOperation, max_negative) {
+    view = view - 12;
+
+    EXPECT_THAT(view.max(), Eq(-1));
+}
+
 TEST_F(ReduceOperation, all_reduce_prod_initial_value) {
     auto view_transposed = view(1, 0);
     auto prod = view_transposed.reduce([&](auto x, auto y) {
@@ -353,6 +832,55 @@ TEST_F(ReduceOperation, all_reduce_prod_initial_value) {
     EXPECT_THAT(prod, Eq(20));
 }
 
+TEST_F(ReduceOperation, all_reduce_non_associative_order) {
+    auto view_transposed = view.permute(2, 1, 0);
+    auto result = view_transposed.reduce([](float x, float y) {
+        return x * 0.5f + y;
+    }, 1.f);
+
+    float expected = 1.f;
+    for (int k = 0; k < 2; ++k)
+        for (int j = 0; j < 2; ++j)
+            for (int i = 0; i < 3; ++i)
+                expected = expected * 0.5f + view(i, j, k);
+    EXPECT_THAT(result, Eq(expected));
+}
+
+TEST_F(ReduceOperation, all_reduce_large_pairwise) {
+    const size_t n = 1 << 22;
+    std::vector<float> data(n, 0.1f);
+    auto large_view = make_view(data.data(), {n});
+
+    float sum = large_view.sum();
+
+    EXPECT_NEAR(sum, n * 0.1, n * 0.1 * 1e-6);
+}
+
+TEST_F(ReduceOperation, all_reduce_deterministic) {
+    const size_t n = 3 * 1000 * 117;
+    std::vector<float> data(n);
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = std::sin(static_cast<float>(i)) * 1000;
+    }
+    auto large_view = make_view(data.data(), {3, 1000, 117}).permute(1, 2, 0);
+    ExecutionPolicy policy;
+    policy.min_elements_per_thread = 1;
+
+    policy.max_threads = 1;
+    float sum_sequential = large_view.sum(policy);
+    float max_sequential = large_view.max(policy);
+    policy.max_threads = 7;
+    float sum_parallel = large_view.sum(policy);
+    float max_parallel = large_view.max(policy);
+
+    double expected_sum = 0;
+    for (auto x : data) expected_sum += x;
+    EXPECT_THAT(sum_parallel, Eq(sum_sequential));
+    EXPECT_THAT(max_parallel, Eq(max_sequential));
+    EXPECT_THAT(max_sequential, Eq(*std::max_element(data.begin(), data.end())));
+    EXPECT_NEAR(sum_sequential, expected_sum, 1.);
+}
+
 template<class T>
 struct Foo {
     template<class K, enable_if_t<is_tensor_view_v<K>, int> = 0>
@@ -419,6 +947,84 @@ TEST_F(ReduceOperation, reduce_axis_min) {
     EXPECT_THAT(dst_data, ElementsAreArray(data_expected));
 }
 
+TEST_F(ReduceOperation, reduce_axis_large_all_axes) {
+    std::vector<float> data(3 * 4 * 20 * 24);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<float>((i * 37) % 101) - 50;
+    }
+    auto src = make_view(data.data(), {3, 4, 20, 24});
+    ExecutionPolicy policy;
+    policy.max_threads = 3;
+    policy.min_elements_per_thread = 1;
+
+    for (size_t axis = 0; axis < 4; ++axis) {
+        std::vector<size_t> shape(src.shape(), src.shape() + 4);
+        shape.erase(shape.begin() + axis);
+        Tensor<float, 3> sum(shape.data()), max(shape.data());
+
+        src.sum(sum, axis, policy);
+        src.max(max, axis);
+
+        for (size_t i = 0; i < shape[0]; ++i) {
+            for (size_t j = 0; j < shape[1]; ++j) {
+                for (size_t k = 0; k < shape[2]; ++k) {
+                    float expected_sum = 0;
+                    float expected_max = std::numeric_limits<float>::lowest();
+                    for (size_t r = 0; r < src.size(axis); ++r) {
+                        size_t index[3] = {i, j, k};
+                        size_t full[4];
+                        for (size_t d = 0, m = 0; d < 4; ++d) {
+                            full[d] = d == axis ? r : index[m++];
+                        }
+                        float x = src(full[0], full[1], full[2], full[3]);
+                        expected_sum += x;
+                        expected_max = std::max(expected_max, x);
+                    }
+                    ASSERT_THAT(sum(i, j, k), Eq(expected_sum)) << "axis " << axis;
+                    ASSERT_THAT(max(i, j, k), Eq(expected_max)) << "axis " << axis;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(ReduceOperation, reduce_axis_permuted_non_associative) {
+    std::vector<float> dst_data(3 * 2);
+    auto dst_view = make_view(dst_data.data(), {3, 2});
+
+    view.permute(1, 0, 2).reduce([](float acc, float x) {
+        return acc * 0.5f + x;
+    }, dst_view.permute(1, 0), 2, 1.f);
+
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            float expected = (0.5f + view(i, j, 0)) * 0.5f + view(i, j, 1);
+            EXPECT_THAT(dst_view(i, j), Eq(expected));
+        }
+    }
+}
+
+TEST_F(ReduceOperation, reduce_axis_empty) {
+    /* no destination elements */
+    Tensor<float, 2> rows(0, 3);
+    Tensor<float, 1> empty(0);
+    rows.sum(empty, 1);
+    rows.max(empty, 1);
+    rows.permute(1, 0).reduce(std::multiplies<float>(), empty, 0, 1.f);
+    Tensor<float, 3> blocks(2, 0, 5);
+    Tensor<float, 2> empty_blocks(2, 0);
+    blocks.sum(empty_blocks, 2);
+    auto empty_blocks_transposed = empty_blocks.permute(1, 0);
+    blocks.permute(2, 1, 0).max(empty_blocks_transposed, 0);
+
+    /* empty reduced axis gives initial values */
+    Tensor<float, 2> columns(4, 0);
+    Tensor<float, 1> sums(4);
+    sums.assign_(-1.f);
+    columns.sum(sums, 1);
+    EXPECT_THAT(std::vector<float>(sums.data(), sums.data() + 4), Each(Eq(0.f)));
+}
+
 TEST_F(ReduceOperation, reduce_axis1_sum_deferred) {
     std::vector<float> dst_data(3 * 2);
     auto dst_view = make_view(dst_data.data(), {3, 2});
@@ -432,6 +1038,1169 @@ TEST_F(ReduceOperation, reduce_axis1_sum_deferred) {
 }
 
 
+/* softmax of src[offset + i * stride], i < n, computed in double precision */
+template<class T>
+std::vector<double> softmax_reference(const std::vector<T>& src, size_t offset, size_t n, size_t stride) {
+    double max_value = src[offset];
+    for (size_t i = 0; i < n; ++i) {
+        max_value = std::max<double>(max_value, src[offset + i * stride]);
+    }
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += std::exp(src[offset + i * stride] - max_value);
+    }
+    std::vector<double> result(n);
+    for (size_t i = 0; i < n; ++i) {
+        result[i] = std::exp(src[offset + i * stride] - max_value) / sum;
+    }
+    return result;
+}
+
+class Softmax : public IsaSweep {
+};
+
+TEST_F(Softmax, exp_kernel) {
+    std::vector<float> x;
+    for (float v = -100.f; v <= 100.f; v += 0.37f) {
+        x.push_back(v);
+    }
+    std::vector<float> result(x.size());
+    std::vector<double> x_double(x.begin(), x.end()), result_double(x.size());
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        detail::exp_scale(x.data(), 0.f, 1.f, result.data(), x.size());
+        detail::exp_scale(x_double.data(), 0., 1., result_double.data(), x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            float expected = std::exp(x[i]);
+            if (x[i] < -87.33f) {
+                EXPECT_THAT(result[i], Eq(0.f));
+            } else if (x[i] > 88.37f) {
+                EXPECT_TRUE(std::isinf(result[i]));
+            } else {
+                EXPECT_THAT(result[i], FloatNear(expected, expected * 4e-7f)) << "x = " << x[i];
+            }
+            EXPECT_THAT(result_double[i], DoubleNear(std::exp(x_double[i]), std::exp(x_double[i]) * 1e-15));
+        }
+    }
+}
+
+TEST_F(Softmax, last_axis) {
+    const size_t rows = 3, n = 2500;
+    std::vector<float> src(rows * n), dst(rows * n), log_dst(rows * n);
+    for (size_t i = 0; i < src.size(); ++i) {
+        /* growing values make running maximum change between chunks */
+        src[i] = static_cast<float>(i % n) * 0.01f + static_cast<float>(i % 13) * 0.5f - 40.f * (i / n);
+    }
+    auto src_view = make_view(src.data(), {rows, n});
+    auto dst_view = make_view(dst.data(), {rows, n});
+    auto log_dst_view = make_view(log_dst.data(), {rows, n});
+
+    softmax(src_view, dst_view, 1);
+    log_softmax(src_view, log_dst_view, 1);
+
+    for (size_t r = 0; r < rows; ++r) {
+        auto expected = softmax_reference(src, r * n, n, 1);
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_THAT(dst_view(r, i), FloatNear(expected[i], 1e-6 * expected[i] + 1e-12));
+            EXPECT_THAT(log_dst_view(r, i), FloatNear(std::log(expected[i]), 1e-4));
+        }
+    }
+}
+
+TEST_F(Softmax, inner_axis) {
+    const size_t a = 2, n = 5, b = 300;
+    std::vector<double> src(a * n * b), dst(a * n * b);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = std::sin(static_cast<double>(i)) * 10;
+    }
+    auto src_view = make_view(src.data(), {a, n, b});
+    auto dst_view = make_view(dst.data(), {a, n, b});
+
+    for (auto isa : {simd::Isa::scalar, simd::Isa::avx512}) {
+        simd::set_max_isa(isa);
+        softmax(src_view, dst_view, 1, execution::par);
+        for (size_t i = 0; i < a; ++i) {
+            for (size_t j = 0; j < b; ++j) {
+                auto expected = softmax_reference(src, i * n * b + j, n, b);
+                for (size_t k = 0; k < n; ++k) {
+                    EXPECT_THAT(dst_view(i, k, j), DoubleNear(expected[k], 1e-14));
+                }
+            }
+        }
+    }
+}
+
+TEST_F(Softmax, very_negative_inputs) {
+    /* exponents far below the smallest normal value are flushed to zero */
+    const size_t n = 37;
+    std::vector<float> src(n), dst(n);
+    std::vector<double> src_double(n), dst_double(n);
+    for (size_t i = 0; i < n; ++i) {
+        src[i] = i == 0 ? 0.f : -100.f * static_cast<float>(i * i);
+        src_double[i] = i == 0 ? 0. : -1000. * static_cast<double>(i * i);
+    }
+    src[n - 1] = std::numeric_limits<float>::lowest();
+    src_double[n - 1] = -std::numeric_limits<double>::infinity();
+    auto dst_view = make_view(dst.data(), {n});
+    auto dst_double_view = make_view(dst_double.data(), {n});
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        softmax(make_view(src.data(), {n}), dst_view, 0);
+        softmax(make_view(src_double.data(), {n}), dst_double_view, 0);
+        EXPECT_THAT(dst[0], Eq(1.f));
+        EXPECT_THAT(dst_double[0], Eq(1.));
+        for (size_t i = 1; i < n; ++i) {
+            ASSERT_THAT(dst[i], Eq(0.f)) << "i = " << i;
+            ASSERT_THAT(dst_double[i], Eq(0.)) << "i = " << i;
+        }
+    }
+}
+
+TEST_F(Softmax, permuted_inplace) {
+    const size_t n = 7, m = 4;
+    std::vector<float> data(n * m);
+    std::iota(data.begin(), data.end(), 0.f);
+    std::vector<float> src = data;
+    auto view = make_view(data.data(), {n, m}).permute(1, 0);
+
+    /* softmax along the original first axis, which is strided */
+    softmax(view, view, 1);
+
+    for (size_t j = 0; j < m; ++j) {
+        auto expected = softmax_reference(src, j, n, m);
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_THAT(view(j, i), FloatNear(expected[i], 1e-6));
+        }
+    }
+}
+
+class HalfPrecision : public IsaSweep {
+};
+
+TEST_F(HalfPrecision, scalar_conversions) {
+    EXPECT_THAT(float16(1.f).bits, Eq(0x3c00));
+    EXPECT_THAT(float16(-2.5f).bits, Eq(0xc100));
+    EXPECT_THAT(float16(65504.f).bits, Eq(0x7bff));
+    EXPECT_THAT(float16(65520.f).bits, Eq(0x7c00));
+    EXPECT_THAT(float16(5.96046448e-8f).bits, Eq(0x0001));
+    /* ties are rounded to even */
+    EXPECT_THAT(float16(1.f + 1.f / 2048).bits, Eq(0x3c00));
+    EXPECT_THAT(float16(1.f + 3.f / 2048).bits, Eq(0x3c02));
+    EXPECT_THAT(static_cast<float>(float16::from_bits(0x0001)), Eq(5.96046448e-8f));
+    EXPECT_TRUE(std::isnan(static_cast<float>(float16(std::nanf("")))));
+
+    EXPECT_THAT(bfloat16(1.f).bits, Eq(0x3f80));
+    EXPECT_THAT(bfloat16(1.f + 1.f / 256).bits, Eq(0x3f80));
+    EXPECT_THAT(bfloat16(1.f + 3.f / 256).bits, Eq(0x3f82));
+    EXPECT_TRUE(std::isnan(static_cast<float>(bfloat16(std::nanf("")))));
+
+    EXPECT_THAT(static_cast<float>(std::numeric_limits<float16>::lowest()), Eq(-65504.f));
+    EXPECT_THAT(print_element(float16(0.333f)), StrEq("0.333"));
+}
+
+TEST_F(HalfPrecision, vectorized_conversions) {
+    /* every finite float16 and bfloat16 value, floats spread over the float16 range and halfway values */
+    std::vector<float16> halfs;
+    std::vector<bfloat16> bfloats;
+    for (uint32_t bits = 0; bits < 0x10000; ++bits) {
+        if ((bits & 0x7c00) != 0x7c00) {
+            halfs.push_back(float16::from_bits(static_cast<uint16_t>(bits)));
+        }
+        if ((bits & 0x7f80) != 0x7f80) {
+            bfloats.push_back(bfloat16::from_bits(static_cast<uint16_t>(bits)));
+        }
+    }
+    std::vector<float> floats;
+    /* subnormal floats, which AVX-512 BF16 instructions flush to zero */
+    for (uint32_t bits = 1; bits < 0x00800000; bits += 997) {
+        floats.push_back(detail::bits_to_float(bits));
+        floats.push_back(-detail::bits_to_float(bits));
+    }
+    for (uint32_t bits = 0x33000000; bits < 0x47800000; bits += 997) {
+        floats.push_back(detail::bits_to_float(bits));
+        floats.push_back(-detail::bits_to_float(bits));
+    }
+    for (size_t i = 0; i + 1 < halfs.size(); ++i) {
+        floats.push_back((static_cast<float>(halfs[i]) + static_cast<float>(halfs[i + 1])) / 2);
+    }
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        std::vector<float> widened(halfs.size());
+        auto widened_view = make_view(widened.data(), {widened.size()});
+        widened_view.assign_(make_view(halfs.data(), {halfs.size()}));
+        std::vector<float16> narrowed(halfs.size());
+        make_view(narrowed.data(), {narrowed.size()}).assign_(widened_view);
+        for (size_t i = 0; i < halfs.size(); ++i) {
+            ASSERT_THAT(widened[i], Eq(detail::half_bits_to_float(halfs[i].bits))) << "isa " << static_cast<int>(isa);
+            ASSERT_THAT(narrowed[i].bits, Eq(halfs[i].bits)) << "isa " << static_cast<int>(isa);
+        }
+
+        std::vector<float> bf_widened(bfloats.size());
+        detail::convert(bfloats.data(), bf_widened.data(), bfloats.size());
+        std::vector<bfloat16> bf_narrowed(bfloats.size());
+        detail::convert(bf_widened.data(), bf_narrowed.data(), bfloats.size());
+        for (size_t i = 0; i < bfloats.size(); ++i) {
+            ASSERT_THAT(bf_narrowed[i].bits, Eq(bfloats[i].bits)) << "isa " << static_cast<int>(isa);
+        }
+
+        std::vector<float16> rounded(floats.size());
+        std::vector<bfloat16> bf_rounded(floats.size());
+        detail::convert(floats.data(), rounded.data(), floats.size());
+        detail::convert(floats.data(), bf_rounded.data(), floats.size());
+        for (size_t i = 0; i < floats.size(); ++i) {
+            ASSERT_THAT(rounded[i].bits, Eq(float16(floats[i]).bits)) << "isa " << static_cast<int>(isa);
+            ASSERT_THAT(bf_rounded[i].bits, Eq(bfloat16(floats[i]).bits)) << "isa " << static_cast<int>(isa);
+        }
+    }
+}
+
+TEST_F(HalfPrecision, reductions_accumulate_in_float) {
+    /* accumulating in float16 would stop at 2048 */
+    const size_t rows = 10, n = 10000;
+    Tensor<float16, 2> ones(rows, n);
+    ones.assign_(float16(1.f));
+    Tensor<bfloat16, 2> bf_ones(rows, n);
+    bf_ones.assign_(bfloat16(1.f));
+    ones(3, 7) = float16(2.f);
+
+    for (auto isa : {simd::Isa::scalar, simd::Isa::avx512}) {
+        simd::set_max_isa(isa);
+        EXPECT_THAT(static_cast<float>(ones.at(0).sum()), Eq(10000.f));
+        EXPECT_THAT(static_cast<float>(ones.permute(1, 0).at(5).sum()), Eq(10.f));
+        EXPECT_THAT(static_cast<float>(bf_ones.at(0).sum()), Eq(9984.f)); // 10000 rounded to bfloat16
+        EXPECT_THAT(static_cast<float>(ones.max()), Eq(2.f));
+
+        Tensor<float16, 1> row_sums(rows);
+        ones.sum(row_sums, 1);
+        EXPECT_THAT(static_cast<float>(row_sums(0)), Eq(10000.f));
+        EXPECT_THAT(static_cast<float>(row_sums(3)), Eq(10000.f)); // 10001 rounded to float16
+
+        Tensor<float16, 1> column_sums(n);
+        ones.sum(column_sums, 0);
+        EXPECT_THAT(static_cast<float>(column_sums(7)), Eq(11.f));
+
+        Tensor<float16, 2> tall_ones(3000, 4);
+        tall_ones.assign_(float16(1.f));
+        Tensor<float16, 1> tall_sums(4);
+        tall_ones.sum(tall_sums, 0);
+        EXPECT_THAT(static_cast<float>(tall_sums(2)), Eq(3000.f));
+    }
+}
+
+TEST_F(HalfPrecision, softmax) {
+    const size_t rows = 4, n = 300;
+    std::vector<float> src(rows * n);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = std::sin(static_cast<float>(i)) * 8;
+    }
+    std::vector<float16> half_src(src.begin(), src.end()), half_dst(src.size()), half_transposed(src.size());
+    std::vector<float> exact_src(half_src.begin(), half_src.end());
+    auto src_view = make_view(half_src.data(), {rows, n});
+    auto dst_view = make_view(half_dst.data(), {rows, n});
+    auto transposed_view = make_view(half_transposed.data(), {n, rows}).permute(1, 0);
+
+    softmax(src_view, dst_view, 1);
+    softmax(src_view, transposed_view, 1);
+    for (size_t r = 0; r < rows; ++r) {
+        auto expected = softmax_reference(exact_src, r * n, n, 1);
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_THAT(static_cast<float>(dst_view(r, i)), FloatNear(expected[i], expected[i] * 1e-3 + 6e-8));
+            ASSERT_THAT(static_cast<float>(transposed_view(r, i)), FloatNear(expected[i], expected[i] * 1e-3 + 6e-8));
+        }
+    }
+}
+
+
+class Quantization : public IsaSweep {
+protected:
+    template<class T>
+    static T reference_quantize(float x, float scale, int32_t zero_point) {
+        const float q = std::nearbyint(x * (1.f / scale)) + static_cast<float>(zero_point);
+        const float lo = std::numeric_limits<T>::min();
+        const float hi = std::numeric_limits<T>::max();
+        return static_cast<T>(std::min(std::max(q, lo), hi));
+    }
+};
+
+TEST_F(Quantization, quantize_dequantize) {
+    const size_t rows = 3, n = 1000;
+    std::vector<float> src(rows * n);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = std::sin(static_cast<float>(i)) * 40;
+    }
+    /* ties are rounded to even, out of range values and NaN are clamped */
+    src[0] = 2.5f;
+    src[1] = -2.5f;
+    src[2] = 1e10f;
+    src[3] = -1e10f;
+    src[4] = std::nanf("");
+    auto src_view = make_view(src.data(), {rows, n});
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        Tensor<int8_t, 2> q(rows, n);
+        auto q_view = make_quantized(q, 0.25f, -3);
+        quantize(src_view, q_view);
+        EXPECT_THAT(q(0, 0), Eq(-3 + 10));
+        EXPECT_THAT(q(0, 1), Eq(-3 - 10));
+        EXPECT_THAT(q(0, 4), Eq(-128));
+        for (size_t i = 2; i < src.size(); ++i) {
+            if (i != 4) {
+                ASSERT_THAT(q.data()[i], Eq(reference_quantize<int8_t>(src[i], 0.25f, -3)))
+                                        << "isa " << static_cast<int>(isa);
+            }
+        }
+        auto x = dequantize(q_view);
+        for (size_t i = 5; i < src.size(); ++i) {
+            ASSERT_THAT(x.data()[i], Eq((q.data()[i] + 3) * 0.25f)) << "isa " << static_cast<int>(isa);
+        }
+
+        /* transposed uint8 destination and a broadcasted row of src */
+        Tensor<uint8_t, 2> transposed(n, rows);
+        auto t_view = make_quantized(transposed.permute(1, 0), 0.5f, 128);
+        quantize(src_view.at(1), t_view);
+        Tensor<float, 2> y(rows, n);
+        dequantize(t_view, y);
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_THAT(transposed(i, 2), Eq(reference_quantize<uint8_t>(src[n + i], 0.5f, 128)));
+            ASSERT_THAT(y(0, i), Eq((transposed(i, 0) - 128) * 0.5f));
+        }
+    }
+    Tensor<int8_t, 1> q(4);
+    EXPECT_THROW(make_quantized(q, 1.f, 200), std::runtime_error);
+}
+
+TEST_F(Quantization, per_axis) {
+    /* weights 4 x 70 with a scale per row and per column */
+    const size_t rows = 4, cols = 70;
+    std::vector<float> src(rows * cols);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = std::cos(static_cast<float>(i)) * static_cast<float>(i / cols + 1);
+    }
+    std::vector<float> row_scales{0.01f, 0.02f, 0.03f, 0.04f};
+    std::vector<int32_t> row_zero_points{0, 10, -10, 5};
+    std::vector<float> col_scales(cols);
+    for (size_t j = 0; j < cols; ++j) {
+        col_scales[j] = 0.01f + 0.001f * j;
+    }
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        Tensor<int8_t, 2> by_rows(rows, cols), by_cols(rows, cols);
+        auto rows_view = make_quantized(by_rows, row_scales.data(), row_zero_points.data(), 0);
+        auto cols_view = make_quantized(by_cols, col_scales.data(), nullptr, 1);
+        quantize(make_view(src.data(), {rows, cols}), rows_view);
+        quantize(make_view(src.data(), {rows, cols}), cols_view);
+        auto x = dequantize(rows_view);
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                const float v = src[i * cols + j];
+                ASSERT_THAT(by_rows(i, j), Eq(reference_quantize<int8_t>(v, row_scales[i], row_zero_points[i])));
+                ASSERT_THAT(by_cols(i, j), Eq(reference_quantize<int8_t>(v, col_scales[j], 0)));
+                ASSERT_THAT(x(i, j), Eq((by_rows(i, j) - row_zero_points[i]) * row_scales[i]));
+            }
+        }
+
+        /* requantization to per-tensor parameters */
+        Tensor<uint8_t, 2> requantized(rows, cols);
+        requantize(cols_view, make_quantized(requantized, 0.05f, 100));
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                ASSERT_THAT(requantized(i, j),
+                            Eq(reference_quantize<uint8_t>(by_cols(i, j) * col_scales[j], 0.05f, 100)));
+            }
+        }
+    }
+}
+
+TEST_F(Quantization, element_wise) {
+    /* 2 x 3 x 50 plus a broadcasted 50-element row, the sum and the product are rounded to dst parameters */
+    const size_t n = 50;
+    Tensor<int8_t, 3> a(2, 3, n);
+    Tensor<uint8_t, 1> b(n);
+    for (size_t i = 0; i < a.num_elements(); ++i) {
+        a.data()[i] = static_cast<int8_t>(static_cast<int>(i * 37 % 256) - 128);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        b.data()[i] = static_cast<uint8_t>(i * 5);
+    }
+    auto qa = make_quantized(a, 0.1f, 3);
+    auto qb = make_quantized(b, 0.05f, 120);
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        Tensor<int8_t, 3> sum(2, 3, n);
+        Tensor<int8_t, 3> product(2, n, 3);
+        auto product_view = make_quantized(product.permute(0, 2, 1), 0.2f, -1);
+        add(qa, qb, make_quantized(sum, 0.15f, 0));
+        mul(qa, qb, product_view);
+        for (size_t i = 0; i < 2; ++i) {
+            for (size_t c = 0; c < 3; ++c) {
+                for (size_t j = 0; j < n; ++j) {
+                    const float x = (a(i, c, j) - 3) * 0.1f;
+                    const float y = (b(j) - 120) * 0.05f;
+                    ASSERT_THAT(sum(i, c, j), Eq(reference_quantize<int8_t>(x + y, 0.15f, 0)));
+                    ASSERT_THAT(product(i, j, c), Eq(reference_quantize<int8_t>(x * y, 0.2f, -1)));
+                }
+            }
+        }
+    }
+    Tensor<int8_t, 1> other(n + 1);
+    EXPECT_THROW(add(qa, make_quantized(other, 1.f, 0), make_quantized(a, 1.f, 0)), std::runtime_error);
+}
+
+TEST_F(Quantization, matmul_and_dot) {
+    /* 37 x 300 activations (uint8) times 300 x 45 weights (int8, a scale per output column) */
+    const size_t m = 37, k = 300, n = 45;
+    Tensor<uint8_t, 2> a(m, k);
+    Tensor<int8_t, 2> w(n, k);
+    for (size_t i = 0; i < a.num_elements(); ++i) {
+        a.data()[i] = static_cast<uint8_t>(i * 7 % 256);
+    }
+    for (size_t i = 0; i < w.num_elements(); ++i) {
+        w.data()[i] = static_cast<int8_t>(static_cast<int>(i * 13 % 255) - 127);
+    }
+    std::vector<float> scales(n);
+    for (size_t j = 0; j < n; ++j) {
+        scales[j] = 0.001f * (j + 1);
+    }
+    auto qa = make_quantized(a, 0.02f, 128);
+    auto qw = make_quantized(w.permute(1, 0), scales.data(), nullptr, 1);
+
+    std::vector<int32_t> expected(m * n, 0);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t p = 0; p < k; ++p) {
+                expected[i * n + j] += (a(i, p) - 128) * w(j, p);
+            }
+        }
+    }
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        Tensor<int32_t, 2> accumulators(m, n);
+        matmul(qa, qw, accumulators);
+        ASSERT_THAT(std::vector<int32_t>(accumulators.data(), accumulators.data() + m * n),
+                    ElementsAreArray(expected)) << "isa " << static_cast<int>(isa);
+
+        Tensor<int8_t, 2> result(m, n);
+        matmul(qa, qw, make_quantized(result, 0.5f, 10));
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                const float real = static_cast<float>(expected[i * n + j]) * (0.02f * scales[j]);
+                ASSERT_THAT(result(i, j), Eq(reference_quantize<int8_t>(real, 0.5f, 10)));
+            }
+        }
+
+        /* contiguous and strided 1-D views */
+        EXPECT_THAT(dot(make_quantized(a.at(5), 0.02f, 128), make_quantized(w.at(7), 1.f, 0)),
+                    Eq(expected[5 * n + 7]));
+        int32_t columns_dot = 0;
+        for (size_t i = 0; i < m; ++i) {
+            columns_dot += (a(i, 0) - 128) * (a(i, 1) - 2);
+        }
+        EXPECT_THAT(dot(make_quantized(a.permute(1, 0).at(0), 1.f, 128), make_quantized(a.permute(1, 0).at(1), 1.f, 2)),
+                    Eq(columns_dot));
+    }
+}
+
+TEST_F(Quantization, dot_wraps) {
+    /* uint8 terms of 255 * 255 overflow int32 after 33025 elements, the sum wraps modulo 2^32 */
+    const size_t n = 40001;
+    std::vector<uint8_t> a(n, 255);
+    const int64_t exact = static_cast<int64_t>(n) * 255 * 255;
+    const int32_t wrapped = static_cast<int32_t>(static_cast<uint32_t>(exact));
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        auto qa = make_quantized(make_view(a.data(), {n}), 1.f, 0);
+        EXPECT_THAT(dot(qa, qa), Eq(wrapped)) << "isa " << static_cast<int>(isa);
+        auto first = make_quantized(make_view(a.data(), {33025}), 1.f, 0);
+        EXPECT_THAT(dot(first, first), Eq(33025 * 255 * 255)) << "isa " << static_cast<int>(isa);
+    }
+}
+
+
+class StaticTensorViewTest : public testing::Test {
+protected:
+    using Boxes = StaticTensorView<float, Extents<80, 4>>;
+
+    void SetUp() override {
+        data.resize(Boxes::num_elements());
+        std::iota(data.begin(), data.end(), 0.f);
+    }
+
+    std::vector<float> data;
+};
+
+TEST_F(StaticTensorViewTest, compile_time_layout) {
+    static_assert(sizeof(Boxes) == sizeof(float*), "static view stores only the data pointer");
+    static_assert(Extents<80, 4>::offset(3, 2) == 14, "");
+    static_assert(Extents<2, 3, 4>::offset(1, 2, 3) == 23, "");
+    static_assert(Extents<2, 3, 4>::strides()[0] == 12 && Extents<2, 3, 4>::strides()[1] == 4, "");
+    static_assert(Boxes::num_elements() == 320 && Boxes::size(1) == 4, "");
+    static_assert(is_tensor_view<Boxes>::value, "");
+
+    Boxes boxes(data.data());
+    EXPECT_THAT(std::vector<size_t>(boxes.shape(), boxes.shape() + 2), ElementsAre(80, 4));
+    EXPECT_THAT(std::vector<size_t>(boxes.stride(), boxes.stride() + 2), ElementsAre(4, 1));
+    EXPECT_TRUE(Boxes().empty());
+}
+
+TEST_F(StaticTensorViewTest, element_access) {
+    Boxes boxes(data.data());
+    TensorView<float, 2> dynamic = boxes;
+    for (size_t i = 0; i < 80; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            ASSERT_THAT(&boxes(i, j), Eq(&dynamic(i, j)));
+        }
+    }
+    /* sub-views keep static extents */
+    auto box = boxes(7);
+    static_assert(std::is_same<decltype(box), StaticTensorView<float, Extents<4>>>::value, "");
+    EXPECT_THAT(box.data(), Eq(data.data() + 28));
+    box(2) = -1.f;
+    EXPECT_THAT(data[30], Eq(-1.f));
+
+    StaticTensorView<float, Extents<2, 4, 10>> blocks(data.data());
+    EXPECT_THAT(blocks(1, 2).data(), Eq(data.data() + 60));
+    EXPECT_THAT(blocks(1, 2, 3), Eq(63.f));
+}
+
+TEST_F(StaticTensorViewTest, interoperability) {
+    Boxes boxes(data.data());
+    Tensor<float, 2> doubled(80, 4);
+    doubled.assign_(boxes + boxes);
+    EXPECT_THAT(doubled(5, 3), Eq(46.f));
+    EXPECT_THAT(boxes.sum(), Eq(320.f * 319.f / 2));
+    EXPECT_THAT(boxes.max(), Eq(319.f));
+
+    boxes.assign_(doubled * 0.5f);
+    EXPECT_THAT(boxes(5, 3), Eq(23.f));
+
+    /* deferred operations and in-place operators */
+    boxes = doubled.map([](float x) { return x + 1.f; });
+    EXPECT_THAT(boxes(5, 3), Eq(47.f));
+    boxes -= doubled;
+    boxes *= 2.f;
+    EXPECT_THAT(boxes(5, 3), Eq(2.f));
+    boxes += doubled * 0.5f;
+    boxes /= 5.f;
+    EXPECT_THAT(boxes(5, 3), Eq(5.f));
+    Tensor<float, 2> twos(80, 4);
+    twos.assign_(2.f);
+    boxes /= twos;
+    EXPECT_THAT(boxes(5, 3), Eq(2.5f));
+
+    std::vector<float> row_sums_data(80);
+    StaticTensorView<float, Extents<80>> row_sums(row_sums_data.data());
+    boxes.reduce(std::plus<float>(), row_sums, 1);
+    Tensor<float, 1> expected_sums(80);
+    expected_sums.assign_(boxes.view().reduce(std::plus<float>(), 1, 0.f));
+    EXPECT_THAT(row_sums_data, ElementsAreArray(expected_sums.data(), 80));
+    row_sums = boxes.reduce(std::plus<float>(), 1, 0.f);
+    EXPECT_THAT(row_sums_data, ElementsAreArray(expected_sums.data(), 80));
+    EXPECT_THAT(boxes.reduce(std::plus<float>()), Eq(boxes.sum()));
+    std::iota(data.begin(), data.end(), 0.f);
+
+    std::vector<float> logits_data(80);
+    StaticTensorView<float, Extents<1, 80>> logits(logits_data.data());
+    logits.map_([](float) { return 1.f; });
+    softmax(logits, logits, 1);
+    EXPECT_THAT(logits(0, 79), FloatNear(1.f / 80, 1e-6f));
+
+    StaticTensorView<float, Extents<4, 4>> square(data.data());
+    Tensor<float, 2> product(4, 4);
+    matmul(square, StaticTensorView<float, Extents<4, 4>>(data.data()), product);
+    EXPECT_THAT(product(1, 2), Eq(4.f * 2 + 5.f * 6 + 6.f * 10 + 7.f * 14));
+
+    std::stringstream expected, actual;
+    expected << square.view();
+    actual << square;
+    EXPECT_THAT(actual.str(), Eq(expected.str()));
+
+    /* checked conversion from dynamic views */
+    EXPECT_THAT(Boxes(doubled).data(), Eq(doubled.data()));
+    EXPECT_THROW(Boxes(doubled.narrow(0, 0, 40)), std::runtime_error);
+    Tensor<float, 2> transposed(4, 80);
+    EXPECT_THROW(Boxes(transposed.permute(1, 0)), std::runtime_error);
+}
+
+
+class WorkspaceTest : public testing::Test {
+};
+
+TEST_F(WorkspaceTest, bump_allocation) {
+    Workspace workspace(1024);
+    auto a = static_cast<char*>(workspace.allocate(10));
+    auto b = static_cast<char*>(workspace.allocate(100, 4));
+    EXPECT_THAT(reinterpret_cast<uintptr_t>(a) % Workspace::alignment, Eq(0));
+    EXPECT_THAT(b, Eq(a + 12));
+    EXPECT_THAT(workspace.used(), Eq(112));
+
+    /* only the last allocation is given back immediately */
+    workspace.deallocate(a, 10);
+    EXPECT_THAT(workspace.used(), Eq(112));
+    workspace.deallocate(b, 100);
+    EXPECT_THAT(workspace.used(), Eq(12));
+    EXPECT_THAT(workspace.high_water_mark(), Eq(112));
+}
+
+TEST_F(WorkspaceTest, scope_and_reset) {
+    Workspace workspace(1000);
+    workspace.allocate(100);
+    {
+        WorkspaceScope scope(workspace);
+        workspace.allocate(800);
+        workspace.allocate(5000);
+        EXPECT_THAT(workspace.num_blocks(), Eq(2));
+    }
+    EXPECT_THAT(workspace.used(), Eq(100));
+
+    workspace.reset();
+    EXPECT_THAT(workspace.used(), Eq(0));
+    EXPECT_THAT(workspace.num_blocks(), Eq(1));
+    size_t capacity = workspace.capacity();
+    EXPECT_THAT(capacity, Ge(workspace.high_water_mark()));
+
+    /* the same workload fits into the merged block */
+    workspace.allocate(100);
+    workspace.allocate(800);
+    workspace.allocate(5000);
+    EXPECT_THAT(workspace.num_blocks(), Eq(1));
+    EXPECT_THAT(workspace.capacity(), Eq(capacity));
+}
+
+TEST_F(WorkspaceTest, tensor) {
+    auto& workspace = Workspace::local();
+    size_t marker = workspace.marker();
+    {
+        WorkspaceScope scope;
+        WorkspaceTensor<float, 2> a(uninitialized, 100, 50);
+        WorkspaceTensor<float, 1> b(50);
+        EXPECT_THAT(reinterpret_cast<uintptr_t>(a.data()) % 64, Eq(0));
+        EXPECT_THAT(workspace.used(), Ge(marker + 5050 * sizeof(float)));
+
+        a.assign_(1.f);
+        a.sum(b, 0);
+        EXPECT_THAT(b(7), Eq(100));
+    }
+    EXPECT_THAT(workspace.marker(), Eq(marker));
+
+    Workspace* other = nullptr;
+    std::thread([&] { other = &Workspace::local(); }).join();
+    EXPECT_THAT(other, Ne(&workspace));
+}
+
+
+class MatMulTest : public IsaSweep {
+};
+
+TEST_F(MatMulTest, batched_broadcast) {
+    /* batch of 2 x 3 matrices times a single 3 x 2 matrix */
+    std::vector<float> a(4 * 2 * 3), b{1, 0, 0, 1, 1, 1};
+    std::iota(a.begin(), a.end(), 0.f);
+    auto batch = make_view(a.data(), {4, 2, 3});
+    auto matrix = make_view(b.data(), {3, 2});
+
+    ExecutionPolicy policy;
+    policy.max_threads = 4;
+    policy.min_elements_per_thread = 1;
+    auto result = matmul(batch, matrix, policy);
+    EXPECT_THAT(get_size(result), ElementsAre(4, 2, 2));
+    for (size_t i = 0; i < 4 * 2; ++i) {
+        EXPECT_THAT(result(i / 2, i % 2, 0), Eq(a[i * 3] + a[i * 3 + 2]));
+        EXPECT_THAT(result(i / 2, i % 2, 1), Eq(a[i * 3 + 1] + a[i * 3 + 2]));
+    }
+
+    /* single matrix times a batch of size 1, broadcasted to the batch of dst */
+    Tensor<float, 3> dst(3, 2, 2);
+    matmul(make_view(a.data(), {2, 3}), make_view(b.data(), {1, 3, 2}), dst);
+    EXPECT_THAT(dst(2, 1, 0), Eq(3 + 5));
+
+    EXPECT_THROW(matmul(batch, make_view(b.data(), {2, 3})), std::runtime_error);
+    EXPECT_THROW(matmul(batch, make_view(a.data(), {3, 2, 2})), std::runtime_error);
+}
+
+TEST_F(MatMulTest, blocked_permuted) {
+    /* sizes above the mc, nc and kc blocks and not multiples of the micro-kernel tile */
+    const size_t m = 131, n = 530, k = 300;
+    std::vector<float> a(k * m), b(n * k), c(n * (m + 3));
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = static_cast<float>(i % 5) - 2;
+    }
+    for (size_t i = 0; i < b.size(); ++i) {
+        b[i] = static_cast<float>(i % 7) - 3;
+    }
+    /* a and b are transposed, dst is transposed and narrowed */
+    auto a_view = make_view(a.data(), {k, m}).permute(1, 0);
+    auto b_view = make_view(b.data(), {n, k}).permute(1, 0);
+    auto c_view = make_view(c.data(), {n, m + 3}).narrow(1, 0, m).permute(1, 0);
+
+    /* small integers, so that the sums are exact in any order */
+    std::vector<float> expected(m * n, 0.f);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t p = 0; p < k; ++p) {
+                expected[i * n + j] += a[p * m + i] * b[j * k + p];
+            }
+        }
+    }
+
+    for (auto isa : isas) {
+        simd::set_max_isa(isa);
+        std::fill(c.begin(), c.end(), -1.f);
+        matmul(a_view, b_view, c_view);
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                ASSERT_THAT(c_view(i, j), Eq(expected[i * n + j]))
+                        << "isa " << static_cast<int>(isa) << ", i = " << i << ", j = " << j;
+            }
+        }
+        /* padding columns of dst are untouched */
+        for (size_t j = 0; j < n; ++j) {
+            ASSERT_THAT(c[j * (m + 3) + m], Eq(-1.f));
+        }
+    }
+}
+
+class EinsumTest : public testing::Test {
+protected:
+    void SetUp() override {
+        for (size_t i = 0; i < q.size(); ++i) {
+            q[i] = static_cast<float>(i % 7) - 3;
+            k[i] = static_cast<float>(i % 5) - 2;
+        }
+    }
+
+    /* batch, heads, queries / keys, depth */
+    const size_t b = 2, h = 3, n = 5, d = 4;
+    std::vector<float> q = std::vector<float>(b * h * n * d);
+    std::vector<float> k = std::vector<float>(b * h * n * d);
+};
+
+TEST_F(EinsumTest, attention_scores) {
+    auto view_q = make_view(q.data(), {b, h, n, d});
+    auto view_k = make_view(k.data(), {b, h, n, d});
+    auto scores = einsum<4>("bhqd,bhkd->bhqk", view_q, view_k);
+    EXPECT_THAT(get_size(scores), ElementsAre(b, h, n, n));
+    for (size_t i = 0; i < b * h * n * n; ++i) {
+        size_t kk = i % n, qq = i / n % n, bh = i / (n * n);
+        float expected = 0;
+        for (size_t j = 0; j < d; ++j) {
+            expected += q[(bh * n + qq) * d + j] * k[(bh * n + kk) * d + j];
+        }
+        ASSERT_THAT(scores.data()[i], Eq(expected));
+    }
+
+    /* output with permuted dims, q laid out as (b, q, h, d) */
+    std::vector<float> q_bnhd(q.size()), permuted(b * n * h * n);
+    make_view(q_bnhd.data(), {b, n, h, d}).permute(0, 2, 1, 3).assign_(view_q);
+    auto view_permuted = make_view(permuted.data(), {b, n, h, n});
+    einsum(view_permuted, "bqhd,bhkd->bqhk", make_view(q_bnhd.data(), {b, n, h, d}), view_k);
+    EXPECT_THAT(view_permuted(1, 3, 2, 4), Eq(scores(1, 2, 3, 4)));
+}
+
+TEST_F(EinsumTest, strided_and_chains) {
+    std::vector<float> m(4 * 4), v{1, 2, 3, 4};
+    std::iota(m.begin(), m.end(), 0.f);
+    auto matrix = make_view(m.data(), {4, 4});
+    auto vector = make_view(v.data(), {4});
+
+    /* diagonal, transpose, reduction over a single operand and implicit output */
+    EXPECT_THAT(einsum<1>("ii->i", matrix)(2), Eq(10));
+    EXPECT_THAT(einsum<2>("ij->ji", matrix)(1, 3), Eq(13));
+    EXPECT_THAT(einsum<1>("ij->j", matrix)(1), Eq(1 + 5 + 9 + 13));
+    EXPECT_THAT(einsum<2>("ji,jk", matrix, matrix)(1, 2), Eq(1 * 2 + 5 * 6 + 9 * 10 + 13 * 14));
+    /* a label summed over a single operand */
+    EXPECT_THAT(einsum<1>("ij,j->j", matrix, vector)(3), Eq((3 + 7 + 11 + 15) * 4));
+
+    /* v^T M M v with three operands */
+    auto chain = einsum<1>("i,ij,jk,k->i", vector, matrix, matrix, vector);
+    auto mv = einsum<1>("jk,k->j", matrix, vector);
+    auto mmv = einsum<1>("ij,j->i", matrix, mv);
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_THAT(chain(i), Eq(v[i] * mmv(i)));
+    }
+
+    auto dot = tensordot(make_view(q.data(), {b, h, n, d}), make_view(k.data(), {b, h, n, d}), {1, 3}, {1, 3});
+    EXPECT_THAT(get_size(dot), ElementsAre(b, n, b, n));
+    auto expected = einsum<4>("ahpd,bhqd->apbq", make_view(q.data(), {b, h, n, d}), make_view(k.data(), {b, h, n, d}));
+    EXPECT_THAT(dot(1, 2, 0, 4), Eq(expected(1, 2, 0, 4)));
+
+    EXPECT_THROW(einsum<2>("ij,jk->ik", matrix, make_view(v.data(), {2, 2})), std::runtime_error);
+    EXPECT_THROW(einsum<2>("ij,jk->il", matrix, matrix), std::runtime_error);
+}
+
+class ConvTest : public testing::Test {
+protected:
+    /* dst = conv2d(input, weight) + bias by definition */
+    static std::vector<double> naive_conv2d(const std::vector<double>& input, const std::vector<double>& weight,
+                                            const std::vector<double>& bias, const size_t (&in)[4],
+                                            const size_t (&w)[4], const Conv2dParams& p, size_t oh, size_t ow) {
+        std::vector<double> dst(in[0] * w[0] * oh * ow);
+        const size_t group_filters = w[0] / p.groups;
+        for (size_t n = 0; n < in[0]; ++n)
+            for (size_t o = 0; o < w[0]; ++o)
+                for (size_t y = 0; y < oh; ++y)
+                    for (size_t x = 0; x < ow; ++x) {
+                        double sum = bias.empty() ? 0 : bias[o];
+                        for (size_t c = 0; c < w[1]; ++c)
+                            for (size_t i = 0; i < w[2]; ++i)
+                                for (size_t j = 0; j < w[3]; ++j) {
+                                    ptrdiff_t h = ptrdiff_t(y * p.stride[0] + i * p.dilation[0]) - ptrdiff_t(p.padding[0]);
+                                    ptrdiff_t v = ptrdiff_t(x * p.stride[1] + j * p.dilation[1]) - ptrdiff_t(p.padding[1]);
+                                    if (h < 0 || v < 0 || h >= ptrdiff_t(in[2]) || v >= ptrdiff_t(in[3])) {
+                                        continue;
+                                    }
+                                    size_t channel = o / group_filters * w[1] + c;
+                                    sum += input[((n * in[1] + channel) * in[2] + h) * in[3] + v] *
+                                           weight[((o * w[1] + c) * w[2] + i) * w[3] + j];
+                                }
+                        dst[((n * w[0] + o) * oh + y) * ow + x] = sum;
+                    }
+        return dst;
+    }
+
+    static size_t count(const size_t (&dims)[4]) {
+        return dims[0] * dims[1] * dims[2] * dims[3];
+    }
+
+    static std::vector<double> values(size_t n, size_t seed) {
+        std::vector<double> result(n);
+        for (size_t i = 0; i < n; ++i) {
+            result[i] = static_cast<double>((i * seed + 3) % 11) - 5;
+        }
+        return result;
+    }
+};
+
+TEST_F(ConvTest, grouped_strided_padded) {
+    const size_t in[] = {2, 6, 9, 11};
+    const size_t w[] = {4, 3, 3, 2};
+    Conv2dParams params;
+    params.stride[0] = 2;
+    params.padding[0] = 1;
+    params.padding[1] = 2;
+    params.dilation[1] = 2;
+    params.groups = 2;
+    const size_t oh = conv_output_size(in[2], w[2], 2, 1), ow = conv_output_size(in[3], w[3], 1, 2, 2);
+    EXPECT_THAT(oh, Eq(5));
+    EXPECT_THAT(ow, Eq(13));
+
+    auto input = values(count(in), 7), weight = values(count(w), 5), bias = values(4, 3);
+    auto expected = naive_conv2d(input, weight, bias, in, w, params, oh, ow);
+    Tensor<double, 4> dst(in[0], w[0], oh, ow);
+    conv2d(TensorView<double, 4>(input.data(), in), TensorView<double, 4>(weight.data(), w),
+           make_view(bias.data(), {4}), dst, params);
+    EXPECT_THAT(std::vector<double>(dst.data(), dst.data() + dst.num_elements()), ElementsAreArray(expected));
+
+    /* NHWC input and output viewed as NCHW, pointwise convolution */
+    const size_t pointwise[] = {4, 6, 1, 1};
+    std::vector<double> nhwc_input(input.size()), nhwc_dst(in[0] * 4 * in[2] * in[3]);
+    make_view(nhwc_input.data(), {in[0], in[2], in[3], in[1]}).permute(0, 3, 1, 2)
+            .assign_(TensorView<double, 4>(input.data(), in));
+    auto nchw_dst = make_view(nhwc_dst.data(), {in[0], in[2], in[3], size_t(4)}).permute(0, 3, 1, 2);
+    conv2d(make_view(nhwc_input.data(), {in[0], in[2], in[3], in[1]}).permute(0, 3, 1, 2),
+           TensorView<double, 4>(weight.data(), pointwise), nchw_dst);
+    expected = naive_conv2d(input, weight, {}, in, pointwise, Conv2dParams(), in[2], in[3]);
+    for (size_t i = 0; i < expected.size(); i += 7) {
+        size_t x = i % in[3], y = i / in[3] % in[2], o = i / (in[2] * in[3]) % 4, n = i / (4 * in[2] * in[3]);
+        ASSERT_THAT(nchw_dst(n, o, y, x), Eq(expected[i]));
+    }
+
+    EXPECT_THROW(conv2d(TensorView<double, 4>(input.data(), in), TensorView<double, 4>(weight.data(), w), dst),
+                 std::runtime_error);
+}
+
+TEST_F(ConvTest, depthwise) {
+    const size_t in[] = {2, 3, 8, 10};
+    const size_t w[] = {6, 1, 3, 3};
+    for (size_t stride = 1; stride <= 2; ++stride) {
+        Conv2dParams params;
+        params.stride[0] = params.stride[1] = stride;
+        params.padding[0] = params.padding[1] = 1;
+        params.groups = 3;
+        const size_t oh = conv_output_size(in[2], 3, stride, 1), ow = conv_output_size(in[3], 3, stride, 1);
+        auto input = values(count(in), 3), weight = values(count(w), 4);
+        auto expected = naive_conv2d(input, weight, {}, in, w, params, oh, ow);
+        Tensor<double, 4> dst(in[0], w[0], oh, ow);
+        conv2d(TensorView<double, 4>(input.data(), in), TensorView<double, 4>(weight.data(), w), dst, params);
+        EXPECT_THAT(std::vector<double>(dst.data(), dst.data() + dst.num_elements()), ElementsAreArray(expected));
+    }
+}
+
+TEST_F(ConvTest, pooling) {
+    std::vector<float> src(2 * 3 * 5 * 6);
+    std::iota(src.begin(), src.end(), 0.f);
+    std::reverse(src.begin() + 30, src.begin() + 60);
+    auto view = make_view(src.data(), {2, 3, 5, 6});
+
+    Tensor<float, 4> max(2, 3, 2, 3);
+    max_pool2d(view, max);
+    EXPECT_THAT(max(0, 0, 1, 2), Eq(view(0, 0, 3, 5)));
+    EXPECT_THAT(max(0, 1, 0, 0), Eq(view(0, 1, 0, 0)));
+
+    /* 3x3 window with stride 2 and padding 1 */
+    Pool2dParams params;
+    params.kernel[0] = params.kernel[1] = 3;
+    params.stride[0] = params.stride[1] = 2;
+    params.padding[0] = params.padding[1] = 1;
+    Tensor<float, 4> avg(2, 3, 3, 3), avg_valid(2, 3, 3, 3);
+    avg_pool2d(view, avg, params);
+    params.count_include_pad = false;
+    avg_pool2d(view, avg_valid, params);
+    /* window of (0, 0) covers rows 0..1 and columns 0..1 */
+    float sum = view(1, 2, 0, 0) + view(1, 2, 0, 1) + view(1, 2, 1, 0) + view(1, 2, 1, 1);
+    EXPECT_FLOAT_EQ(avg(1, 2, 0, 0), sum / 9);
+    EXPECT_FLOAT_EQ(avg_valid(1, 2, 0, 0), sum / 4);
+    /* window of (1, 2) covers rows 1..3 and columns 3..5 */
+    sum = 0;
+    for (size_t y = 1; y <= 3; ++y) {
+        for (size_t x = 3; x <= 5; ++x) {
+            sum += view(0, 1, y, x);
+        }
+    }
+    EXPECT_FLOAT_EQ(avg_valid(0, 1, 1, 2), sum / 9);
+
+    Tensor<float, 2> global(2, 3);
+    global_avg_pool2d(view.permute(0, 1, 3, 2), global);
+    EXPECT_FLOAT_EQ(global(0, 1), 30 + 14.5f);
+    EXPECT_FLOAT_EQ(global(1, 0), 90 + 14.5f);
+}
+
+class PlanTest : public testing::Test {
+};
+
+TEST_F(PlanTest, broadcast_binary) {
+    std::vector<float> a(4 * 3 * 5), b(5), c(4 * 3 * 5);
+    std::iota(a.begin(), a.end(), 0.f);
+    std::iota(b.begin(), b.end(), 100.f);
+    auto av = make_view(a.data(), {4, 3, 5});
+    auto bv = make_view(b.data(), {5});
+    auto cv = make_view(c.data(), {4, 3, 5});
+
+    auto plan = make_plan(cv, av, bv);
+    EXPECT_THAT(plan.num_dims(), Eq(2));
+    EXPECT_TRUE(plan.matches(cv, av, bv));
+    size_t shape[] = {4, 3, 5};
+    size_t transposed_stride[] = {15, 1, 3};
+    EXPECT_FALSE(plan.matches(cv, TensorView<float, 3>(a.data(), shape, transposed_stride), bv));
+
+    plan.execute(std::plus<float>(), cv, av, bv);
+    EXPECT_THAT(cv(2, 1, 3), Eq(a[2 * 15 + 1 * 5 + 3] + 103));
+
+    /* the same plan on other buffers */
+    std::vector<float> a2(a.size(), 1.f), c2(c.size());
+    plan.execute(std::multiplies<float>(), c2.data(), a2.data(), b.data());
+    EXPECT_THAT(c2[7], Eq(102));
+
+    EXPECT_THROW(make_plan(cv, make_view(b.data(), {3})), std::runtime_error);
+}
+
+TEST_F(PlanTest, strided_inplace) {
+    std::vector<int> data(6 * 8, 1);
+    size_t shape[] = {6, 4};
+    size_t stride[] = {8, 2};
+    TensorView<int, 2> view(data.data(), shape, stride);
+
+    auto plan = make_plan(view, view);
+    for (int i = 0; i < 3; ++i) {
+        plan.execute([](int x) { return x * 2; }, view, view);
+    }
+    EXPECT_THAT(data[8 * 5 + 6], Eq(8));
+    EXPECT_THAT(data[8 * 5 + 7], Eq(1));
+}
+
+TEST_F(PlanTest, expression) {
+    std::vector<double> a(6 * 7), b(7), c(6 * 7);
+    std::iota(a.begin(), a.end(), 0.);
+    std::iota(b.begin(), b.end(), 1.);
+    auto av = make_view(a.data(), {6, 7});
+    auto bv = make_view(b.data(), {7});
+    auto cv = make_view(c.data(), {6, 7});
+
+    auto plan = make_plan(cv, av * 2. + bv);
+    plan.evaluate(av * 2. + bv, cv);
+    EXPECT_THAT(cv(4, 5), Eq(a[4 * 7 + 5] * 2 + 6));
+
+    std::vector<double> a2(a.size(), 3.);
+    plan.evaluate(make_view(a2.data(), {6, 7}) * 2. + bv, cv);
+    EXPECT_THAT(c, Each(Ge(7.)));
+    EXPECT_THAT(cv(0, 6), Eq(13));
+}
+
+class NpyTest : public testing::Test {
+protected:
+    /* Writes a .npy file with the header dictionary padded to 64 bytes */
+    static std::string write_npy(const std::string& name, const std::string& dict, const void* data, size_t bytes) {
+        std::string header = dict;
+        while ((10 + header.size() + 1) % 64 != 0) {
+            header += ' ';
+        }
+        header += '\n';
+        const std::string path = testing::TempDir() + name;
+        std::ofstream file(path, std::ios::binary);
+        const char prefix[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                               static_cast<char>(header.size() & 0xff), static_cast<char>(header.size() >> 8)};
+        file.write(prefix, sizeof(prefix));
+        file << header;
+        file.write(static_cast<const char*>(data), bytes);
+        return path;
+    }
+};
+
+TEST_F(NpyTest, mapped_view) {
+    std::vector<float> data(2 * 3 * 4);
+    std::iota(data.begin(), data.end(), 0.f);
+    const auto path = write_npy("tensor_view_c.npy", "{'descr': '<f4', 'fortran_order': False, 'shape': (2, 3, 4), }",
+                                data.data(), data.size() * sizeof(float));
+
+    NpyMapping mapping(path, MapMode::read_only, MapAdvice::will_need);
+    EXPECT_THAT(mapping.header().shape, ElementsAre(2, 3, 4));
+    EXPECT_THAT(mapping.header().data_offset % 64, Eq(0));
+    EXPECT_TRUE(mapping.header().holds<float>());
+    TensorView<const float, 3> view = mapping.view<float, 3>();
+    EXPECT_THAT(get_size(view), ElementsAre(2, 3, 4));
+    EXPECT_THAT(view(1, 2, 3), Eq(23));
+    EXPECT_THAT(view(0, 1, 2), Eq(6));
+
+    EXPECT_THROW((mapping.view<double, 3>()), std::runtime_error);
+    EXPECT_THROW((mapping.view<int32_t, 3>()), std::runtime_error);
+    EXPECT_THROW((mapping.view<float, 2>()), std::runtime_error);
+    EXPECT_THROW((mapping.mutable_view<float, 3>()), std::runtime_error);
+
+    /* copy-on-write pages are private */
+    NpyMapping private_mapping(path, MapMode::copy_on_write);
+    private_mapping.mutable_view<float, 3>()(0, 0, 0) = 100;
+    auto private_view = private_mapping.view<float, 3>();
+    EXPECT_THAT(private_view(0, 0, 0), Eq(100));
+    NpyMapping shared_mapping(path);
+    auto shared_view = shared_mapping.view<float, 3>();
+    EXPECT_THAT(shared_view(0, 0, 0), Eq(0));
+
+    EXPECT_THROW(NpyMapping(testing::TempDir() + "tensor_view_missing.npy"), std::runtime_error);
+}
+
+TEST_F(NpyTest, fortran_order) {
+    /* 2x3 matrix stored by columns */
+    const int16_t data[] = {0, 10, 1, 11, 2, 12};
+    const auto path = write_npy("tensor_view_f.npy", "{'descr': '<i2', 'fortran_order': True, 'shape': (2, 3), }",
+                                data, sizeof(data));
+    NpyMapping mapping(path);
+    auto view = mapping.view<int16_t, 2>();
+    EXPECT_THAT(get_size(view), ElementsAre(2, 3));
+    EXPECT_THAT(view(1, 2), Eq(12));
+    EXPECT_THAT(view(0, 1), Eq(1));
+
+    const char truncated[] = "\x93NUMPY\x01\x00\x40\x00{'descr': '<f4'";
+    EXPECT_THROW(parse_npy_header(truncated, sizeof(truncated) - 1), std::runtime_error);
+}
+
+TEST_F(NpyTest, save_strided_views) {
+    std::vector<float> data(3 * 4 * 5);
+    std::iota(data.begin(), data.end(), 0.f);
+    auto view = make_view(data.data(), {3, 4, 5});
+
+    const auto path = testing::TempDir() + "tensor_view_saved.npy";
+    save_npy(path, view.permute(2, 0, 1));
+    {
+        NpyMapping mapping(path);
+        EXPECT_FALSE(mapping.header().fortran_order);
+        auto loaded = mapping.view<float, 3>();
+        EXPECT_THAT(get_size(loaded), ElementsAre(5, 3, 4));
+        EXPECT_THAT(loaded(4, 2, 1), Eq(view(2, 1, 4)));
+    }
+
+    /* transposed matrix is saved as it is laid out in memory */
+    save_npy(path, make_view(data.data(), {6, 10}).permute(1, 0));
+    {
+        NpyMapping mapping(path);
+        EXPECT_TRUE(mapping.header().fortran_order);
+        auto loaded = mapping.view<float, 2>();
+        EXPECT_THAT(loaded(7, 3), Eq(37));
+    }
+
+    /* rows larger than a chunk of the writer */
+    std::vector<int32_t> large(3 * 200000);
+    std::iota(large.begin(), large.end(), 0);
+    save_npy(path, make_view(large.data(), {200000, 3}).permute(1, 0).flip(1));
+    {
+        NpyMapping mapping(path);
+        auto loaded = mapping.view<int32_t, 2>();
+        EXPECT_THAT(get_size(loaded), ElementsAre(3, 200000));
+        EXPECT_THAT(loaded(2, 0), Eq(large[199999 * 3 + 2]));
+        EXPECT_THAT(loaded(1, 123456), Eq(large[(199999 - 123456) * 3 + 1]));
+    }
+}
+
+TEST_F(NpyTest, npz_archive) {
+    EXPECT_THAT(detail::crc32(0, "123456789", 9), Eq(0xcbf43926u));
+    EXPECT_THAT(detail::crc32(detail::crc32(0, "1234", 4), "56789", 5), Eq(0xcbf43926u));
+
+    std::vector<double> a(7 * 3);
+    std::iota(a.begin(), a.end(), 0.);
+    std::vector<uint8_t> b{1, 2, 3};
+    const auto npy_path = testing::TempDir() + "tensor_view_entry.npy";
+    const auto path = testing::TempDir() + "tensor_view_archive.npz";
+    {
+        NpzWriter archive(path);
+        archive.add("a", make_view(a.data(), {7, 3}).permute(1, 0).flip(0));
+        archive.add("bytes", make_view(b.data(), {3}));
+    }
+    save_npy(npy_path, make_view(a.data(), {7, 3}).permute(1, 0).flip(0));
+
+    const auto read = [](const std::string& file) {
+        std::ifstream stream(file, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    };
+    const auto number = [](const std::string& s, size_t pos, size_t bytes) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(s[pos + i])) << (8 * i);
+        }
+        return value;
+    };
+    const std::string archive = read(path), npy = read(npy_path);
+
+    /* end of central directory: 2 entries, first entry at offset 0 */
+    const size_t end = archive.size() - 22;
+    ASSERT_THAT(number(archive, end, 4), Eq(0x06054b50u));
+    EXPECT_THAT(number(archive, end + 10, 2), Eq(2));
+    const size_t directory = number(archive, end + 16, 4);
+    ASSERT_THAT(number(archive, directory, 4), Eq(0x02014b50u));
+    EXPECT_THAT(archive.substr(directory + 46, 5), Eq("a.npy"));
+    EXPECT_THAT(number(archive, directory + 24, 4), Eq(npy.size()));
+    EXPECT_THAT(number(archive, directory + 16, 4), Eq(detail::crc32(0, npy.data(), npy.size())));
+
+    /* the local entry holds the same bytes as the .npy file */
+    EXPECT_THAT(number(archive, 0, 4), Eq(0x04034b50u));
+    EXPECT_THAT(archive.substr(30, 5), Eq("a.npy"));
+    EXPECT_TRUE(archive.compare(35, npy.size(), npy) == 0);
+    const size_t second = 35 + npy.size() + 16;
+    EXPECT_THAT(number(archive, second, 4), Eq(0x04034b50u));
+    EXPECT_THAT(archive.substr(second + 30, 9), Eq("bytes.npy"));
+    EXPECT_THAT(archive.substr(archive.find("'descr'", second), 15), Eq("'descr': '|u1',"));
+}
+
+class TraceDisabled : public testing::Test {
+};
+
+TEST_F(TraceDisabled, no_events_without_macro) {
+    /* this file is built without TV_ENABLE_TRACING, see test_trace.cpp */
+    std::vector<float> a(4 * 6, 1.f), b(4 * 6);
+    auto av = make_view(a.data(), {4, 6});
+    auto bv = make_view(b.data(), {4, 6});
+    trace::clear();
+    trace::start();
+    bv = av + av;
+    softmax(av, bv, 1);
+    trace::stop();
+    EXPECT_TRUE(trace::events().empty());
+}
+
 class OwningTensor : public testing::Test {
 };
 
@@ -441,6 +2210,9 @@ TEST_F(OwningTensor, create_constructor_parameter_pack) {
     EXPECT_THAT(tensor.size(0), Eq(4));
     EXPECT_THAT(tensor.size(1), Eq(5));
     EXPECT_THAT(tensor.size(2), Eq(6));
+    ASSERT_FALSE(tensor.empty());
+    EXPECT_THAT(std::vector<float>(tensor.data(), tensor.data() + tensor.num_elements()), Each(Eq(0.f)));
+    EXPECT_THAT(reinterpret_cast<uintptr_t>(tensor.data()) % 64, Eq(0));
 }
 TEST_F(OwningTensor, create_constructor_array) {
     size_t shape[] = {4,5,6};
@@ -449,8 +2221,84 @@ TEST_F(OwningTensor, create_constructor_array) {
     EXPECT_THAT(tensor.size(0), Eq(4));
     EXPECT_THAT(tensor.size(1), Eq(5));
     EXPECT_THAT(tensor.size(2), Eq(6));
+
+    size_t shape_1d[] = {7};
+    Tensor<double, 1> tensor_1d(shape_1d);
+    EXPECT_THAT(tensor_1d.size(0), Eq(7));
+}
+
+TEST_F(OwningTensor, uninitialized) {
+    Tensor<float, 2> tensor(uninitialized, 3, 1000);
+    EXPECT_THAT(tensor.size(1), Eq(1000));
+    EXPECT_THAT(reinterpret_cast<uintptr_t>(tensor.data()) % 64, Eq(0));
+
+    tensor.assign_(1.f);
+    EXPECT_THAT(tensor.sum(), Eq(3000));
+
+    /* non-trivial types are still constructed */
+    size_t shape[] = {2, 3};
+    Tensor<std::string, 2> strings(uninitialized, shape);
+    EXPECT_THAT(strings(1, 2), StrEq(""));
+}
+
+TEST_F(OwningTensor, copy_and_move) {
+    Tensor<int, 2> tensor(2, 3);
+    tensor(1, 2) = 5;
+
+    Tensor<int, 2> copy(tensor);
+    copy(1, 2) = 6;
+    EXPECT_THAT(tensor(1, 2), Eq(5));
+    EXPECT_THAT(copy(1, 2), Eq(6));
+
+    const int* data = tensor.data();
+    Tensor<int, 2> moved(std::move(tensor));
+    EXPECT_THAT(moved.data(), Eq(data));
+    EXPECT_TRUE(tensor.empty());
+
+    copy = moved;
+    EXPECT_THAT(copy(1, 2), Eq(5));
+    EXPECT_THAT(copy.data(), Ne(moved.data()));
 }
 
+template<class T>
+struct CountingAllocator : std::allocator<T> {
+    template<class U>
+    struct rebind {
+        using other = CountingAllocator<U>;
+    };
+
+    CountingAllocator() = default;
+
+    template<class U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        ++allocations;
+        return std::allocator<T>::allocate(n);
+    }
+
+    static int allocations;
+};
+
+template<class T>
+int CountingAllocator<T>::allocations = 0;
+
+TEST_F(OwningTensor, custom_allocator) {
+    using TensorType = Tensor<float, 2, implicit_broadcast, CountingAllocator<float>>;
+    CountingAllocator<float>::allocations = 0;
+    TensorType tensor(4, 4);
+    TensorType copy(tensor);
+    EXPECT_THAT(CountingAllocator<float>::allocations, Eq(2));
+
+    /* owning tensors are passed to operations as views */
+    Tensor<float, 1> dst(4);
+    tensor.assign_(2.f);
+    tensor.sum(dst, 0);
+    copy += tensor;
+    EXPECT_THAT(CountingAllocator<float>::allocations, Eq(2));
+    EXPECT_THAT(dst(3), Eq(8));
+    EXPECT_THAT(copy(3, 3), Eq(2));
+}
 
 
 }
\ No newline at end of file
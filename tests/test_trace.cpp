@@ -0,0 +1,99 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* Tracing changes the code of every operation, so the macro is defined in this file only and the traced tests are
+ * a separate executable: all files of one program must agree on TV_ENABLE_TRACING */
+#define TV_ENABLE_TRACING
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "TensorView/TensorView.h"
+#include "TensorView/Functions.h"
+#include "TensorView/Trace.h"
+
+namespace {
+
+using namespace tensor_view;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::StrEq;
+using ::testing::HasSubstr;
+using ::testing::StartsWith;
+
+class TraceTest : public testing::Test {
+protected:
+    void SetUp() override {
+        trace::clear();
+        trace::start();
+    }
+
+    void TearDown() override {
+        trace::stop();
+        trace::clear();
+    }
+};
+
+TEST_F(TraceTest, events) {
+    std::vector<float> a(4 * 6, 1.f), b(6, 2.f), c(4 * 6);
+    auto av = make_view(a.data(), {4, 6});
+    auto bv = make_view(b.data(), {6});
+    auto cv = make_view(c.data(), {4, 6});
+    auto ct = make_view(c.data(), {6, 4}).permute(1, 0);
+
+    cv = av + bv;
+    ct.assign_(av);
+    cv.map_([](float x) { return x * 2; });
+    float sum = av.sum();
+    trace::stop();
+    av.sum();
+
+    EXPECT_THAT(sum, Eq(24.f));
+    const auto events = trace::events();
+    ASSERT_THAT(events.size(), Eq(4u));
+    EXPECT_THAT(events[0].name, StrEq("element_wise"));
+    EXPECT_THAT(events[0].path, Eq(trace::Path::broadcast));
+    EXPECT_THAT(events[0].elements, Eq(24u));
+    EXPECT_THAT(events[0].bytes, Eq(3 * 24 * sizeof(float)));
+    EXPECT_THAT(std::vector<size_t>(events[0].shape, events[0].shape + events[0].ndim), ElementsAre(4, 6));
+    EXPECT_THAT(events[1].name, StrEq("assign_"));
+    EXPECT_THAT(events[1].path, Eq(trace::Path::strided));
+    EXPECT_THAT(events[2].name, StrEq("map_"));
+    EXPECT_THAT(events[2].path, Eq(trace::Path::contiguous));
+    EXPECT_THAT(events[3].name, StrEq("reduce"));
+    EXPECT_THAT(events[3].path, Eq(trace::Path::contiguous));
+    EXPECT_THAT(events[1].start, Ge(events[0].start + events[0].duration));
+}
+
+TEST_F(TraceTest, export) {
+    std::vector<double> a(3 * 5, 1.), b(3 * 5);
+    auto av = make_view(a.data(), {3, 5});
+    auto bv = make_view(b.data(), {3, 5});
+    softmax(av, bv, 1);
+    softmax(av, bv, 1);
+    log_softmax(av, bv, 0);
+
+    std::ostringstream chrome;
+    trace::write_chrome_trace(chrome);
+    const std::string json = chrome.str();
+    EXPECT_THAT(json, StartsWith("{\"traceEvents\": ["));
+    EXPECT_THAT(json, HasSubstr("\"name\": \"log_softmax\", \"cat\": \"tensor_view\", \"ph\": \"X\""));
+    EXPECT_THAT(json, HasSubstr("\"args\": {\"shape\": \"[3, 5]\", \"path\": \"contiguous\", "
+                                "\"elements\": 15, \"bytes\": 240}}"));
+
+    std::ostringstream summary;
+    trace::write_summary(summary);
+    std::istringstream lines(summary.str());
+    std::string header, first, second, rest;
+    std::getline(lines, header);
+    std::getline(lines, first);
+    std::getline(lines, second);
+    EXPECT_THAT(header, StartsWith("operation"));
+    EXPECT_THAT(first + second, HasSubstr("softmax         contiguous           2"));
+    EXPECT_THAT(first + second, HasSubstr("log_softmax     contiguous           1"));
+    EXPECT_FALSE(std::getline(lines, rest));
+}
+
+}